@@ -0,0 +1,656 @@
+#include "include.c"
+#include "utils/bench.h"
+#include "utils/random.h"
+#include "utils/matrix.h"
+#include "utils/unrolled_list.h"
+#include "utils/btree.h"
+#include "utils/threadpool.h"
+#include "utils/queue.h"
+#include "utils/file_batch.h"
+
+/* ---------------------- ARENA ---------------------- */
+
+#define ALLOC_BATCH 1024
+#define ALLOC_SIZE 64
+
+static void bench_arena_alloc(void *ctx, uint64_t iters) {
+    Arena *a = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        if(i % ALLOC_BATCH == 0) arena_reset(a);
+        void *p = arena_alloc(a, ALLOC_SIZE);
+        bench_do_not_optimize(p);
+    }
+}
+
+static void bench_malloc_free(void *ctx, uint64_t iters) {
+    void **ptrs = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        size_t slot = i % ALLOC_BATCH;
+        if(slot == 0 && i != 0) {
+            for(size_t j = 0; j < ALLOC_BATCH; j++) free(ptrs[j]);
+        }
+        ptrs[slot] = malloc(ALLOC_SIZE);
+        bench_do_not_optimize(ptrs[slot]);
+    }
+    for(uint64_t j = 0; j < (iters - 1) % ALLOC_BATCH + 1; j++) free(ptrs[j]);
+}
+
+#define SNAPSHOT_STRINGS 10000
+#define SNAPSHOT_PATH "/tmp/utils_bench.arena"
+
+typedef struct {
+    String_Builder *items;
+    size_t length;
+} Snapshot_Root;
+
+// quello che farebbe un servizio ad ogni avvio senza snapshot
+static Snapshot_Root *snapshot_build(Arena *a) {
+    Snapshot_Root *root = arena_alloc(a, sizeof(*root));
+    root->items = arena_alloc(a, SNAPSHOT_STRINGS*sizeof(*root->items));
+    root->length = SNAPSHOT_STRINGS;
+    char buf[32];
+    for(size_t i = 0; i < SNAPSHOT_STRINGS; i++) {
+        snprintf(buf, sizeof(buf), "symbol_%zu", i);
+        root->items[i] = arena_sb_from_cstr(a, buf);
+    }
+    return root;
+}
+
+static void bench_arena_rebuild(void *ctx, uint64_t iters) {
+    Arena *a = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        arena_reset(a);
+        Snapshot_Root *root = snapshot_build(a);
+        bench_do_not_optimize(root);
+    }
+}
+
+static void bench_arena_restore(void *ctx, uint64_t iters) {
+    (void)ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        Arena a = {0};
+        Snapshot_Root *root;
+        fatal_if(arena_restore(&a, SNAPSHOT_PATH, (void**)&root, false) != 0, "arena_restore failed");
+        char *last = root->items[root->length - 1].data;
+        bench_do_not_optimize(last);
+        arena_free(&a);
+    }
+}
+
+/* ---------------------- STRINGS ---------------------- */
+
+static Cstr *csv_line = "  alpha,beta,gamma,delta,epsilon,zeta,eta,theta,iota,kappa,lambda,mu  ";
+
+static void bench_sv_chop_by_delim(void *ctx, uint64_t iters) {
+    (void)ctx;
+    String_View line = sv_from_cstr(csv_line);
+    for(uint64_t i = 0; i < iters; i++) {
+        String_View sv = line;
+        while(sv.length > 0) {
+            String_View field = sv_chop_by_delim(&sv, ',');
+            bench_do_not_optimize(field);
+        }
+    }
+}
+
+static void bench_sv_trim(void *ctx, uint64_t iters) {
+    (void)ctx;
+    String_View line = sv_from_cstr(csv_line);
+    for(uint64_t i = 0; i < iters; i++) {
+        String_View sv = line;
+        bench_do_not_optimize(sv);
+        sv_trim(&sv);
+        bench_do_not_optimize(sv);
+    }
+}
+
+static void bench_sv_compare(void *ctx, uint64_t iters) {
+    (void)ctx;
+    String_View a = sv_from_cstr(csv_line);
+    String_View b = sv_from_cstr("  alpha,beta,gamma,delta,epsilon,zeta,eta,theta,iota,kappa,lambda,nu  ");
+    for(uint64_t i = 0; i < iters; i++) {
+        bench_do_not_optimize(a);
+        int cmp = sv_compare(a, b);
+        bench_do_not_optimize(cmp);
+    }
+}
+
+static void bench_sb_append_cstr(void *ctx, uint64_t iters) {
+    String_Builder *sb = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        if(i % 1024 == 0) sb->length = 0;
+        sb_append_cstr(sb, "hello, world ");
+    }
+    bench_do_not_optimize(sb->data);
+}
+
+#define KEY_BATCH 1000
+
+// tante chiavi corte vive insieme, come in una tabella di simboli
+static void bench_sb_short_keys(void *ctx, uint64_t iters) {
+    String_Builder *keys = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        for(size_t k = 0; k < KEY_BATCH; k++) keys[k] = sb_from_cstr("user_042");
+        bench_clobber();
+        for(size_t k = 0; k < KEY_BATCH; k++) free(keys[k].data);
+    }
+}
+
+static void bench_sso_short_keys(void *ctx, uint64_t iters) {
+    String_Sso *keys = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        for(size_t k = 0; k < KEY_BATCH; k++) keys[k] = sso_from_cstr("user_042");
+        bench_clobber();
+        for(size_t k = 0; k < KEY_BATCH; k++) sso_free(&keys[k]);
+    }
+}
+
+/* ---------------------- MATRIX ---------------------- */
+
+#define DOT_LEN 4096
+#define GEMM_N 128
+
+typedef struct {
+    size_t dot_len;
+    double *a;
+    double *b;
+    double *c;
+} Matrix_Ctx;
+
+static void bench_dot_product(void *ctx, uint64_t iters) {
+    Matrix_Ctx *m = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        bench_clobber();
+        double r = dot_product(m->a, m->b, m->dot_len);
+        bench_do_not_optimize(r);
+    }
+}
+
+static void bench_dot_naive(void *ctx, uint64_t iters) {
+    Matrix_Ctx *m = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        bench_clobber();
+        double r = 0.0;
+        for(size_t j = 0; j < m->dot_len; j++) r += m->a[j]*m->b[j];
+        bench_do_not_optimize(r);
+    }
+}
+
+static void bench_gemm(void *ctx, uint64_t iters) {
+    Matrix_Ctx *m = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        matrix_gemm(GEMM_N, GEMM_N, GEMM_N, 1.0, m->a, GEMM_N, m->b, GEMM_N, 0.0, m->c, GEMM_N);
+        bench_clobber();
+    }
+}
+
+static void bench_gemm_naive(void *ctx, uint64_t iters) {
+    Matrix_Ctx *m = ctx;
+    for(uint64_t it = 0; it < iters; it++) {
+        for(size_t i = 0; i < GEMM_N; i++) {
+            for(size_t j = 0; j < GEMM_N; j++) {
+                double sum = 0.0;
+                for(size_t k = 0; k < GEMM_N; k++) sum += m->a[i*GEMM_N + k]*m->b[k*GEMM_N + j];
+                m->c[i*GEMM_N + j] = sum;
+            }
+        }
+        bench_clobber();
+    }
+}
+
+/* ---------------------- LIST ---------------------- */
+
+DEFINE_LIST(int_list, int, LIST_CMP_SCALAR)
+DEFINE_UNROLLED_LIST(int_unrolled_list, int, LIST_CMP_SCALAR)
+
+typedef struct {
+    size_t length;
+    list_head_t list;
+    Unrolled_List unrolled;
+    int_list_t typed;
+    int_unrolled_list_t typed_unrolled;
+    Btree btree;
+    Btree_Key *keys; // stessi valori della lista, ordinati, per btree_bulk_load
+    int *array; // stessi valori della lista, ordinati
+    uint64_t cursor; // prossima interrogazione, continua tra una chiamata e l'altra
+} List_Ctx;
+
+// chiavi presenti in ordine sparso, così le liste grandi non restano in cache
+static inline int list_query(List_Ctx *l) {
+    return (int)((l->cursor++*2654435761u) % l->length)*2;
+}
+
+static void bench_list_is_member(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        int value = list_query(l);
+        bool found = list_is_member(&l->list, &value);
+        bench_do_not_optimize(found);
+    }
+}
+
+static void bench_unrolled_list_is_member(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        int value = list_query(l);
+        bool found = unrolled_list_is_member(&l->unrolled, &value);
+        bench_do_not_optimize(found);
+    }
+}
+
+static void bench_int_list_is_member(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        bool found = int_list_is_member(&l->typed, list_query(l));
+        bench_do_not_optimize(found);
+    }
+}
+
+static void bench_int_unrolled_list_is_member(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        bool found = int_unrolled_list_is_member(&l->typed_unrolled, list_query(l));
+        bench_do_not_optimize(found);
+    }
+}
+
+static void bench_array_linear(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        int value = list_query(l);
+        bench_do_not_optimize(value);
+        size_t j = 0;
+        while(j < l->length && l->array[j] < value) j++;
+        bool found = j < l->length && l->array[j] == value;
+        bench_do_not_optimize(found);
+    }
+}
+
+#define BTREE_RANGE 1000
+
+static void bench_btree_get(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        bool found = btree_get(&l->btree, list_query(l), NULL);
+        bench_do_not_optimize(found);
+    }
+}
+
+static void bench_btree_bulk_load(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        Btree tree = btree_init();
+        Errno err = btree_bulk_load(&tree, l->keys, NULL, l->length);
+        bench_do_not_optimize(err);
+        btree_deinit(&tree);
+    }
+}
+
+static bool btree_sum_keys(Btree_Key key, void *value, void *ctx) {
+    (void)value;
+    *(Btree_Key*)ctx += key;
+    return true;
+}
+
+static void bench_btree_range(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        Btree_Key low = list_query(l), sum = 0;
+        size_t visited = btree_range(&l->btree, low, low + BTREE_RANGE*2, btree_sum_keys, &sum);
+        bench_do_not_optimize(visited);
+        bench_do_not_optimize(sum);
+    }
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int*)a - *(const int*)b;
+}
+
+static void bench_array_bsearch(void *ctx, uint64_t iters) {
+    List_Ctx *l = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        int value = list_query(l);
+        bool found = bsearch(&value, l->array, l->length, sizeof(int), compare_int) != NULL;
+        bench_do_not_optimize(found);
+    }
+}
+
+static void list_ctx_init(List_Ctx *l, size_t length) {
+    l->length = length;
+    l->list = list_init(LIST_CMP_INT);
+    l->unrolled = unrolled_list_init(sizeof(int), LIST_CMP_INT);
+    l->typed = int_list_init();
+    l->typed_unrolled = int_unrolled_list_init();
+    l->btree = btree_init();
+    l->keys = malloc(length*sizeof(Btree_Key));
+    l->array = malloc(length*sizeof(int));
+    fatal_if(l->keys == NULL || l->array == NULL, MSG_ERR_FULL_MEMORY);
+    // inserimento dal fondo: ogni list_insert è in testa, O(1)
+    for(int i = (int)length - 1; i >= 0; i--) {
+        l->array[i] = i*2;
+        l->keys[i] = i*2;
+        int *value = malloc(sizeof(*value));
+        fatal_if(value == NULL, MSG_ERR_FULL_MEMORY);
+        *value = i*2;
+        list_insert(&l->list, value);
+        unrolled_list_insert(&l->unrolled, value);
+        int_list_insert(&l->typed, i*2);
+        int_unrolled_list_insert(&l->typed_unrolled, i*2);
+    }
+    Errno err = btree_bulk_load(&l->btree, l->keys, NULL, length);
+    fatal_if(err != 0, "btree_bulk_load: %s", strerror(err));
+}
+
+static void list_ctx_deinit(List_Ctx *l) {
+    list_deinit(l->list);
+    unrolled_list_deinit(&l->unrolled);
+    int_list_deinit(&l->typed);
+    int_unrolled_list_deinit(&l->typed_unrolled);
+    btree_deinit(&l->btree);
+    free(l->keys);
+    free(l->array);
+}
+
+/* ---------------------- RANDOM ---------------------- */
+
+#define RNG_BLOCK 4096
+
+static void bench_uniform_real(void *ctx, uint64_t iters) {
+    (void)ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        double r = uniform_real_distribution(-1.0, 1.0);
+        bench_do_not_optimize(r);
+    }
+}
+
+static void bench_xoshiro256_next(void *ctx, uint64_t iters) {
+    Xoshiro256 *rng = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        uint64_t r = xoshiro256_next(rng);
+        bench_do_not_optimize(r);
+    }
+}
+
+static void bench_random_fill_f64(void *ctx, uint64_t iters) {
+    double *out = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        random_fill_f64(out, RNG_BLOCK, -1.0, 1.0);
+        bench_clobber();
+    }
+}
+
+static void bench_normal(void *ctx, uint64_t iters) {
+    (void)ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        double r = normal_distribution(0.0, 1.0);
+        bench_do_not_optimize(r);
+    }
+}
+
+static void bench_random_fill_normal(void *ctx, uint64_t iters) {
+    double *out = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        random_fill_normal(out, RNG_BLOCK, 0.0, 1.0);
+        bench_clobber();
+    }
+}
+
+static void bench_philox_fill_f64(void *ctx, uint64_t iters) {
+    double *out = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        philox_fill_f64(42, 0, i*RNG_BLOCK, out, RNG_BLOCK, -1.0, 1.0);
+        bench_clobber();
+    }
+}
+
+/* ---------------------- THREADPOOL ---------------------- */
+
+#define TASK_BATCH 1000
+#define PARALLEL_LEN (1 << 20)
+
+static void task_nop(void *ctx) {
+    bench_do_not_optimize(ctx);
+}
+
+static void bench_task_group(void *ctx, uint64_t iters) {
+    Threadpool *pool = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        Task_Group group;
+        task_group_init(&group, pool);
+        for(size_t t = 0; t < TASK_BATCH; t++) task_group_spawn(&group, task_nop, NULL);
+        task_group_wait(&group);
+    }
+}
+
+static void parallel_increment(void *ctx, size_t begin, size_t end) {
+    double *v = ctx;
+    for(size_t i = begin; i < end; i++) v[i] += 1.0;
+}
+
+static void bench_parallel_for(void *ctx, uint64_t iters) {
+    for(uint64_t i = 0; i < iters; i++) {
+        parallel_for(0, PARALLEL_LEN, 4096, parallel_increment, ctx);
+        bench_clobber();
+    }
+}
+
+/* ---------------------- QUEUE ---------------------- */
+
+#define QUEUE_BATCH 64
+
+typedef struct {
+    Spsc_Ring ring;
+    Mpmc_Queue mpmc;
+    uint64_t items[QUEUE_BATCH];
+} Queue_Ctx;
+
+static void bench_spsc_ring(void *ctx, uint64_t iters) {
+    Queue_Ctx *q = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        spsc_ring_push(&q->ring, &i);
+        uint64_t out;
+        spsc_ring_pop(&q->ring, &out);
+        bench_do_not_optimize(out);
+    }
+}
+
+static void bench_spsc_ring_batch(void *ctx, uint64_t iters) {
+    Queue_Ctx *q = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        spsc_ring_push_many(&q->ring, q->items, QUEUE_BATCH);
+        size_t n = spsc_ring_pop_many(&q->ring, q->items, QUEUE_BATCH);
+        bench_do_not_optimize(n);
+    }
+}
+
+static void bench_mpmc_queue(void *ctx, uint64_t iters) {
+    Queue_Ctx *q = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        mpmc_queue_push(&q->mpmc, &i);
+        uint64_t out;
+        mpmc_queue_pop(&q->mpmc, &out);
+        bench_do_not_optimize(out);
+    }
+}
+
+static void bench_mpmc_queue_batch(void *ctx, uint64_t iters) {
+    Queue_Ctx *q = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        mpmc_queue_push_many(&q->mpmc, q->items, QUEUE_BATCH);
+        size_t n = mpmc_queue_pop_many(&q->mpmc, q->items, QUEUE_BATCH);
+        bench_do_not_optimize(n);
+    }
+}
+
+/* ---------------------- FILE BATCH ---------------------- */
+
+#define FILE_BATCH_FILES 1000
+#define FILE_BATCH_DIR "/tmp/utils_bench_files"
+
+typedef struct {
+    Cstr *paths[FILE_BATCH_FILES];
+    char names[FILE_BATCH_FILES][64];
+    File_Batch_Result results[FILE_BATCH_FILES];
+    Arena arena;
+} File_Batch_Ctx;
+
+// file da 0 a 8KB, come un corpus di sorgenti piccoli (letti dalla page cache)
+static void file_batch_ctx_init(File_Batch_Ctx *ctx) {
+    char buf[8192];
+    memset(buf, 'x', sizeof(buf));
+    mkdir(FILE_BATCH_DIR, 0755);
+    for(size_t i = 0; i < FILE_BATCH_FILES; i++) {
+        snprintf(ctx->names[i], sizeof(ctx->names[i]), FILE_BATCH_DIR "/%zu.txt", i);
+        ctx->paths[i] = ctx->names[i];
+        FILE *f = fopen(ctx->names[i], "wb");
+        fatal_if(f == NULL, "could not create %s", ctx->names[i]);
+        fwrite(buf, 1, (i*7919) % sizeof(buf), f);
+        fclose(f);
+    }
+}
+
+static void file_batch_ctx_free(File_Batch_Ctx *ctx) {
+    for(size_t i = 0; i < FILE_BATCH_FILES; i++) unlink(ctx->names[i]);
+    rmdir(FILE_BATCH_DIR);
+    arena_free(&ctx->arena);
+}
+
+static void bench_read_entire_file(void *ctx, uint64_t iters) {
+    File_Batch_Ctx *f = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        arena_reset(&f->arena);
+        for(size_t k = 0; k < FILE_BATCH_FILES; k++) {
+            String_Builder sb = {0};
+            arena_sb_read_entire_file(&sb, &f->arena, f->paths[k]);
+            bench_do_not_optimize(sb.data);
+        }
+    }
+}
+
+static void bench_file_batch_read(void *ctx, uint64_t iters) {
+    File_Batch_Ctx *f = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        arena_reset(&f->arena);
+        size_t failed = file_batch_read(&f->arena, f->paths, FILE_BATCH_FILES, f->results);
+        bench_do_not_optimize(failed);
+    }
+}
+
+static void bench_file_batch_pread(void *ctx, uint64_t iters) {
+    File_Batch_Ctx *f = ctx;
+    for(uint64_t i = 0; i < iters; i++) {
+        arena_reset(&f->arena);
+        size_t failed = file_batch_read_pread(&f->arena, f->paths, FILE_BATCH_FILES, f->results);
+        bench_do_not_optimize(failed);
+    }
+}
+
+int main(int argc, char **argv) {
+    Bench b = bench_init(argc, argv);
+    init_random_with_seed(42);
+
+    Arena arena = {0};
+    void **ptrs = malloc(ALLOC_BATCH*sizeof(*ptrs));
+    fatal_if(ptrs == NULL, MSG_ERR_FULL_MEMORY);
+    bench_run(&b, "arena_alloc 64B", bench_arena_alloc, &arena);
+    bench_run(&b, "malloc+free 64B", bench_malloc_free, ptrs);
+    arena_free(&arena);
+    free(ptrs);
+
+    Arena snapshot = {0};
+    fatal_if(arena_map(&snapshot, SNAPSHOT_PATH, NULL, 1ull << 30) != 0, "arena_map failed");
+    fatal_if(arena_snapshot(&snapshot, snapshot_build(&snapshot)) != 0, "arena_snapshot failed");
+    arena_free(&snapshot);
+    bench_run_items(&b, "arena rebuild 10k strings", bench_arena_rebuild, &arena, SNAPSHOT_STRINGS);
+    bench_run_items(&b, "arena_restore 10k strings", bench_arena_restore, NULL, SNAPSHOT_STRINGS);
+    arena_free(&arena);
+    unlink(SNAPSHOT_PATH);
+
+    String_Builder sb = sb_with_capacity(16*1024);
+    bench_run(&b, "sv_chop_by_delim 12 fields", bench_sv_chop_by_delim, NULL);
+    bench_run(&b, "sv_trim", bench_sv_trim, NULL);
+    bench_run(&b, "sv_compare 72B", bench_sv_compare, NULL);
+    bench_run(&b, "sb_append_cstr 13B", bench_sb_append_cstr, &sb);
+    free(sb.data);
+    String_Builder *sb_keys = malloc(KEY_BATCH*sizeof(*sb_keys));
+    String_Sso *sso_keys = malloc(KEY_BATCH*sizeof(*sso_keys));
+    fatal_if(sb_keys == NULL || sso_keys == NULL, MSG_ERR_FULL_MEMORY);
+    bench_run_items(&b, "sb_from_cstr+free 8B", bench_sb_short_keys, sb_keys, KEY_BATCH);
+    bench_run_items(&b, "sso_from_cstr+free 8B", bench_sso_short_keys, sso_keys, KEY_BATCH);
+    free(sb_keys);
+    free(sso_keys);
+
+    Matrix_Ctx m = {
+        .dot_len = DOT_LEN,
+        .a = generate_random_matrix_seeded_f64(GEMM_N, GEMM_N, -1.0, 1.0, 1, 1),
+        .b = generate_random_matrix_seeded_f64(GEMM_N, GEMM_N, -1.0, 1.0, 2, 1),
+        .c = generate_random_matrix_seeded_f64(GEMM_N, GEMM_N, -1.0, 1.0, 3, 1),
+    };
+    bench_run_items(&b, "dot_product 4096", bench_dot_product, &m, DOT_LEN);
+    bench_run_items(&b, "dot naive 4096", bench_dot_naive, &m, DOT_LEN);
+    bench_run_items(&b, "matrix_gemm 128 (flop)", bench_gemm, &m, 2.0*GEMM_N*GEMM_N*GEMM_N);
+    bench_run_items(&b, "gemm naive 128 (flop)", bench_gemm_naive, &m, 2.0*GEMM_N*GEMM_N*GEMM_N);
+    free(m.a);
+    free(m.b);
+    free(m.c);
+
+    List_Ctx l;
+    list_ctx_init(&l, 1000);
+    bench_run(&b, "list_is_member 1000", bench_list_is_member, &l);
+    bench_run(&b, "unrolled_list_is_member 1000", bench_unrolled_list_is_member, &l);
+    bench_run(&b, "int_list_is_member 1000", bench_int_list_is_member, &l);
+    bench_run(&b, "int_unrolled_list_is_member 1000", bench_int_unrolled_list_is_member, &l);
+    bench_run(&b, "array linear search 1000", bench_array_linear, &l);
+    bench_run(&b, "array bsearch 1000", bench_array_bsearch, &l);
+    bench_run(&b, "btree_get 1000", bench_btree_get, &l);
+    list_ctx_deinit(&l);
+
+    list_ctx_init(&l, 1000000);
+    bench_run(&b, "list_is_member 1M", bench_list_is_member, &l);
+    bench_run(&b, "unrolled_list_is_member 1M", bench_unrolled_list_is_member, &l);
+    bench_run(&b, "int_list_is_member 1M", bench_int_list_is_member, &l);
+    bench_run(&b, "int_unrolled_list_is_member 1M", bench_int_unrolled_list_is_member, &l);
+    bench_run(&b, "array bsearch 1M", bench_array_bsearch, &l);
+    bench_run(&b, "btree_get 1M", bench_btree_get, &l);
+    bench_run_items(&b, "btree_range 1000 keys", bench_btree_range, &l, BTREE_RANGE);
+    bench_run_items(&b, "btree_bulk_load 1M", bench_btree_bulk_load, &l, (double)l.length);
+    list_ctx_deinit(&l);
+
+    Xoshiro256 rng = xoshiro256_seed(42);
+    double *out = malloc(RNG_BLOCK*sizeof(*out));
+    fatal_if(out == NULL, MSG_ERR_FULL_MEMORY);
+    bench_run_items(&b, "uniform_real_distribution", bench_uniform_real, NULL, 1);
+    bench_run_items(&b, "xoshiro256_next", bench_xoshiro256_next, &rng, 1);
+    bench_run_items(&b, "random_fill_f64", bench_random_fill_f64, out, RNG_BLOCK);
+    bench_run_items(&b, "normal_distribution", bench_normal, NULL, 1);
+    bench_run_items(&b, "random_fill_normal", bench_random_fill_normal, out, RNG_BLOCK);
+    bench_run_items(&b, "philox_fill_f64", bench_philox_fill_f64, out, RNG_BLOCK);
+    free(out);
+
+    double *values = calloc(PARALLEL_LEN, sizeof(*values));
+    fatal_if(values == NULL, MSG_ERR_FULL_MEMORY);
+    bench_run_items(&b, "task_group spawn+run", bench_task_group, threadpool_default(), TASK_BATCH);
+    bench_run_items(&b, "parallel_for 1M grain 4096", bench_parallel_for, values, PARALLEL_LEN);
+    free(values);
+
+    static Queue_Ctx q;
+    q.ring = spsc_ring_init(1024, sizeof(uint64_t));
+    q.mpmc = mpmc_queue_init(1024, sizeof(uint64_t));
+    bench_run_items(&b, "spsc_ring push+pop", bench_spsc_ring, &q, 1);
+    bench_run_items(&b, "spsc_ring push+pop many 64", bench_spsc_ring_batch, &q, QUEUE_BATCH);
+    bench_run_items(&b, "mpmc_queue push+pop", bench_mpmc_queue, &q, 1);
+    bench_run_items(&b, "mpmc_queue push+pop many 64", bench_mpmc_queue_batch, &q, QUEUE_BATCH);
+    spsc_ring_deinit(&q.ring);
+    mpmc_queue_deinit(&q.mpmc);
+
+    static File_Batch_Ctx files;
+    file_batch_ctx_init(&files);
+    bench_run_items(&b, "arena_sb_read_entire_file x1000", bench_read_entire_file, &files, FILE_BATCH_FILES);
+    bench_run_items(&b, "file_batch_read x1000", bench_file_batch_read, &files, FILE_BATCH_FILES);
+    bench_run_items(&b, "file_batch_read_pread x1000", bench_file_batch_pread, &files, FILE_BATCH_FILES);
+    file_batch_ctx_free(&files);
+
+    bench_report(&b);
+    bench_free(&b);
+    return 0;
+}
@@ -0,0 +1,71 @@
+#include <time.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include "include.c"
+#include "utils/binlog.h"
+
+#define N_MESSAGES 1000000
+
+static double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static off_t file_size(Cstr *path) {
+    struct stat st;
+    return stat(path, &st) == 0 ? st.st_size : 0;
+}
+
+static void report(Cstr *name, double seconds, Cstr *path) {
+    printf("%-22s %8.1f ns/msg %8.1f bytes/msg\n", name, seconds/N_MESSAGES*1e9,
+           (double)file_size(path)/N_MESSAGES);
+}
+
+int main(void) {
+
+    Cstr *text_path = "build/bench_log.txt";
+    Cstr *bin_path = "build/bench_log.blog";
+
+    // stderr finisce su un file, come in produzione quando viene rediretto
+    int saved_stderr = dup(STDERR_FILENO);
+    int fd = open(text_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    fatal_if(fd < 0, "could not open %s", text_path);
+    dup2(fd, STDERR_FILENO);
+
+    double start = now();
+    for(int i = 0; i < N_MESSAGES; i++) {
+        log_info("request %d served in %f ms by %s", i, i*0.001, "worker");
+    }
+    double sync_time = now() - start;
+    off_t sync_size = file_size(text_path);
+
+    ftruncate(fd, 0);
+    lseek(fd, 0, SEEK_SET);
+    log_async_init(1 << 22, LOG_OVERFLOW_BLOCK);
+    start = now();
+    for(int i = 0; i < N_MESSAGES; i++) {
+        log_info("request %d served in %f ms by %s", i, i*0.001, "worker");
+    }
+    double async_time = now() - start;
+    log_async_deinit();
+
+    dup2(saved_stderr, STDERR_FILENO);
+    close(fd);
+
+    Errno err = binlog_open(bin_path);
+    fatal_if(err != 0, "could not open %s", bin_path);
+    start = now();
+    for(int i = 0; i < N_MESSAGES; i++) {
+        binlog_info("request %d served in %f ms by %s", i, i*0.001, "worker");
+    }
+    double binlog_time = now() - start;
+    binlog_close();
+
+    printf("%-22s %8.1f ns/msg %8.1f bytes/msg\n", "log_info", sync_time/N_MESSAGES*1e9, (double)sync_size/N_MESSAGES);
+    report("log_info (async)", async_time, text_path);
+    report("binlog_info", binlog_time, bin_path);
+
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include <stdatomic.h>
+#include <time.h>
+
+#include "include.c"
+#include "utils/bench.h"
+#include "utils/random.h"
+#include "utils/skiplist.h"
+
+/*
+    Scalabilità degli insiemi ordinati concorrenti: list.h (letture senza lock, scrittori serializzati da un mutex)
+    contro skiplist.h (lock-free), da 1 a 64 thread con varie percentuali di letture.
+    Le scritture sono per metà insert e per metà delete, così la dimensione resta stabile.
+
+    Opzioni: --ms=X durata di ogni misura, --range=N chiavi possibili, --format=text|csv
+*/
+
+#define MAX_THREADS 64
+
+typedef enum {
+    SET_LIST,
+    SET_SKIPLIST,
+} Set_Kind;
+
+static Cstr *set_names[] = { "list", "skiplist" };
+
+typedef struct {
+    Set_Kind kind;
+    list_head_t list;
+    Skiplist skiplist;
+    int key_range;
+    int read_percent;
+    _Atomic bool go;
+    _Atomic bool stop;
+    _Atomic int ready;
+    uint64_t ops[MAX_THREADS];
+} Set_Run;
+
+typedef struct {
+    Set_Run *run;
+    int index;
+} Set_Worker;
+
+static bool set_is_member(Set_Run *run, int key) {
+    if(run->kind == SET_LIST) return list_is_member(&run->list, &key);
+    return skiplist_is_member(&run->skiplist, &key);
+}
+
+static bool set_insert(Set_Run *run, int key) {
+    int *value = malloc(sizeof(*value));
+    fatal_if(value == NULL, MSG_ERR_FULL_MEMORY);
+    *value = key;
+    bool inserted = run->kind == SET_LIST ? list_insert(&run->list, value) : skiplist_insert(&run->skiplist, value);
+    if(!inserted) free(value);
+    return inserted;
+}
+
+static bool set_delete(Set_Run *run, int key) {
+    if(run->kind == SET_LIST) return list_delete(&run->list, &key);
+    return skiplist_delete(&run->skiplist, &key);
+}
+
+static void *set_worker(void *arg) {
+    Set_Worker *worker = arg;
+    Set_Run *run = worker->run;
+    Xoshiro256 rng = xoshiro256_seed(0x5e7 + worker->index);
+    uint64_t ops = 0;
+
+    atomic_fetch_add(&run->ready, 1);
+    while(!atomic_load(&run->go)) sched_yield();
+    while(!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        uint64_t bits = xoshiro256_next(&rng);
+        int key = (int)((bits >> 32) % (uint64_t)run->key_range);
+        int dice = (int)((bits & 0xffff) % 100);
+        bool result;
+        if(dice < run->read_percent) result = set_is_member(run, key);
+        else if(dice % 2 == 0) result = set_insert(run, key);
+        else result = set_delete(run, key);
+        bench_do_not_optimize(result);
+        ops++;
+    }
+    run->ops[worker->index] = ops;
+    return NULL;
+}
+
+// @return milioni di operazioni al secondo
+static double set_measure(Set_Kind kind, int n_threads, int read_percent, int key_range, double ms) {
+    Set_Run *run = calloc(1, sizeof(*run));
+    fatal_if(run == NULL, MSG_ERR_FULL_MEMORY);
+    run->kind = kind;
+    run->key_range = key_range;
+    run->read_percent = read_percent;
+    if(kind == SET_LIST) run->list = list_init(LIST_CMP_INT);
+    else run->skiplist = skiplist_init(LIST_CMP_INT);
+
+    // metà delle chiavi presenti, inserite in ordine decrescente così la lista resta O(1) per insert
+    for(int key = key_range - 2; key >= 0; key -= 2) set_insert(run, key);
+
+    pthread_t threads[MAX_THREADS];
+    Set_Worker workers[MAX_THREADS];
+    for(int i = 0; i < n_threads; i++) {
+        workers[i] = (Set_Worker){ run, i };
+        int err = pthread_create(&threads[i], NULL, set_worker, &workers[i]);
+        fatal_if(err != 0, "could not create thread: %s", strerror(err));
+    }
+    while(atomic_load(&run->ready) < n_threads) sched_yield();
+
+    uint64_t start = profile_now_ns();
+    atomic_store(&run->go, true);
+    struct timespec ts = { (time_t)(ms/1000.0), (long)((ms - (time_t)(ms/1000.0)*1000.0)*1e6) };
+    nanosleep(&ts, NULL);
+    atomic_store(&run->stop, true);
+    for(int i = 0; i < n_threads; i++) pthread_join(threads[i], NULL);
+    uint64_t elapsed = profile_now_ns() - start;
+
+    uint64_t total = 0;
+    for(int i = 0; i < n_threads; i++) total += run->ops[i];
+
+    if(kind == SET_LIST) list_deinit(run->list);
+    else skiplist_deinit(&run->skiplist);
+    free(run);
+    return (double)total/(double)elapsed*1e3;
+}
+
+int main(int argc, char **argv) {
+    double ms = 200.0;
+    int key_range = 4096;
+    bool csv = false;
+    for(int i = 1; i < argc; i++) {
+        char *value;
+        if(bench_parse_option(argv[i], "--ms", &value)) ms = strtod(value, NULL);
+        else if(bench_parse_option(argv[i], "--range", &value)) key_range = atoi(value);
+        else if(bench_parse_option(argv[i], "--format", &value)) csv = strcmp(value, "csv") == 0;
+        else log_fatal("unknown option: %s", argv[i]);
+    }
+    fatal_if(ms <= 0.0 || key_range < 2, "invalid options");
+
+    int read_percents[] = { 100, 90, 50 };
+    int thread_counts[] = { 1, 2, 4, 8, 16, 32, 64 };
+
+    if(csv) printf("set,read_percent,threads,mops\n");
+    else printf("%-10s %6s %8s %12s\n", "set", "reads", "threads", "Mops/s");
+    for(size_t r = 0; r < ARRAY_LEN(read_percents); r++) {
+        for(size_t t = 0; t < ARRAY_LEN(thread_counts); t++) {
+            for(Set_Kind kind = SET_LIST; kind <= SET_SKIPLIST; kind++) {
+                double mops = set_measure(kind, thread_counts[t], read_percents[r], key_range, ms);
+                if(csv) printf("%s,%d,%d,%.4f\n", set_names[kind], read_percents[r], thread_counts[t], mops);
+                else printf("%-10s %5d%% %8d %12.3f\n", set_names[kind], read_percents[r], thread_counts[t], mops);
+                fflush(stdout);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,12 @@
+#include "include.c"
+#include "utils/binlog.h"
+
+int main(int argc, char **argv) {
+
+    if(argc < 2) {
+        eprintf("usage: %s <binary log>\n", argv[0]);
+        return 1;
+    }
+
+    return binlog_decode(argv[1], stdout) != 0;
+}
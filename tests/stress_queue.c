@@ -0,0 +1,291 @@
+#include <stdatomic.h>
+#include <time.h>
+
+#include "include.c"
+#include "utils/bench.h"
+#include "utils/random.h"
+#include "utils/queue.h"
+
+/*
+    Stress di queue.h: produttori e consumatori si passano interi su una coda piccola,
+    mescolando push_many/pop_many e le varianti _wait. Ogni elemento è (produttore, indice):
+    alla fine numero, somma e xor degli elementi estratti devono coincidere con quelli inseriti
+    e ogni consumatore deve vedere gli elementi di un produttore in ordine crescente.
+    I produttori si fermano ogni tanto, così i consumatori finiscono a dormire sul futex,
+    e viceversa. Ogni giro inizia riempiendo la coda e chiudendola prima di avviare i
+    consumatori: push_wait deve fallire e i consumatori devono svuotarla comunque.
+    Mpmc_Queue usa --producers e --consumers, Spsc_Ring sempre uno e uno.
+
+    Opzioni: --rounds=N, --items=N per produttore, --producers=N, --consumers=N, --capacity=N
+*/
+
+#define MAX_THREADS 64
+#define STRESS_BATCH 16
+#define STRESS_PAUSE_EVERY 4096
+
+typedef struct {
+    size_t (*push_many)(void *queue, const void *elems, size_t n);
+    size_t (*pop_many)(void *queue, void *elems, size_t max);
+    bool (*push_wait)(void *queue, const void *elem);
+    bool (*pop_wait)(void *queue, void *elem);
+    void (*close)(void *queue);
+} Stress_Queue_Ops;
+
+static size_t stress_spsc_push_many(void *q, const void *e, size_t n) { return spsc_ring_push_many(q, e, n); }
+static size_t stress_spsc_pop_many(void *q, void *e, size_t max) { return spsc_ring_pop_many(q, e, max); }
+static bool stress_spsc_push_wait(void *q, const void *e) { return spsc_ring_push_wait(q, e); }
+static bool stress_spsc_pop_wait(void *q, void *e) { return spsc_ring_pop_wait(q, e); }
+static void stress_spsc_close(void *q) { spsc_ring_close(q); }
+
+static size_t stress_mpmc_push_many(void *q, const void *e, size_t n) { return mpmc_queue_push_many(q, e, n); }
+static size_t stress_mpmc_pop_many(void *q, void *e, size_t max) { return mpmc_queue_pop_many(q, e, max); }
+static bool stress_mpmc_push_wait(void *q, const void *e) { return mpmc_queue_push_wait(q, e); }
+static bool stress_mpmc_pop_wait(void *q, void *e) { return mpmc_queue_pop_wait(q, e); }
+static void stress_mpmc_close(void *q) { mpmc_queue_close(q); }
+
+static const Stress_Queue_Ops stress_spsc_ops = {
+    stress_spsc_push_many, stress_spsc_pop_many, stress_spsc_push_wait, stress_spsc_pop_wait, stress_spsc_close,
+};
+static const Stress_Queue_Ops stress_mpmc_ops = {
+    stress_mpmc_push_many, stress_mpmc_pop_many, stress_mpmc_push_wait, stress_mpmc_pop_wait, stress_mpmc_close,
+};
+
+// conteggio, somma e xor degli elementi passati per la coda
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t xor;
+} Stress_Checksum;
+
+typedef struct {
+    const Stress_Queue_Ops *ops;
+    void *queue;
+    uint64_t items;
+    int producers;
+} Stress_Run;
+
+typedef struct {
+    Stress_Run *run;
+    int index;
+    Stress_Checksum checksum;
+    size_t errors;
+} Stress_Worker;
+
+// l'elemento porta il produttore nei bit alti e l'indice in quelli bassi
+static inline uint64_t stress_item(int producer, uint64_t i) {
+    return (uint64_t)producer << 40 | i;
+}
+
+static inline void stress_add(Stress_Checksum *c, uint64_t item) {
+    c->count++;
+    c->sum += item*0x9e3779b97f4a7c15ull;
+    c->xor ^= item;
+}
+
+static void stress_pause(Xoshiro256 *rng) {
+    struct timespec ts = { 0, (long)(50000 + xoshiro256_next(rng) % 100000) };
+    nanosleep(&ts, NULL);
+}
+
+static void *stress_producer(void *arg) {
+    Stress_Worker *worker = arg;
+    Stress_Run *run = worker->run;
+    Xoshiro256 rng = xoshiro256_seed(0x9a0d + worker->index);
+
+    for(uint64_t i = 0; i < run->items; ) {
+        uint64_t bits = xoshiro256_next(&rng);
+        if(bits % 2 == 0) {
+            uint64_t item = stress_item(worker->index, i);
+            if(!run->ops->push_wait(run->queue, &item)) {
+                log_error("producer %d: push_wait failed on an open queue", worker->index);
+                worker->errors++;
+                return NULL;
+            }
+            stress_add(&worker->checksum, item);
+            i++;
+        } else {
+            uint64_t batch[STRESS_BATCH];
+            size_t n = 1 + (bits >> 8) % STRESS_BATCH;
+            if(n > run->items - i) n = run->items - i;
+            for(size_t k = 0; k < n; k++) batch[k] = stress_item(worker->index, i + k);
+            size_t pushed = run->ops->push_many(run->queue, batch, n);
+            for(size_t k = 0; k < pushed; k++) stress_add(&worker->checksum, batch[k]);
+            i += pushed;
+            if(pushed == 0) sched_yield();
+        }
+        // lascia svuotare la coda: i consumatori finiscono sul futex di not_empty
+        if(bits % STRESS_PAUSE_EVERY == 0) stress_pause(&rng);
+    }
+    return NULL;
+}
+
+static void stress_check_order(Stress_Worker *worker, uint64_t *last, uint64_t item) {
+    int producer = (int)(item >> 40);
+    uint64_t i = item & (((uint64_t)1 << 40) - 1);
+    if(producer >= worker->run->producers) {
+        log_error("consumer %d: item %#llx from unknown producer", worker->index, (unsigned long long)item);
+        worker->errors++;
+        return;
+    }
+    // last tiene indice + 1 dell'ultimo elemento visto
+    if(i + 1 <= last[producer]) {
+        log_error("consumer %d: producer %d item %llu after %llu", worker->index, producer,
+                  (unsigned long long)i, (unsigned long long)(last[producer] - 1));
+        worker->errors++;
+    }
+    last[producer] = i + 1;
+    stress_add(&worker->checksum, item);
+}
+
+static void *stress_consumer(void *arg) {
+    Stress_Worker *worker = arg;
+    Stress_Run *run = worker->run;
+    Xoshiro256 rng = xoshiro256_seed(0xc0de + worker->index);
+    uint64_t last[MAX_THREADS + 1] = {0};
+
+    for(;;) {
+        uint64_t bits = xoshiro256_next(&rng);
+        if(bits % 2 == 0) {
+            uint64_t batch[STRESS_BATCH];
+            size_t n = run->ops->pop_many(run->queue, batch, 1 + (bits >> 8) % STRESS_BATCH);
+            for(size_t k = 0; k < n; k++) stress_check_order(worker, last, batch[k]);
+            if(n > 0) continue;
+        }
+        // pop_wait fallisce solo a coda chiusa e vuota
+        uint64_t item;
+        if(!run->ops->pop_wait(run->queue, &item)) break;
+        stress_check_order(worker, last, item);
+        // lascia riempire la coda: i produttori finiscono sul futex di not_full
+        if(bits % STRESS_PAUSE_EVERY == 1) stress_pause(&rng);
+    }
+    return NULL;
+}
+
+/*
+    Un giro: coda riempita e chiusa senza consumatori, poi svuotata; poi una coda nuova
+    con produttori e consumatori insieme, chiusa quando i produttori hanno finito
+    @return numero di errori
+*/
+static size_t stress_round(const Stress_Queue_Ops *ops, void *closed_queue, void *queue, size_t capacity,
+                           uint64_t items, int n_producers, int n_consumers) {
+    size_t errors = 0;
+    pthread_t threads[2*MAX_THREADS];
+    Stress_Worker workers[2*MAX_THREADS];
+
+    // la coda piena viene chiusa prima che esistano consumatori (il produttore fittizio è l'ultimo indice)
+    Stress_Run prefill = { .ops = ops, .queue = closed_queue, .items = capacity, .producers = MAX_THREADS + 1 };
+    Stress_Checksum filled = {0};
+    for(size_t i = 0; i < capacity; ) {
+        uint64_t batch[STRESS_BATCH];
+        size_t n = capacity - i < STRESS_BATCH ? capacity - i : STRESS_BATCH;
+        for(size_t k = 0; k < n; k++) batch[k] = stress_item(MAX_THREADS, i + k);
+        size_t pushed = ops->push_many(closed_queue, batch, n);
+        for(size_t k = 0; k < pushed; k++) stress_add(&filled, batch[k]);
+        i += pushed;
+        if(pushed == 0) {
+            log_error("prefill: queue full after %zu of %zu items", i, capacity);
+            errors++;
+            break;
+        }
+    }
+    ops->close(closed_queue);
+    uint64_t rejected = stress_item(MAX_THREADS, capacity);
+    if(ops->push_wait(closed_queue, &rejected)) {
+        log_error("push_wait succeeded on a closed queue");
+        errors++;
+    }
+    for(int i = 0; i < n_consumers; i++) {
+        workers[i] = (Stress_Worker){ .run = &prefill, .index = i };
+        int err = pthread_create(&threads[i], NULL, stress_consumer, &workers[i]);
+        fatal_if(err != 0, "could not create thread: %s", strerror(err));
+    }
+    Stress_Checksum drained = {0};
+    for(int i = 0; i < n_consumers; i++) {
+        pthread_join(threads[i], NULL);
+        errors += workers[i].errors;
+        drained.count += workers[i].checksum.count;
+        drained.sum += workers[i].checksum.sum;
+        drained.xor ^= workers[i].checksum.xor;
+    }
+    if(drained.count != filled.count || drained.sum != filled.sum || drained.xor != filled.xor) {
+        log_error("close then drain: %llu items in, %llu out", (unsigned long long)filled.count,
+                  (unsigned long long)drained.count);
+        errors++;
+    }
+
+    Stress_Run run = { .ops = ops, .queue = queue, .items = items, .producers = n_producers };
+    for(int i = 0; i < n_producers + n_consumers; i++) {
+        bool producer = i < n_producers;
+        workers[i] = (Stress_Worker){ .run = &run, .index = producer ? i : i - n_producers };
+        int err = pthread_create(&threads[i], NULL, producer ? stress_producer : stress_consumer, &workers[i]);
+        fatal_if(err != 0, "could not create thread: %s", strerror(err));
+    }
+    Stress_Checksum in = {0}, out = {0};
+    for(int i = 0; i < n_producers; i++) {
+        pthread_join(threads[i], NULL);
+        errors += workers[i].errors;
+        in.count += workers[i].checksum.count;
+        in.sum += workers[i].checksum.sum;
+        in.xor ^= workers[i].checksum.xor;
+    }
+    // i consumatori svuotano quello che resta e poi escono
+    ops->close(queue);
+    for(int i = n_producers; i < n_producers + n_consumers; i++) {
+        pthread_join(threads[i], NULL);
+        errors += workers[i].errors;
+        out.count += workers[i].checksum.count;
+        out.sum += workers[i].checksum.sum;
+        out.xor ^= workers[i].checksum.xor;
+    }
+    if(in.count != items*(uint64_t)n_producers) {
+        log_error("producers pushed %llu items, expected %llu", (unsigned long long)in.count,
+                  (unsigned long long)(items*(uint64_t)n_producers));
+        errors++;
+    }
+    if(out.count != in.count || out.sum != in.sum || out.xor != in.xor) {
+        log_error("%llu items in, %llu out, checksum %s", (unsigned long long)in.count,
+                  (unsigned long long)out.count, out.sum == in.sum && out.xor == in.xor ? "ok" : "mismatch");
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    int rounds = 5;
+    uint64_t items = 200000;
+    int n_producers = 4;
+    int n_consumers = 4;
+    size_t capacity = 64;
+    for(int i = 1; i < argc; i++) {
+        char *value;
+        if(bench_parse_option(argv[i], "--rounds", &value)) rounds = atoi(value);
+        else if(bench_parse_option(argv[i], "--items", &value)) items = strtoull(value, NULL, 10);
+        else if(bench_parse_option(argv[i], "--producers", &value)) n_producers = atoi(value);
+        else if(bench_parse_option(argv[i], "--consumers", &value)) n_consumers = atoi(value);
+        else if(bench_parse_option(argv[i], "--capacity", &value)) capacity = strtoull(value, NULL, 10);
+        else log_fatal("unknown option: %s", argv[i]);
+    }
+    fatal_if(rounds < 1 || items < 1 || items >= (uint64_t)1 << 40 || capacity < 2 ||
+             n_producers < 1 || n_producers > MAX_THREADS || n_consumers < 1 || n_consumers > MAX_THREADS,
+             "invalid options");
+
+    size_t spsc_errors = 0, mpmc_errors = 0;
+    for(int round = 0; round < rounds; round++) {
+        Spsc_Ring closed_ring = spsc_ring_init(capacity, sizeof(uint64_t));
+        Spsc_Ring ring = spsc_ring_init(capacity, sizeof(uint64_t));
+        spsc_errors += stress_round(&stress_spsc_ops, &closed_ring, &ring, closed_ring.capacity, items, 1, 1);
+        spsc_ring_deinit(&closed_ring);
+        spsc_ring_deinit(&ring);
+
+        Mpmc_Queue closed_queue = mpmc_queue_init(capacity, sizeof(uint64_t));
+        Mpmc_Queue queue = mpmc_queue_init(capacity, sizeof(uint64_t));
+        mpmc_errors += stress_round(&stress_mpmc_ops, &closed_queue, &queue, closed_queue.capacity,
+                                    items, n_producers, n_consumers);
+        mpmc_queue_deinit(&closed_queue);
+        mpmc_queue_deinit(&queue);
+    }
+    log_info("spsc: %d rounds, %llu items: %zu errors", rounds, (unsigned long long)items, spsc_errors);
+    log_info("mpmc: %d rounds, %d producers, %d consumers, %llu items each: %zu errors", rounds,
+             n_producers, n_consumers, (unsigned long long)items, mpmc_errors);
+    return spsc_errors + mpmc_errors == 0 ? 0 : 1;
+}
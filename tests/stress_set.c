@@ -0,0 +1,134 @@
+#include <stdatomic.h>
+#include <time.h>
+
+#include "include.c"
+#include "utils/bench.h"
+#include "utils/random.h"
+#include "utils/skiplist.h"
+
+/*
+    Stress di skiplist.h con poche chiavi e molti thread, così insert e delete della stessa
+    chiave si sovrappongono di continuo. Alla fine di ogni giro libera tutti i nodi in limbo
+    e controlla la struttura su ogni livello: chiavi strettamente crescenti, nessun nodo
+    marcato ancora collegato, ogni nodo di un livello alto presente anche al livello 0.
+    Compilato con ASan (make stress-set), un nodo liberato ma ancora raggiungibile
+    viene segnalato come use-after-free.
+
+    Opzioni: --ms=X durata di un giro, --rounds=N giri, --threads=N, --range=N chiavi possibili
+*/
+
+#define MAX_THREADS 64
+
+typedef struct {
+    Skiplist set;
+    int key_range;
+    _Atomic bool stop;
+} Stress_Run;
+
+typedef struct {
+    Stress_Run *run;
+    int index;
+} Stress_Worker;
+
+static void *stress_worker(void *arg) {
+    Stress_Worker *worker = arg;
+    Stress_Run *run = worker->run;
+    Xoshiro256 rng = xoshiro256_seed(0x57e55 + worker->index);
+
+    while(!atomic_load_explicit(&run->stop, memory_order_relaxed)) {
+        uint64_t bits = xoshiro256_next(&rng);
+        int key = (int)((bits >> 32) % (uint64_t)run->key_range);
+        switch(bits % 3) {
+        case 0: {
+            int *value = malloc(sizeof(*value));
+            fatal_if(value == NULL, MSG_ERR_FULL_MEMORY);
+            *value = key;
+            if(!skiplist_insert(&run->set, value)) free(value);
+        } break;
+        case 1:
+            skiplist_delete(&run->set, &key);
+            break;
+        default:
+            skiplist_is_member(&run->set, &key);
+            break;
+        }
+    }
+    return NULL;
+}
+
+// @return numero di errori trovati nella struttura
+static size_t stress_check(Skiplist *set) {
+    size_t errors = 0, length = 0;
+    for(int level = 0; level < SKIPLIST_MAX_LEVEL; level++) {
+        Skiplist_Node *prev = NULL;
+        for(uintptr_t it = atomic_load(&set->head->next[level]); skiplist_ptr(it) != NULL; ) {
+            Skiplist_Node *node = skiplist_ptr(it);
+            it = atomic_load(&node->next[level]);
+            if(level == 0) length++;
+            if(skiplist_marked(it)) {
+                log_error("level %d: removed node %d still linked", level, *(int*)node->data_p);
+                errors++;
+            }
+            if(prev != NULL && set->compare(prev->data_p, node->data_p) >= 0) {
+                log_error("level %d: keys out of order (%d, %d)", level, *(int*)prev->data_p, *(int*)node->data_p);
+                errors++;
+            }
+            if(level > 0) {
+                bool found = false;
+                for(uintptr_t x = atomic_load(&set->head->next[0]); skiplist_ptr(x) != NULL && !found; ) {
+                    found = skiplist_ptr(x) == node;
+                    x = atomic_load(&skiplist_ptr(x)->next[0]);
+                }
+                if(!found) {
+                    log_error("level %d: node %d not linked at level 0", level, *(int*)node->data_p);
+                    errors++;
+                }
+            }
+            prev = node;
+        }
+    }
+    if(length != skiplist_length(set)) {
+        log_error("%zu nodes at level 0, skiplist_length says %zu", length, skiplist_length(set));
+        errors++;
+    }
+    return errors;
+}
+
+int main(int argc, char **argv) {
+    double ms = 200.0;
+    int rounds = 10;
+    int n_threads = 16;
+    int key_range = 4;
+    for(int i = 1; i < argc; i++) {
+        char *value;
+        if(bench_parse_option(argv[i], "--ms", &value)) ms = strtod(value, NULL);
+        else if(bench_parse_option(argv[i], "--rounds", &value)) rounds = atoi(value);
+        else if(bench_parse_option(argv[i], "--threads", &value)) n_threads = atoi(value);
+        else if(bench_parse_option(argv[i], "--range", &value)) key_range = atoi(value);
+        else log_fatal("unknown option: %s", argv[i]);
+    }
+    fatal_if(ms <= 0.0 || rounds < 1 || n_threads < 1 || n_threads > MAX_THREADS || key_range < 1, "invalid options");
+
+    size_t errors = 0;
+    for(int round = 0; round < rounds; round++) {
+        Stress_Run run = { .set = skiplist_init(LIST_CMP_INT), .key_range = key_range };
+        pthread_t threads[MAX_THREADS];
+        Stress_Worker workers[MAX_THREADS];
+        for(int i = 0; i < n_threads; i++) {
+            workers[i] = (Stress_Worker){ &run, i };
+            int err = pthread_create(&threads[i], NULL, stress_worker, &workers[i]);
+            fatal_if(err != 0, "could not create thread: %s", strerror(err));
+        }
+        struct timespec ts = { (time_t)(ms/1000.0), (long)((ms - (time_t)(ms/1000.0)*1000.0)*1e6) };
+        nanosleep(&ts, NULL);
+        atomic_store(&run.stop, true);
+        for(int i = 0; i < n_threads; i++) pthread_join(threads[i], NULL);
+
+        // i limbo dei worker terminati sono orfani: tre avanzamenti li liberano tutti
+        for(int i = 0; i < 3; i++) epoch_reclaim();
+        errors += stress_check(&run.set);
+        skiplist_deinit(&run.set);
+    }
+    log_info("%d rounds, %d threads, %d keys: %zu errors", rounds, n_threads, key_range, errors);
+    return errors == 0 ? 0 : 1;
+}
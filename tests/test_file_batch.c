@@ -0,0 +1,89 @@
+#include <sys/resource.h>
+
+#include "include.c"
+#include "utils/file_batch.h"
+
+/*
+    Legge con file_batch_read e con file_batch_read_pread più file di quanti
+    RLIMIT_NOFILE permetta di tenerne aperti insieme, con file mancanti e una cartella,
+    e controlla contenuto ed errori di ognuno
+*/
+
+#define FILES 1200
+#define FILE_LIMIT 64
+#define DIR "/tmp/utils_test_file_batch"
+
+static char names[FILES][64];
+static Cstr *paths[FILES];
+static File_Batch_Result results[FILES];
+
+static bool is_missing(size_t i) { return i % 97 == 5; }
+static size_t file_length(size_t i) { return (i*37) % 20000; }
+static char file_byte(size_t i, size_t k) { return 'a' + (i + k) % 26; }
+
+static size_t check(Cstr *name, size_t failed) {
+    size_t bad = 0, expected = 0;
+    for(size_t i = 0; i < FILES; i++) {
+        File_Batch_Result *r = &results[i];
+        if(i == 7) {
+            expected++;
+            bad += r->error != EISDIR;
+            continue;
+        }
+        if(is_missing(i)) {
+            expected++;
+            bad += r->error != ENOENT;
+            continue;
+        }
+        if(r->error != 0 || r->content.length != file_length(i)) {
+            log_error("%s: file %zu: error %d, length %zu", name, i, r->error, r->content.length);
+            bad++;
+            continue;
+        }
+        for(size_t k = 0; k < file_length(i); k++) {
+            if(r->content.data[k] != file_byte(i, k)) {
+                log_error("%s: file %zu: wrong byte at %zu", name, i, k);
+                bad++;
+                break;
+            }
+        }
+    }
+    if(failed != expected) {
+        log_error("%s: %zu failed files, expected %zu", name, failed, expected);
+        bad++;
+    }
+    log_info("%s: %zu files, %zu failed, %zu wrong", name, (size_t)FILES, failed, bad);
+    return bad;
+}
+
+int main(void) {
+    mkdir(DIR, 0755);
+    for(size_t i = 0; i < FILES; i++) {
+        snprintf(names[i], sizeof(names[i]), DIR "/%zu", i);
+        paths[i] = names[i];
+        if(is_missing(i)) continue;
+        FILE *f = fopen(names[i], "wb");
+        fatal_if(f == NULL, "could not create %s", names[i]);
+        for(size_t k = 0; k < file_length(i); k++) fputc(file_byte(i, k), f);
+        fclose(f);
+    }
+    paths[7] = DIR;
+
+    // il pool va creato prima di abbassare il limite, servono descrittori anche a lui
+    threadpool_default();
+    struct rlimit limit;
+    getrlimit(RLIMIT_NOFILE, &limit);
+    limit.rlim_cur = FILE_LIMIT;
+    fatal_if(setrlimit(RLIMIT_NOFILE, &limit) != 0, "could not lower RLIMIT_NOFILE");
+
+    size_t bad = 0;
+    Arena a = {0};
+    bad += check("file_batch_read", file_batch_read(&a, paths, FILES, results));
+    arena_reset(&a);
+    bad += check("file_batch_read_pread", file_batch_read_pread(&a, paths, FILES, results));
+    arena_free(&a);
+
+    for(size_t i = 0; i < FILES; i++) if(!is_missing(i)) unlink(names[i]);
+    rmdir(DIR);
+    return bad == 0 ? 0 : 1;
+}
@@ -7,6 +7,14 @@
 
 #include <string.h>
 #include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "macros.h"
+#include "logging.h"
 
 #ifndef ARENADEF
 #define ARENADEF static inline
@@ -26,14 +34,20 @@ struct Region {
     uintptr_t data[];
 };
 
+typedef struct Arena_File_Header Arena_File_Header;
+
 /*
     Rappresenta l'arena, con i sui vari campi può suddividere le arene
-    per marchiare le regioni con poca memoria o con nessuna (o quasi nessuna) rimasta
+    per marchiare le regioni con poca memoria o con nessuna (o quasi nessuna) rimasta.
+    Se file non è NULL l'arena è mappata su un file (vedi arena_map e arena_restore)
+    e le allocazioni vengono prese dalla mappatura invece che dalle regioni.
 */
 typedef struct {
     Region *start;
     Region *not_allocable;
     Region *low_memory;
+    Arena_File_Header *file; // inizio della mappatura, NULL se l'arena vive nello heap
+    int fd;                  // -1 se la mappatura è privata e il file non va più scritto
 } Arena;
 
 
@@ -70,9 +84,103 @@ ARENADEF void *arena_realloc(Arena *a,void *oldptr, size_t oldsz, size_t newsz);
 ARENADEF void arena_reset(Arena *a);
 /*
     libera la memoria usata dall'arena
+    @note per un'arena mappata toglie solo la mappatura, il file resta
 */
 ARENADEF void arena_free(Arena *a);
 
+/*
+    Arena persistente: tutta la memoria sta in un file mappato sempre allo stesso
+    indirizzo, quindi i puntatori salvati dentro l'arena (String_Builder, nodi, matrici...)
+    restano validi in un altro processo senza deserializzare né correggere niente.
+    Un processo costruisce i dati e chiama arena_snapshot, quelli successivi chiamano
+    arena_restore: una sola mmap, le pagine vengono lette dal disco solo quando servono.
+
+    Esempio:
+        Arena a = {0};
+        arena_map(&a, "index.arena", NULL, 16ull << 30);
+        Index *idx = build_index(&a);
+        arena_snapshot(&a, idx);
+
+        Arena b = {0};
+        Index *idx;
+        arena_restore(&b, "index.arena", (void**)&idx, false);
+
+    @note persiste solo la memoria presa dall'arena: puntatori a memoria allocata
+          con malloc (es. sb_append o una sso fuori dall'arena) non sono validi dopo il restore
+    @note il file vale solo sulla stessa architettura e con lo stesso layout delle struct
+*/
+
+// indirizzo di default delle mappature, lontano da heap, librerie e stack su x86_64 e aarch64
+#ifndef ARENA_MAP_BASE
+#define ARENA_MAP_BASE ((uintptr_t)0x6f0000000000)
+#endif // ARENA_MAP_BASE
+
+// di quanto cresce il file quando la parte allocata lo supera
+#ifndef ARENA_FILE_GROW
+#define ARENA_FILE_GROW (64*1024*1024)
+#endif // ARENA_FILE_GROW
+
+#define ARENA_FILE_MAGIC "UTILSARN"
+#define ARENA_FILE_VERSION 1
+#define ARENA_FILE_ENDIAN_TAG 0x01020304u
+#define ARENA_FILE_ALIGNMENT 64
+
+struct Arena_File_Header {
+    char magic[8];
+    uint32_t endian;        // ARENA_FILE_ENDIAN_TAG nell'ordine dei byte di chi ha creato il file
+    uint16_t version;
+    uint16_t pointer_size;
+    uint64_t base;          // indirizzo a cui il file deve essere mappato
+    uint64_t capacity;      // byte di spazio di indirizzi riservati, il file non può superarli
+    uint64_t used;          // byte allocati, header compreso
+    uint64_t size;          // lunghezza attuale del file
+    uint64_t root;          // puntatore passato all'ultima arena_snapshot
+    uint8_t reserved[ARENA_FILE_ALIGNMENT - 56];
+};
+
+_Static_assert(sizeof(Arena_File_Header) == ARENA_FILE_ALIGNMENT, "arena file header must fill one block");
+
+/*
+    Crea (o tronca) il file e ci mappa sopra l'arena: da qui in poi tutte le allocazioni
+    finiscono nel file, che cresce a blocchi di ARENA_FILE_GROW
+
+    @param a arena vuota
+    @param path file da creare
+    @param base indirizzo della mappatura, NULL per ARENA_MAP_BASE.
+                Arene persistenti usate insieme devono avere basi diverse
+    @param capacity byte massimi dell'arena, riservati solo come spazio di indirizzi
+
+    @return 0 oppure l'errno che ha fatto fallire la creazione
+    @note se l'arena si riempie il programma termina, i dati non possono finire nello heap
+*/
+ARENADEF Errno arena_map(Arena *a, Cstr *path, void *base, size_t capacity);
+/*
+    Salva nel file il puntatore radice e aspetta che tutto sia scritto su disco
+
+    @param a arena creata con arena_map o ripristinata con arena_restore(..., true)
+    @param root puntatore dentro l'arena da cui ripartire, restituito da arena_restore
+
+    @return 0 oppure l'errno della scrittura
+    @note la mappatura è condivisa: anche le modifiche fatte dopo finiscono nel file,
+          lo snapshot garantisce solo che quelle precedenti siano su disco
+*/
+ARENADEF Errno arena_snapshot(Arena *a, void *root);
+/*
+    Mappa un file salvato con arena_snapshot all'indirizzo in cui era stato creato
+
+    @param a arena vuota
+    @param path file da mappare
+    @param root riceve il puntatore passato ad arena_snapshot
+    @param writeback se true le modifiche e le nuove allocazioni vanno nel file
+                     e si può chiamare di nuovo arena_snapshot; se false la mappatura è
+                     copy-on-write, il file non viene toccato e, finito lo spazio già
+                     presente nel file, si alloca nello heap
+
+    @return 0, EINVAL se il file non è valido, EEXIST se l'indirizzo è occupato,
+            oppure l'errno di open/mmap
+*/
+ARENADEF Errno arena_restore(Arena *a, Cstr *path, void **root, bool writeback);
+
 #ifdef STRINGS_H_
 #include "strings.h"
 
@@ -115,6 +223,13 @@ ARENADEF bool arena_sb_read_entire_file(String_Builder *sb, Arena *a, Cstr *path
 ARENADEF void arena_sb_append_cstr(String_Builder *sb,Arena *a, Cstr *data);
 ARENADEF void arena_sb_to_cstr(String_Builder *sb, Arena *a);
 
+/*
+    Come sso_append_sv, ma quando la stringa non sta più inline la memoria viene presa
+    dall'arena: sso_free non la libera, sparisce con l'arena
+*/
+ARENADEF void arena_sso_append_sv(String_Sso *sso, Arena *a, String_View sv);
+ARENADEF String_Sso arena_sso_from_sv(Arena *a, String_View sv);
+
 #endif // STRINGS_H_
 
 /* ---------------------- IMPLEMENTATION ---------------------- */
@@ -123,45 +238,31 @@ Region *new_region(size_t capacity) {
     Region *r = (Region*)malloc(sizeof(Region) + sizeof(uintptr_t)*capacity);
     assert(r != NULL && "Memory full, buy more RAM");
     r->next = NULL;
+    r->previous = NULL;
     r->length = 0;
     r->capacity = capacity;
     return r;
 }
 
 void push_start(Arena *a, Region *r) {
-    if(a->start == NULL) {
-        a->start = r;
-    } else {
-        Region *x = a->start;
-        a->start = r;
-        r->next = x;
-        x->previous = r;
-        r->previous = NULL;
-    }
+    r->previous = NULL;
+    r->next = a->start;
+    if(a->start != NULL) a->start->previous = r;
+    a->start = r;
 }
 
 void push_low_memory(Arena *a, Region *r) {
-    if(a->low_memory == NULL)
-        a->low_memory = r;
-    else {
-        Region *x = a->low_memory;
-        a->low_memory = r;
-        r->next = x;
-        x->previous = r;
-        r->previous = NULL;
-    }
+    r->previous = NULL;
+    r->next = a->low_memory;
+    if(a->low_memory != NULL) a->low_memory->previous = r;
+    a->low_memory = r;
 }
 
 void push_not_allocable(Arena *a, Region *r) {
-    if(a->not_allocable == NULL)
-        a->not_allocable = r;
-    else {
-        Region *x = a->not_allocable;
-        a->not_allocable = r;
-        r->next = x;
-        x->previous = r;
-        r->previous = NULL;
-    }
+    r->previous = NULL;
+    r->next = a->not_allocable;
+    if(a->not_allocable != NULL) a->not_allocable->previous = r;
+    a->not_allocable = r;
 }
 
 Region *pop_low_memory(Arena *a) {
@@ -173,16 +274,58 @@ Region *pop_low_memory(Arena *a) {
 }
 
 Region *pop_start(Arena *a) {
-    if(a->low_memory == NULL) return NULL;
+    if(a->start == NULL) return NULL;
     Region *result = a->start;
     a->start = result->next;
     if(a->start != NULL) a->start->previous = NULL;
     return result;
 }
 
+// toglie x dalla lista start, ovunque si trovi
+void unlink_start(Arena *a, Region *x) {
+    if(x->previous != NULL) x->previous->next = x->next;
+    else a->start = x->next;
+    if(x->next != NULL) x->next->previous = x->previous;
+}
+
+// i kernel prima del 4.17 lo ignorano e la usano come suggerimento, l'indirizzo va ricontrollato
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif // MAP_FIXED_NOREPLACE
+
+/*
+    Prende size_bytes dalla mappatura, allungando il file se serve
+    @return NULL se non c'è spazio
+*/
+static inline void *arena_file_alloc(Arena *a, size_t size_bytes) {
+    Arena_File_Header *h = a->file;
+    size_t size = (size_bytes + sizeof(uintptr_t) - 1)/sizeof(uintptr_t)*sizeof(uintptr_t);
+    if(size > h->capacity - h->used) return NULL;
+
+    if(h->used + size > h->size) {
+        // una mappatura privata non può allungare il file
+        if(a->fd < 0) return NULL;
+        size_t grown = (h->used + size + ARENA_FILE_GROW - 1)/ARENA_FILE_GROW*ARENA_FILE_GROW;
+        if(grown > h->capacity) grown = h->capacity;
+        if(ftruncate(a->fd, grown) != 0) return NULL;
+        h->size = grown;
+    }
+
+    void *result = (char*)h + h->used;
+    h->used += size;
+    return result;
+}
+
 void *arena_alloc(Arena *a, size_t size_bytes) {
     if(size_bytes == 0) return NULL;
     void *result = NULL;
+
+    if(a->file != NULL) {
+        result = arena_file_alloc(a, size_bytes);
+        if(result != NULL) return result;
+        fatal_if(a->fd >= 0, "arena: the mapped file is full (%zu bytes)", (size_t)a->file->capacity);
+    }
+
     // aggiungo byte per assicurarmi che viene allocato un numero >= di bytes in input
     size_t size = (size_bytes + sizeof(uintptr_t) - 1)/sizeof(uintptr_t);
 
@@ -238,17 +381,11 @@ void *arena_alloc(Arena *a, size_t size_bytes) {
             
             //TODO: invertire queste condizioni
             if(x->capacity - x->length < NOT_ALLOCABLE_REGION_THRESHOLD) {
+                unlink_start(a, x);
                 push_not_allocable(a, x);
-
-                if(x->previous != NULL)
-                    x->previous->next = x->next;
-                else a->start = NULL;
             } else if(x->capacity - x->length < LOW_MEMORY_REGION_THRESHOLD) {
+                unlink_start(a, x);
                 push_low_memory(a, x);
-
-                if(x->previous != NULL)
-                    x->previous->next = x->next;
-                else a->start = NULL;
             }
         }
     }
@@ -270,14 +407,21 @@ void *arena_realloc(Arena *a,void *oldptr, size_t oldsz, size_t newsz) {
 }
 
 void arena_reset(Arena *a) {
+    if(a->file != NULL) {
+        a->file->used = sizeof(Arena_File_Header);
+        a->file->root = 0;
+    }
     for(Region *it=a->start; it != NULL; it = it->next) {
         it->length = 0;
     }
-    for(Region *it=a->low_memory; it != NULL; it = it->next) {
+    // push_start cambia it->next, quindi il successivo va letto prima
+    for(Region *it=a->low_memory, *next; it != NULL; it = next) {
+        next = it->next;
         it->length = 0;
         push_start(a, it);
     }
-    for(Region *it=a->not_allocable; it != NULL; it = it->next) {
+    for(Region *it=a->not_allocable, *next; it != NULL; it = next) {
+        next = it->next;
         it->length = 0;
         push_start(a, it);
     }
@@ -294,6 +438,12 @@ void free_regions(Region *r) {
 }
 
 void arena_free(Arena *a) {
+    if(a->file != NULL) {
+        munmap(a->file, a->file->capacity);
+        if(a->fd >= 0) close(a->fd);
+        a->file = NULL;
+        a->fd = -1;
+    }
     free_regions(a->start);
     free_regions(a->not_allocable);
     free_regions(a->low_memory);
@@ -302,6 +452,147 @@ void arena_free(Arena *a) {
     a->low_memory = NULL;
 }
 
+/*
+    Mappa capacity byte di fd a base, senza mai sovrascrivere mappature già presenti
+*/
+static inline Errno arena_file_mmap(Arena *a, int fd, uintptr_t base, size_t capacity, bool shared, Cstr *path) {
+    int flags = (shared ? MAP_SHARED : MAP_PRIVATE) | MAP_FIXED_NOREPLACE;
+    void *mapping = mmap((void*)base, capacity, PROT_READ | PROT_WRITE, flags, fd, 0);
+    if(mapping == MAP_FAILED) {
+        int err = errno;
+        log_error("Could not map the file '%s' at %p, errno: %s", path, (void*)base, strerror(err));
+        return err;
+    }
+    if((uintptr_t)mapping != base) {
+        munmap(mapping, capacity);
+        log_error("Could not map the file '%s' at %p: address already in use", path, (void*)base);
+        return EEXIST;
+    }
+    a->file = (Arena_File_Header*)mapping;
+    return 0;
+}
+
+Errno arena_map(Arena *a, Cstr *path, void *base, size_t capacity) {
+    Errno result = 0;
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t addr = base != NULL ? (uintptr_t)base : ARENA_MAP_BASE;
+    capacity = (capacity + page - 1)/page*page;
+
+    assert(a->file == NULL && "arena_map on an already mapped arena");
+    if(addr % page != 0 || capacity < page) {
+        log_error("arena_map: base must be page aligned and capacity at least one page");
+        return EINVAL;
+    }
+
+    int fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if(fd < 0) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    size_t size = capacity < ARENA_FILE_GROW ? capacity : ARENA_FILE_GROW;
+    if(ftruncate(fd, size) != 0) {
+        int err = errno;
+        log_error("Could not resize the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    Errno map_err = arena_file_mmap(a, fd, addr, capacity, true, path);
+    if(map_err != 0) return_defer(map_err);
+
+    Arena_File_Header *h = a->file;
+    memcpy(h->magic, ARENA_FILE_MAGIC, sizeof(h->magic));
+    h->endian = ARENA_FILE_ENDIAN_TAG;
+    h->version = ARENA_FILE_VERSION;
+    h->pointer_size = sizeof(void*);
+    h->base = addr;
+    h->capacity = capacity;
+    h->used = sizeof(*h);
+    h->size = size;
+    h->root = 0;
+    a->fd = fd;
+    fd = -1;
+
+defer:
+    if(fd >= 0) close(fd);
+    return result;
+}
+
+Errno arena_snapshot(Arena *a, void *root) {
+    Arena_File_Header *h = a->file;
+    if(h == NULL || a->fd < 0) {
+        log_error("arena_snapshot: the arena is not backed by a writable file");
+        return EINVAL;
+    }
+    assert((root == NULL || ((uintptr_t)root >= h->base && (uintptr_t)root < h->base + h->used))
+           && "arena_snapshot: root must point inside the arena");
+
+    h->root = (uintptr_t)root;
+    size_t page = sysconf(_SC_PAGESIZE);
+    if(msync(h, (h->used + page - 1)/page*page, MS_SYNC) != 0 || fdatasync(a->fd) != 0) {
+        int err = errno;
+        log_error("Could not write the arena snapshot, errno: %s", strerror(err));
+        return err;
+    }
+    return 0;
+}
+
+Errno arena_restore(Arena *a, Cstr *path, void **root, bool writeback) {
+    Errno result = 0;
+    struct stat st;
+    Arena_File_Header h;
+    size_t page = sysconf(_SC_PAGESIZE);
+
+    assert(a->file == NULL && "arena_restore on an already mapped arena");
+    *root = NULL;
+
+    int fd = open(path, writeback ? O_RDWR : O_RDONLY);
+    if(fd < 0) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    if(fstat(fd, &st) < 0) {
+        int err = errno;
+        log_error("Could not stat the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    if((size_t)st.st_size < sizeof(h) || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)
+       || memcmp(h.magic, ARENA_FILE_MAGIC, sizeof(h.magic)) != 0) {
+        log_error("'%s' is not an arena file", path);
+        return_defer(EINVAL);
+    }
+    if(h.endian != ARENA_FILE_ENDIAN_TAG || h.version != ARENA_FILE_VERSION || h.pointer_size != sizeof(void*)) {
+        log_error("'%s': arena file made by another architecture or version", path);
+        return_defer(EINVAL);
+    }
+    if(h.base % page != 0 || h.capacity % page != 0 || h.used > (uint64_t)st.st_size
+       || (uint64_t)st.st_size > h.capacity || h.used < sizeof(h)) {
+        log_error("'%s': corrupted arena file", path);
+        return_defer(EINVAL);
+    }
+
+    // una mappatura privata scrivibile viene contata tutta nella memoria impegnata,
+    // quindi si mappa solo il file: tanto non può crescere
+    size_t length = writeback ? h.capacity : (size_t)(st.st_size + page - 1)/page*page;
+    Errno map_err = arena_file_mmap(a, fd, h.base, length, writeback, path);
+    if(map_err != 0) return_defer(map_err);
+
+    // le pagine oltre la fine del file non vanno mai toccate (SIGBUS)
+    a->file->size = st.st_size;
+    a->file->capacity = length;
+    *root = (void*)(uintptr_t)a->file->root;
+    if(writeback) {
+        a->fd = fd;
+        fd = -1;
+    } else {
+        a->fd = -1;
+    }
+
+defer:
+    if(fd >= 0) close(fd);
+    return result;
+}
+
 #ifdef STRINGS_H_
 
 String_Builder arena_sb_from_sv(Arena *a, String_View sv) {
@@ -360,6 +651,21 @@ void arena_sb_to_cstr(String_Builder *sb, Arena *a) {
     sb->length--;
 }
 
+void arena_sso_append_sv(String_Sso *sso, Arena *a, String_View sv) {
+    size_t needed = sso_length(sso) + sv.length;
+    if (needed > sso_capacity(sso)) {
+        size_t capacity = sso_grown_capacity(sso, needed);
+        sso_move_to(sso, arena_alloc(a, capacity + 1), capacity, true);
+    }
+    sso_append_sv(sso, sv);
+}
+
+String_Sso arena_sso_from_sv(Arena *a, String_View sv) {
+    String_Sso sso = {0};
+    arena_sso_append_sv(&sso, a, sv);
+    return sso;
+}
+
 #endif // STRINGS_H_
 
 #endif // ARENA_H_
\ No newline at end of file
@@ -0,0 +1,306 @@
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "profile.h"
+
+#ifndef BENCHDEF
+#define BENCHDEF static inline
+#endif // BENCHDEF
+
+/*
+    Micro-benchmark con warmup, numero di iterazioni automatico e statistiche robuste.
+
+    Ogni benchmark è una funzione che esegue iters volte l'operazione da misurare:
+    il ciclo sta dentro la funzione, così la chiamata indiretta non pesa sulla misura.
+    Dopo il warmup le iterazioni vengono scelte in modo che un campione duri circa
+    sample_ms; per ogni campione si ricava il tempo per iterazione e sull'insieme dei
+    campioni si calcolano mediana, MAD (deviazione assoluta mediana), minimo e media.
+
+    Uso tipico:
+        Bench b = bench_init(argc, argv);
+        bench_run(&b, "memcpy 4KiB", bench_memcpy, &ctx);
+        bench_report(&b);
+        bench_free(&b);
+
+    Da riga di comando: --format=text|csv|json, --filter=sottostringa,
+    --samples=N, --sample-ms=X, --warmup-ms=X
+*/
+
+typedef enum {
+    BENCH_TEXT,
+    BENCH_CSV,
+    BENCH_JSON,
+} Bench_Format;
+
+typedef void (*Bench_Fn)(void *ctx, uint64_t iters);
+
+typedef struct {
+    Cstr *name;
+    uint64_t iters;       // iterazioni per campione
+    size_t samples;
+    double median_ns;     // tutti i tempi sono per singola iterazione
+    double mad_ns;
+    double min_ns;
+    double mean_ns;
+    double items_per_iter; // se > 0 il report aggiunge il throughput in elementi/s
+} Bench_Result;
+
+typedef struct {
+    Bench_Format format;
+    Cstr *filter;         // NULL = esegue tutti i benchmark
+    size_t samples;
+    double warmup_ms;
+    double sample_ms;
+    FILE *out;
+    Bench_Result *data;
+    size_t length;
+    size_t capacity;
+} Bench;
+
+#define BENCH_DEFAULT_SAMPLES 15
+#define BENCH_DEFAULT_WARMUP_MS 50.0
+#define BENCH_DEFAULT_SAMPLE_MS 10.0
+
+/*
+    Impedisce al compilatore di eliminare il calcolo di value o di considerarlo costante:
+    per lui value viene letto e poi modificato, senza costi a runtime
+    @param value variabile (lvalue) da rendere opaca
+*/
+#define bench_do_not_optimize(value) __asm__ volatile("" : "+r,m"(value) : : "memory")
+
+/*
+    Barriera di memoria per il compilatore: le scritture fatte prima risultano osservate
+*/
+#define bench_clobber() __asm__ volatile("" : : : "memory")
+
+/*
+    Crea il contesto dei benchmark con i parametri di default, sovrascritti
+    dalle opzioni della riga di comando (argc = 0 le ignora)
+    @note le opzioni sconosciute terminano il programma con log_fatal
+*/
+BENCHDEF Bench bench_init(int argc, char **argv);
+
+/*
+    Esegue e registra un benchmark
+    @param name nome del benchmark, usato anche dal filtro (deve restare valido fino al report)
+    @param fn funzione che esegue iters iterazioni dell'operazione
+    @param ctx argomento passato a fn
+    @return risultato registrato (valido fino al prossimo bench_run), NULL se il benchmark è escluso dal filtro
+*/
+BENCHDEF Bench_Result *bench_run(Bench *b, Cstr *name, Bench_Fn fn, void *ctx);
+
+/*
+    Come bench_run, con il throughput in elementi al secondo nel report
+    @param items_per_iter elementi (byte, numeri, nodi...) processati in una iterazione
+*/
+BENCHDEF Bench_Result *bench_run_items(Bench *b, Cstr *name, Bench_Fn fn, void *ctx, double items_per_iter);
+
+/*
+    Scrive tutti i risultati in b->out nel formato scelto
+*/
+BENCHDEF void bench_report(Bench *b);
+
+BENCHDEF void bench_free(Bench *b);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+BENCHDEF bool bench_parse_option(char *arg, Cstr *name, char **value) {
+    size_t len = strlen(name);
+    if(strncmp(arg, name, len) != 0 || arg[len] != '=') return false;
+    *value = arg + len + 1;
+    return true;
+}
+
+Bench bench_init(int argc, char **argv) {
+    Bench b = {0};
+    b.format = BENCH_TEXT;
+    b.samples = BENCH_DEFAULT_SAMPLES;
+    b.warmup_ms = BENCH_DEFAULT_WARMUP_MS;
+    b.sample_ms = BENCH_DEFAULT_SAMPLE_MS;
+    b.out = stdout;
+
+    for(int i = 1; i < argc; i++) {
+        char *value;
+        if(bench_parse_option(argv[i], "--format", &value)) {
+            if(strcmp(value, "text") == 0) b.format = BENCH_TEXT;
+            else if(strcmp(value, "csv") == 0) b.format = BENCH_CSV;
+            else if(strcmp(value, "json") == 0) b.format = BENCH_JSON;
+            else log_fatal("unknown bench format: %s", value);
+        } else if(bench_parse_option(argv[i], "--filter", &value)) {
+            b.filter = value;
+        } else if(bench_parse_option(argv[i], "--samples", &value)) {
+            b.samples = strtoul(value, NULL, 10);
+        } else if(bench_parse_option(argv[i], "--sample-ms", &value)) {
+            b.sample_ms = strtod(value, NULL);
+        } else if(bench_parse_option(argv[i], "--warmup-ms", &value)) {
+            b.warmup_ms = strtod(value, NULL);
+        } else {
+            log_fatal("unknown bench option: %s", argv[i]);
+        }
+    }
+    fatal_if(b.samples == 0 || b.sample_ms <= 0.0 || b.warmup_ms < 0.0, "invalid bench parameters");
+    return b;
+}
+
+BENCHDEF uint64_t bench_time_ns(Bench_Fn fn, void *ctx, uint64_t iters) {
+    uint64_t start = profile_now_ns();
+    fn(ctx, iters);
+    bench_clobber();
+    return profile_now_ns() - start;
+}
+
+BENCHDEF int bench_compare_double(const void *_this, const void *_that) {
+    double a = *(const double*)_this;
+    double b = *(const double*)_that;
+    return (a > b) - (a < b);
+}
+
+// ordina values
+BENCHDEF double bench_median(double *values, size_t n) {
+    qsort(values, n, sizeof(*values), bench_compare_double);
+    if(n % 2 == 1) return values[n/2];
+    return (values[n/2 - 1] + values[n/2])*0.5;
+}
+
+/*
+    Warmup e calibrazione: cresce di 10 volte finché un campione è troppo breve per
+    essere misurato bene, poi stima le iterazioni necessarie per durare sample_ns.
+    Continua finché non è passato almeno warmup_ns, così cache, TLB e frequenza
+    della CPU sono a regime quando iniziano i campioni.
+*/
+BENCHDEF uint64_t bench_calibrate(Bench_Fn fn, void *ctx, uint64_t warmup_ns, uint64_t sample_ns) {
+    uint64_t iters = 1;
+    uint64_t start = profile_now_ns();
+    for(;;) {
+        uint64_t elapsed = bench_time_ns(fn, ctx, iters);
+        if(elapsed < sample_ns/10) {
+            iters *= 10;
+            continue;
+        }
+        double per_iter = (double)elapsed/(double)iters;
+        iters = (uint64_t)ceil((double)sample_ns/per_iter);
+        if(iters == 0) iters = 1;
+        if(profile_now_ns() - start >= warmup_ns) break;
+    }
+    return iters;
+}
+
+Bench_Result *bench_run_items(Bench *b, Cstr *name, Bench_Fn fn, void *ctx, double items_per_iter) {
+    if(b->filter != NULL && strstr(name, b->filter) == NULL) return NULL;
+
+    uint64_t iters = bench_calibrate(fn, ctx, (uint64_t)(b->warmup_ms*1e6), (uint64_t)(b->sample_ms*1e6));
+
+    double *times = malloc(b->samples*sizeof(*times));
+    fatal_if(times == NULL, MSG_ERR_FULL_MEMORY);
+
+    Bench_Result r = {0};
+    r.name = name;
+    r.iters = iters;
+    r.samples = b->samples;
+    r.items_per_iter = items_per_iter;
+    r.min_ns = INFINITY;
+
+    double sum = 0.0;
+    for(size_t i = 0; i < b->samples; i++) {
+        times[i] = (double)bench_time_ns(fn, ctx, iters)/(double)iters;
+        sum += times[i];
+        if(times[i] < r.min_ns) r.min_ns = times[i];
+    }
+    r.mean_ns = sum/(double)b->samples;
+    r.median_ns = bench_median(times, b->samples);
+    for(size_t i = 0; i < b->samples; i++) {
+        times[i] = fabs(times[i] - r.median_ns);
+    }
+    r.mad_ns = bench_median(times, b->samples);
+    free(times);
+
+    append(b, r);
+    return &b->data[b->length - 1];
+}
+
+Bench_Result *bench_run(Bench *b, Cstr *name, Bench_Fn fn, void *ctx) {
+    return bench_run_items(b, name, fn, ctx, 0.0);
+}
+
+// stampa un tempo in ns con l'unità più leggibile
+BENCHDEF void bench_print_time(FILE *out, double ns) {
+    if(ns < 1e3) fprintf(out, " %9.2f ns", ns);
+    else if(ns < 1e6) fprintf(out, " %9.2f us", ns/1e3);
+    else if(ns < 1e9) fprintf(out, " %9.2f ms", ns/1e6);
+    else fprintf(out, " %9.2f s ", ns/1e9);
+}
+
+// stampa la stringa come stringa JSON (o CSV, stesse regole per le virgolette)
+BENCHDEF void bench_print_quoted(FILE *out, Cstr *s, char escape) {
+    fputc('"', out);
+    for(; *s != '\0'; s++) {
+        if(*s == '"' || (escape == '\\' && *s == '\\')) fputc(escape, out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+void bench_report(Bench *b) {
+    FILE *out = b->out;
+    switch(b->format) {
+    case BENCH_TEXT:
+        fprintf(out, "%-36s %12s %12s %12s %12s %14s\n", "benchmark", "median", "mad", "min", "mean", "throughput");
+        for(size_t i = 0; i < b->length; i++) {
+            Bench_Result *r = &b->data[i];
+            fprintf(out, "%-36s", r->name);
+            bench_print_time(out, r->median_ns);
+            bench_print_time(out, r->mad_ns);
+            bench_print_time(out, r->min_ns);
+            bench_print_time(out, r->mean_ns);
+            if(r->items_per_iter > 0.0) {
+                fprintf(out, " %10.2f M/s", r->items_per_iter/r->median_ns*1e3);
+            }
+            fputc('\n', out);
+        }
+        break;
+    case BENCH_CSV:
+        fprintf(out, "name,iters,samples,median_ns,mad_ns,min_ns,mean_ns,items_per_second\n");
+        for(size_t i = 0; i < b->length; i++) {
+            Bench_Result *r = &b->data[i];
+            bench_print_quoted(out, r->name, '"');
+            fprintf(out, ",%llu,%zu,%.3f,%.3f,%.3f,%.3f,%.6g\n", (unsigned long long)r->iters, r->samples,
+                    r->median_ns, r->mad_ns, r->min_ns, r->mean_ns,
+                    r->items_per_iter > 0.0 ? r->items_per_iter/r->median_ns*1e9 : 0.0);
+        }
+        break;
+    case BENCH_JSON:
+        fprintf(out, "{\n  \"benchmarks\": [\n");
+        for(size_t i = 0; i < b->length; i++) {
+            Bench_Result *r = &b->data[i];
+            fprintf(out, "    {\"name\": ");
+            bench_print_quoted(out, r->name, '\\');
+            fprintf(out, ", \"iters\": %llu, \"samples\": %zu, \"median_ns\": %.3f, \"mad_ns\": %.3f, "
+                         "\"min_ns\": %.3f, \"mean_ns\": %.3f", (unsigned long long)r->iters, r->samples,
+                    r->median_ns, r->mad_ns, r->min_ns, r->mean_ns);
+            if(r->items_per_iter > 0.0) {
+                fprintf(out, ", \"items_per_second\": %.6g", r->items_per_iter/r->median_ns*1e9);
+            }
+            fprintf(out, "}%s\n", i + 1 < b->length ? "," : "");
+        }
+        fprintf(out, "  ]\n}\n");
+        break;
+    }
+    fflush(out);
+}
+
+void bench_free(Bench *b) {
+    free(b->data);
+    b->data = NULL;
+    b->length = 0;
+    b->capacity = 0;
+}
+
+#endif // BENCH_H_
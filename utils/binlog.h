@@ -0,0 +1,729 @@
+#ifndef BINLOG_H_
+#define BINLOG_H_
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "macros.h"
+#include "logging.h"
+
+#ifndef BINLOGDEF
+#define BINLOGDEF static inline
+#endif // BINLOGDEF
+
+/*
+    Logging binario con formattazione differita: ogni punto di chiamata registra la sua
+    stringa di formato una sola volta (ID statico), e poi scrive solo ID, timestamp e
+    i byte grezzi degli argomenti in un buffer del thread. Il testo viene prodotto
+    offline da binlog_decode.
+
+    Formato del file: header (magic "UTILSBLG", versione, istante di apertura),
+    poi record che iniziano con un ID a 32 bit:
+        ID 0: definizione di un punto di chiamata
+            (u32 id, u8 livello, u32 riga, u16 + file, u16 + formato, stringhe terminate da '\0')
+        ID > 0: messaggio (u64 nanosecondi dall'apertura, argomenti)
+    Gli argomenti sono interi a 32 o 64 bit, double, long double, puntatori e
+    stringhe (u32 lunghezza + byte), nell'ordine in cui compaiono nel formato.
+*/
+
+// numero massimo di argomenti per messaggio
+#ifndef BINLOG_MAX_ARGS
+#define BINLOG_MAX_ARGS 16
+#endif // BINLOG_MAX_ARGS
+
+// le stringhe più lunghe vengono troncate
+#ifndef BINLOG_MAX_STRING
+#define BINLOG_MAX_STRING 1024
+#endif // BINLOG_MAX_STRING
+
+// buffer di ogni thread, scritto sul file con una write quando è pieno
+#ifndef BINLOG_BUFFER_SIZE
+#define BINLOG_BUFFER_SIZE (64*1024)
+#endif // BINLOG_BUFFER_SIZE
+
+typedef enum {
+    BINLOG_ARG_I32 = 1,
+    BINLOG_ARG_I64,
+    BINLOG_ARG_DOUBLE,
+    BINLOG_ARG_LDOUBLE,
+    BINLOG_ARG_PTR,
+    BINLOG_ARG_STRING
+} binlog_arg_t;
+
+/*
+    Punto di chiamata: una variabile statica per ogni uso delle macro binlog_*
+*/
+typedef struct {
+    Cstr *format;
+    Cstr *file;
+    uint32_t line;
+    log_t level;
+    uint32_t id;
+    _Atomic uint64_t generation; // file in cui la definizione è già stata scritta
+    int n_args;
+    uint8_t args[BINLOG_MAX_ARGS];
+} Binlog_Site;
+
+/*
+    Apre il file di log binario (troncandolo) e attiva le macro binlog_*
+    @return 0 se ha successo, altrimenti errno
+    @note il file viene chiuso anche all'uscita del programma (atexit)
+*/
+BINLOGDEF Errno binlog_open(Cstr *path);
+
+/*
+    Scrive i buffer di tutti i thread e chiude il file
+    @note gli altri thread non devono loggare durante la chiamata
+*/
+BINLOGDEF void binlog_close(void);
+
+/*
+    Scrive sul file il buffer del thread chiamante
+*/
+BINLOGDEF void binlog_flush(void);
+
+/*
+    Decodifica un file di log binario in testo, una riga per messaggio:
+    "[secondi dall'apertura] LIVELLO: messaggio", con i messaggi dei vari thread
+    ordinati per timestamp
+    @return 0 se ha successo, altrimenti errno (EINVAL se il file è corrotto: vengono
+    comunque stampati i messaggi fino al primo record non valido)
+*/
+BINLOGDEF Errno binlog_decode(Cstr *path, FILE *out);
+
+/*
+    Registra il punto di chiamata se necessario e scrive il messaggio. Usare le macro.
+*/
+BINLOGDEF void binlog_write(Binlog_Site *site, ...);
+
+/*
+    Il printf dentro if (0) non viene mai eseguito (e non valuta gli argomenti),
+    serve solo a far controllare al compilatore formato e tipi come per log_info
+*/
+#define binlog_message(level, format, ...)                                                     \
+    do {                                                                                       \
+        static Binlog_Site binlog_site_ = { (format), __FILE__, __LINE__, (level), 0, 0, 0, {0} }; \
+        if (0) printf(format, ##__VA_ARGS__);                                                  \
+        if ((level) >= LOG_COMPILE_LEVEL && (level) >= log_level && binlog_state.fd >= 0)     \
+            binlog_write(&binlog_site_, ##__VA_ARGS__);                                        \
+    } while (0)
+
+// chiamata rimossa sotto LOG_COMPILE_LEVEL: niente sito, niente formato nel binario, niente controllo
+#define binlog_stripped(format, ...) do { if (0) printf(format, ##__VA_ARGS__); } while (0)
+
+#if LOG_COMPILE_LEVEL <= 1
+#define binlog_debug(format, ...) binlog_message(LOG_DEBUG, format, ##__VA_ARGS__)
+#else
+#define binlog_debug(format, ...) binlog_stripped(format, ##__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 2
+#define binlog_info(format, ...) binlog_message(LOG_INFO, format, ##__VA_ARGS__)
+#else
+#define binlog_info(format, ...) binlog_stripped(format, ##__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 3
+#define binlog_warning(format, ...) binlog_message(LOG_WARNING, format, ##__VA_ARGS__)
+#else
+#define binlog_warning(format, ...) binlog_stripped(format, ##__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 4
+#define binlog_error(format, ...) binlog_message(LOG_ERROR, format, ##__VA_ARGS__)
+#else
+#define binlog_error(format, ...) binlog_stripped(format, ##__VA_ARGS__)
+#endif
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+#define BINLOG_MAGIC "UTILSBLG"
+#define BINLOG_VERSION 1
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t start_realtime_ns;
+} Binlog_File_Header;
+
+typedef struct Binlog_Buffer {
+    struct Binlog_Buffer *prev;
+    struct Binlog_Buffer *next;
+    size_t length;
+    char data[BINLOG_BUFFER_SIZE];
+} Binlog_Buffer;
+
+typedef struct {
+    int fd;
+    uint64_t generation;
+    uint64_t start_ns;
+    uint32_t next_id;
+    bool exit_registered;
+    pthread_key_t key;
+    pthread_once_t key_once;
+    pthread_mutex_t mutex;
+    Binlog_Buffer *buffers; // buffer di tutti i thread vivi
+} Binlog_State;
+
+SHARED_GLOBAL Binlog_State binlog_state = {
+    .fd = -1,
+    .key_once = PTHREAD_ONCE_INIT,
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+SHARED_GLOBAL _Thread_local Binlog_Buffer *binlog_thread_buffer;
+
+// record più lungo possibile: ID, timestamp e argomenti tutti stringhe di lunghezza massima
+#define BINLOG_MAX_RECORD (4 + 8 + BINLOG_MAX_ARGS*(4 + BINLOG_MAX_STRING))
+
+_Static_assert(BINLOG_MAX_RECORD <= BINLOG_BUFFER_SIZE, "BINLOG_BUFFER_SIZE must hold the largest record");
+
+static inline uint64_t binlog_clock_ns(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/*
+    Una conversione del formato, da begin (il '%') a end (dopo il carattere di conversione)
+*/
+typedef struct {
+    Cstr *begin;
+    Cstr *end;
+    int n_stars;        // larghezza e/o precisione passate come argomenti int
+    binlog_arg_t type;
+} Binlog_Spec;
+
+/*
+    Cerca la prossima conversione a partire da format, saltando i "%%"
+    @return 1 se l'ha trovata, 0 se non ce ne sono altre, -1 se non è supportata
+*/
+static inline int binlog_next_spec(Cstr *format, Binlog_Spec *spec) {
+    Cstr *p = format;
+    for (;;) {
+        p = strchr(p, '%');
+        if (p == NULL) return 0;
+        if (p[1] != '%') break;
+        p += 2;
+    }
+    spec->begin = p++;
+    spec->n_stars = 0;
+    spec->type = 0;
+    while (*p && strchr("-+ #0'", *p)) p++;
+    if (*p == '*') { spec->n_stars++; p++; }
+    while (*p >= '0' && *p <= '9') p++;
+    if (*p == '.') {
+        p++;
+        if (*p == '*') { spec->n_stars++; p++; }
+        while (*p >= '0' && *p <= '9') p++;
+    }
+    int longs = 0;
+    bool long_double = false;
+    while (*p && strchr("hlLqjzt", *p)) {
+        if (*p == 'l' || *p == 'q' || *p == 'j' || *p == 'z' || *p == 't') longs++;
+        if (*p == 'L') long_double = true;
+        p++;
+    }
+    switch (*p) {
+    case 'd': case 'i': case 'u': case 'o': case 'x': case 'X':
+        spec->type = longs > 0 ? BINLOG_ARG_I64 : BINLOG_ARG_I32;
+        break;
+    case 'c':
+        spec->type = BINLOG_ARG_I32;
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        spec->type = long_double ? BINLOG_ARG_LDOUBLE : BINLOG_ARG_DOUBLE;
+        break;
+    case 'p':
+        spec->type = BINLOG_ARG_PTR;
+        break;
+    case 's':
+        if (longs > 0) return -1;
+        spec->type = BINLOG_ARG_STRING;
+        break;
+    default:
+        // %n, %ls e conversioni sconosciute
+        return -1;
+    }
+    spec->end = p + 1;
+    return 1;
+}
+
+/*
+    Ricava i tipi degli argomenti dal formato
+    @return numero di argomenti, -1 se il formato non è supportato
+*/
+static inline int binlog_parse_format(Cstr *format, uint8_t *args) {
+    int n_args = 0;
+    Binlog_Spec spec;
+    int found;
+    for (Cstr *p = format; (found = binlog_next_spec(p, &spec)) > 0; p = spec.end) {
+        if (n_args + spec.n_stars + 1 > BINLOG_MAX_ARGS) return -1;
+        for (int i = 0; i < spec.n_stars; i++) args[n_args++] = BINLOG_ARG_I32;
+        args[n_args++] = spec.type;
+    }
+    return found < 0 ? -1 : n_args;
+}
+
+static inline void binlog_write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0) return;
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+static inline void binlog_flush_buffer(Binlog_Buffer *buffer) {
+    // il file è aperto in O_APPEND: la write di un buffer intero non si mescola con quelle degli altri thread
+    if (buffer->length > 0 && binlog_state.fd >= 0) binlog_write_all(binlog_state.fd, buffer->data, buffer->length);
+    buffer->length = 0;
+}
+
+static inline void binlog_thread_exit(void *arg) {
+    Binlog_Buffer *buffer = (Binlog_Buffer*)arg;
+    pthread_mutex_lock(&binlog_state.mutex);
+    binlog_flush_buffer(buffer);
+    if (buffer->prev) buffer->prev->next = buffer->next;
+    else binlog_state.buffers = buffer->next;
+    if (buffer->next) buffer->next->prev = buffer->prev;
+    pthread_mutex_unlock(&binlog_state.mutex);
+    free(buffer);
+}
+
+static inline void binlog_create_key(void) {
+    int err = pthread_key_create(&binlog_state.key, binlog_thread_exit);
+    fatal_if(err != 0, "binlog: could not create the thread key: %s", strerror(err));
+}
+
+static inline Binlog_Buffer *binlog_get_buffer(void) {
+    Binlog_Buffer *buffer = binlog_thread_buffer;
+    if (buffer != NULL) return buffer;
+
+    buffer = (Binlog_Buffer*)malloc(sizeof(*buffer));
+    fatal_if(buffer == NULL, MSG_ERR_FULL_MEMORY);
+    buffer->length = 0;
+    buffer->prev = NULL;
+    pthread_mutex_lock(&binlog_state.mutex);
+    buffer->next = binlog_state.buffers;
+    if (buffer->next) buffer->next->prev = buffer;
+    binlog_state.buffers = buffer;
+    pthread_mutex_unlock(&binlog_state.mutex);
+    pthread_setspecific(binlog_state.key, buffer);
+    binlog_thread_buffer = buffer;
+    return buffer;
+}
+
+// percorso lento: prima chiamata del punto di chiamata in questo file
+static inline void binlog_define_site(Binlog_Site *site) {
+    pthread_mutex_lock(&binlog_state.mutex);
+    if (atomic_load_explicit(&site->generation, memory_order_relaxed) != binlog_state.generation) {
+        if (site->id == 0) {
+            site->n_args = binlog_parse_format(site->format, site->args);
+            fatal_if(site->n_args < 0, "binlog: unsupported format \"%s\" at %s:%u", site->format, site->file, site->line);
+            site->id = ++binlog_state.next_id;
+        }
+        size_t file_len = strlen(site->file) + 1;
+        size_t format_len = strlen(site->format) + 1;
+        fatal_if(file_len > UINT16_MAX || format_len > UINT16_MAX,
+            "binlog: file name or format at %s:%u is too long", site->file, site->line);
+
+        size_t size = 4 + 4 + 1 + 4 + 2 + file_len + 2 + format_len;
+        char *record = (char*)malloc(size);
+        fatal_if(record == NULL, MSG_ERR_FULL_MEMORY);
+        char *p = record;
+        uint32_t zero = 0, line = site->line;
+        uint16_t len16;
+        uint8_t level = (uint8_t)site->level;
+        memcpy(p, &zero, 4); p += 4;
+        memcpy(p, &site->id, 4); p += 4;
+        memcpy(p, &level, 1); p += 1;
+        memcpy(p, &line, 4); p += 4;
+        len16 = (uint16_t)file_len;
+        memcpy(p, &len16, 2); p += 2;
+        memcpy(p, site->file, file_len); p += file_len;
+        len16 = (uint16_t)format_len;
+        memcpy(p, &len16, 2); p += 2;
+        memcpy(p, site->format, format_len);
+        // scritta subito: i messaggi che usano l'ID finiscono nel file solo dopo
+        binlog_write_all(binlog_state.fd, record, size);
+        free(record);
+        atomic_store_explicit(&site->generation, binlog_state.generation, memory_order_release);
+    }
+    pthread_mutex_unlock(&binlog_state.mutex);
+}
+
+void binlog_write(Binlog_Site *site, ...) {
+    if (atomic_load_explicit(&site->generation, memory_order_acquire) != binlog_state.generation) {
+        binlog_define_site(site);
+    }
+    Binlog_Buffer *buffer = binlog_get_buffer();
+    if (BINLOG_BUFFER_SIZE - buffer->length < BINLOG_MAX_RECORD) binlog_flush_buffer(buffer);
+
+    char *p = buffer->data + buffer->length;
+    memcpy(p, &site->id, 4);
+    p += 4;
+    uint64_t timestamp = binlog_clock_ns(CLOCK_MONOTONIC) - binlog_state.start_ns;
+    memcpy(p, &timestamp, 8);
+    p += 8;
+
+    va_list ap;
+    va_start(ap, site);
+    for (int i = 0; i < site->n_args; i++) {
+        switch ((binlog_arg_t)site->args[i]) {
+        case BINLOG_ARG_I32: {
+            int v = va_arg(ap, int);
+            memcpy(p, &v, 4);
+            p += 4;
+        } break;
+        case BINLOG_ARG_I64: {
+            long long v = va_arg(ap, long long);
+            memcpy(p, &v, 8);
+            p += 8;
+        } break;
+        case BINLOG_ARG_DOUBLE: {
+            double v = va_arg(ap, double);
+            memcpy(p, &v, 8);
+            p += 8;
+        } break;
+        case BINLOG_ARG_LDOUBLE: {
+            long double v = va_arg(ap, long double);
+            memcpy(p, &v, sizeof(v));
+            p += sizeof(v);
+        } break;
+        case BINLOG_ARG_PTR: {
+            uint64_t v = (uint64_t)(uintptr_t)va_arg(ap, void*);
+            memcpy(p, &v, 8);
+            p += 8;
+        } break;
+        case BINLOG_ARG_STRING: {
+            Cstr *s = va_arg(ap, Cstr*);
+            if (s == NULL) s = "(null)";
+            size_t len = strnlen(s, BINLOG_MAX_STRING);
+            uint32_t len32 = (uint32_t)len;
+            memcpy(p, &len32, 4);
+            memcpy(p + 4, s, len);
+            p += 4 + len;
+        } break;
+        }
+    }
+    va_end(ap);
+    buffer->length = p - buffer->data;
+}
+
+void binlog_flush(void) {
+    if (binlog_thread_buffer != NULL) binlog_flush_buffer(binlog_thread_buffer);
+}
+
+static inline void binlog_at_exit(void) {
+    binlog_close();
+}
+
+Errno binlog_open(Cstr *path) {
+    Errno result = 0;
+
+    if (binlog_state.fd >= 0) binlog_close();
+    pthread_once(&binlog_state.key_once, binlog_create_key);
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        result = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(result));
+        return result;
+    }
+
+    Binlog_File_Header header = {0};
+    memcpy(header.magic, BINLOG_MAGIC, sizeof(header.magic));
+    header.version = BINLOG_VERSION;
+    header.start_realtime_ns = binlog_clock_ns(CLOCK_REALTIME);
+    if (write(fd, &header, sizeof(header)) != (ssize_t)sizeof(header)) {
+        result = errno;
+        log_error("Could not write the file '%s', errno: %s", path, strerror(result));
+        close(fd);
+        return result;
+    }
+
+    pthread_mutex_lock(&binlog_state.mutex);
+    binlog_state.start_ns = binlog_clock_ns(CLOCK_MONOTONIC);
+    // i punti di chiamata già registrati riscrivono la definizione nel nuovo file
+    binlog_state.generation++;
+    binlog_state.fd = fd;
+    if (!binlog_state.exit_registered) {
+        atexit(binlog_at_exit);
+        binlog_state.exit_registered = true;
+    }
+    pthread_mutex_unlock(&binlog_state.mutex);
+    return result;
+}
+
+void binlog_close(void) {
+    pthread_mutex_lock(&binlog_state.mutex);
+    if (binlog_state.fd >= 0) {
+        for (Binlog_Buffer *b = binlog_state.buffers; b != NULL; b = b->next) binlog_flush_buffer(b);
+        close(binlog_state.fd);
+        binlog_state.fd = -1;
+    }
+    pthread_mutex_unlock(&binlog_state.mutex);
+}
+
+/*
+    Lettore sequenziale del file per il decoder
+*/
+typedef struct {
+    const char *data;
+    size_t length;
+    size_t pos;
+    bool error;
+} Binlog_Reader;
+
+static inline Cstr *binlog_read(Binlog_Reader *r, void *out, size_t size) {
+    if (r->error || r->length - r->pos < size) {
+        r->error = true;
+        if (out) memset(out, 0, size);
+        return "";
+    }
+    Cstr *p = r->data + r->pos;
+    if (out) memcpy(out, p, size);
+    r->pos += size;
+    return p;
+}
+
+// copia il testo tra due conversioni, con "%%" -> "%"
+static inline void binlog_put_literal(Cstr *begin, Cstr *end, FILE *out) {
+    for (Cstr *q = begin; q < end; q++) {
+        fputc(*q, out);
+        if (q[0] == '%' && q[1] == '%') q++;
+    }
+}
+
+static inline void binlog_decode_message(Binlog_Reader *r, Binlog_Site *site, FILE *out) {
+    uint64_t timestamp;
+    binlog_read(r, &timestamp, 8);
+    fprintf(out, "[%12.6f] %s: ", (double)timestamp*1e-9, log_to_cstr(site->level));
+
+    Cstr *p = site->format;
+    Binlog_Spec spec;
+    char spec_buf[128];
+    for (; binlog_next_spec(p, &spec) > 0 && !r->error; p = spec.end) {
+        binlog_put_literal(p, spec.begin, out);
+        // gli '*' vengono sostituiti dai valori letti
+        size_t n = 0;
+        for (Cstr *q = spec.begin; q < spec.end && n < sizeof(spec_buf) - 16; q++) {
+            if (*q == '*') {
+                int32_t v;
+                binlog_read(r, &v, 4);
+                n += snprintf(spec_buf + n, sizeof(spec_buf) - n, "%d", v);
+            } else {
+                spec_buf[n++] = *q;
+            }
+        }
+        spec_buf[n] = '\0';
+
+        switch (spec.type) {
+        case BINLOG_ARG_I32: {
+            int32_t v;
+            binlog_read(r, &v, 4);
+            fprintf(out, spec_buf, v);
+        } break;
+        case BINLOG_ARG_I64: {
+            long long v;
+            binlog_read(r, &v, 8);
+            fprintf(out, spec_buf, v);
+        } break;
+        case BINLOG_ARG_DOUBLE: {
+            double v;
+            binlog_read(r, &v, 8);
+            fprintf(out, spec_buf, v);
+        } break;
+        case BINLOG_ARG_LDOUBLE: {
+            long double v;
+            binlog_read(r, &v, sizeof(v));
+            fprintf(out, spec_buf, v);
+        } break;
+        case BINLOG_ARG_PTR: {
+            uint64_t v;
+            binlog_read(r, &v, 8);
+            fprintf(out, spec_buf, (void*)(uintptr_t)v);
+        } break;
+        case BINLOG_ARG_STRING: {
+            uint32_t len;
+            binlog_read(r, &len, 4);
+            Cstr *s = binlog_read(r, NULL, len);
+            // la stringa nel file non è terminata, la precisione limita la lettura
+            char *copy = (char*)malloc(len + 1);
+            fatal_if(copy == NULL, MSG_ERR_FULL_MEMORY);
+            size_t copied = r->error ? 0 : len;
+            memcpy(copy, s, copied);
+            copy[copied] = '\0';
+            fprintf(out, spec_buf, copy);
+            free(copy);
+        } break;
+        }
+    }
+    binlog_put_literal(p, p + strlen(p), out);
+    fputc('\n', out);
+}
+
+// avanza oltre gli argomenti di un messaggio senza formattarli
+static inline void binlog_skip_args(Binlog_Reader *r, Binlog_Site *site) {
+    for (int i = 0; i < site->n_args; i++) {
+        switch ((binlog_arg_t)site->args[i]) {
+        case BINLOG_ARG_I32:
+            binlog_read(r, NULL, 4);
+            break;
+        case BINLOG_ARG_I64:
+        case BINLOG_ARG_DOUBLE:
+        case BINLOG_ARG_PTR:
+            binlog_read(r, NULL, 8);
+            break;
+        case BINLOG_ARG_LDOUBLE:
+            binlog_read(r, NULL, sizeof(long double));
+            break;
+        case BINLOG_ARG_STRING: {
+            uint32_t len;
+            binlog_read(r, &len, 4);
+            binlog_read(r, NULL, len);
+        } break;
+        }
+    }
+}
+
+typedef struct {
+    Binlog_Site *data;
+    size_t length;
+    size_t capacity;
+} Binlog_Sites;
+
+typedef struct {
+    uint64_t timestamp;
+    size_t pos;     // inizio del timestamp nel file
+    uint32_t id;
+} Binlog_Entry;
+
+typedef struct {
+    Binlog_Entry *data;
+    size_t length;
+    size_t capacity;
+} Binlog_Entries;
+
+// a parità di timestamp resta l'ordine del file
+static inline int binlog_entry_cmp(const void *a, const void *b) {
+    const Binlog_Entry *x = (const Binlog_Entry*)a;
+    const Binlog_Entry *y = (const Binlog_Entry*)b;
+    if (x->timestamp != y->timestamp) return x->timestamp < y->timestamp ? -1 : 1;
+    return (x->pos > y->pos) - (x->pos < y->pos);
+}
+
+// definizione di un punto di chiamata: file e formato puntano dentro i dati del file
+static inline void binlog_read_site(Binlog_Reader *r, Binlog_Sites *sites) {
+    uint32_t id, line;
+    uint8_t level;
+    uint16_t file_len, format_len;
+    binlog_read(r, &id, 4);
+    binlog_read(r, &level, 1);
+    binlog_read(r, &line, 4);
+    binlog_read(r, &file_len, 2);
+    Cstr *file = binlog_read(r, NULL, file_len);
+    binlog_read(r, &format_len, 2);
+    Cstr *format = binlog_read(r, NULL, format_len);
+    if (r->error || id == 0 || level < LOG_DEBUG || level > LOG_FATAL || file_len == 0 || format_len == 0 ||
+        file[file_len - 1] != '\0' || format[format_len - 1] != '\0') {
+        r->error = true;
+        return;
+    }
+    if (id > sites->capacity) {
+        size_t capacity = sites->capacity == 0 ? INIT_CAP : sites->capacity;
+        while (capacity < id) capacity *= 2;
+        sites->data = (Binlog_Site*)realloc(sites->data, capacity*sizeof(*sites->data));
+        fatal_if(sites->data == NULL, MSG_ERR_FULL_MEMORY);
+        memset(sites->data + sites->capacity, 0, (capacity - sites->capacity)*sizeof(*sites->data));
+        sites->capacity = capacity;
+    }
+    if (id > sites->length) sites->length = id;
+    Binlog_Site *site = &sites->data[id - 1];
+    site->file = file;
+    site->format = format;
+    site->line = line;
+    site->level = (log_t)level;
+    site->id = id;
+    site->n_args = binlog_parse_format(site->format, site->args);
+    if (site->n_args < 0) r->error = true;
+}
+
+Errno binlog_decode(Cstr *path, FILE *out) {
+    Errno result = 0;
+    char *data = NULL;
+    Binlog_Sites sites = {0};
+    Binlog_Entries entries = {0};
+
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        result = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(result));
+        return_defer(result);
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    data = (char*)malloc(size > 0 ? size : 1);
+    fatal_if(data == NULL, MSG_ERR_FULL_MEMORY);
+    if (size < 0 || fread(data, 1, size, f) != (size_t)size) {
+        result = errno ? errno : EIO;
+        log_error("Could not read the file '%s', errno: %s", path, strerror(result));
+        return_defer(result);
+    }
+
+    Binlog_File_Header header;
+    if ((size_t)size < sizeof(header) ||
+        (memcpy(&header, data, sizeof(header)),
+         memcmp(header.magic, BINLOG_MAGIC, sizeof(header.magic)) != 0 || header.version != BINLOG_VERSION)) {
+        log_error("'%s' is not a binary log file", path);
+        return_defer(EINVAL);
+    }
+
+    // la definizione di un punto di chiamata precede sempre i suoi messaggi
+    Binlog_Reader r = { .data = data, .length = (size_t)size, .pos = sizeof(header) };
+    while (r.pos < r.length && !r.error) {
+        uint32_t id;
+        binlog_read(&r, &id, 4);
+        if (id == 0) {
+            binlog_read_site(&r, &sites);
+        } else if (id > sites.length || sites.data[id - 1].id == 0) {
+            r.error = true;
+        } else {
+            Binlog_Entry entry = { .pos = r.pos, .id = id };
+            binlog_read(&r, &entry.timestamp, 8);
+            binlog_skip_args(&r, &sites.data[id - 1]);
+            if (!r.error) append(&entries, entry);
+        }
+    }
+    // un file troncato (es. dopo un crash) viene decodificato fino all'ultimo record completo
+    if (r.error) {
+        log_error("'%s' is truncated or corrupted at byte %zu", path, r.pos);
+        result = EINVAL;
+        r.error = false;
+    }
+
+    // ogni thread scrive il suo buffer quando è pieno: si rimettono insieme per tempo
+    qsort(entries.data, entries.length, sizeof(*entries.data), binlog_entry_cmp);
+    for (size_t i = 0; i < entries.length; i++) {
+        r.pos = entries.data[i].pos;
+        binlog_decode_message(&r, &sites.data[entries.data[i].id - 1], out);
+    }
+
+defer:
+    free(entries.data);
+    free(sites.data);
+    free(data);
+    if (f) fclose(f);
+    return result;
+}
+
+#endif // BINLOG_H_
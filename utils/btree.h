@@ -0,0 +1,582 @@
+#ifndef BTREE_H_
+#define BTREE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "arena.h"
+
+#ifndef BTREEDEF
+#define BTREEDEF static inline
+#endif // BTREEDEF
+
+/*
+    B+-tree: mappa ordinata da chiavi intere a puntatori, per indici troppo grandi per list.h.
+
+    Le chiavi di ogni nodo sono contigue e il nodo occupa poche linee di cache: la ricerca
+    dentro un nodo conta con confronti SIMD quante chiavi sono minori del valore cercato,
+    senza salti imprevedibili. I valori stanno solo nelle foglie, collegate in ordine,
+    così le scansioni di intervalli proseguono di foglia in foglia.
+
+    I nodi vengono presi da un'arena e quelli liberati da delete vengono riusati;
+    btree_deinit libera tutto in una volta.
+
+    @note non è thread-safe: usare un lock esterno se più thread lo modificano
+*/
+
+typedef int64_t Btree_Key;
+
+// chiavi per nodo: 32 chiavi da 8 byte = 4 linee di cache (multiplo della larghezza SIMD)
+#ifndef BTREE_NODE_KEYS
+#define BTREE_NODE_KEYS 32
+#endif // BTREE_NODE_KEYS
+
+// sotto questo numero di chiavi un nodo (non radice) prende chiavi dal vicino o si unisce
+#define BTREE_MIN_KEYS ((BTREE_NODE_KEYS - 1)/2)
+
+#ifndef BTREE_SIMD_BYTES
+#if defined(__AVX512F__)
+#define BTREE_SIMD_BYTES 64
+#elif defined(__AVX__)
+#define BTREE_SIMD_BYTES 32
+#else
+#define BTREE_SIMD_BYTES 16
+#endif
+#endif // BTREE_SIMD_BYTES
+
+// confronti vettoriali solo dove esistono in hardware per interi a 64 bit (SSE2 non ha pcmpgtq)
+#ifndef BTREE_SIMD_SEARCH
+#if defined(__SSE4_2__) || defined(__aarch64__)
+#define BTREE_SIMD_SEARCH 1
+#else
+#define BTREE_SIMD_SEARCH 0
+#endif
+#endif // BTREE_SIMD_SEARCH
+
+typedef struct Btree_Node Btree_Node;
+
+/*
+    Parte comune di foglie e nodi interni. Le posizioni oltre count contengono
+    INT64_MAX, così la ricerca può scorrere sempre tutto l'array.
+*/
+struct Btree_Node {
+    _Alignas(64) Btree_Key keys[BTREE_NODE_KEYS];
+    uint32_t count;
+    uint32_t leaf;
+};
+
+typedef struct Btree_Leaf Btree_Leaf;
+
+struct Btree_Leaf {
+    Btree_Node base;
+    void *values[BTREE_NODE_KEYS];
+    Btree_Leaf *next; // foglia successiva in ordine, NULL = ultima
+};
+
+/*
+    Il figlio i contiene le chiavi k con keys[i-1] <= k < keys[i]
+*/
+typedef struct {
+    Btree_Node base;
+    Btree_Node *children[BTREE_NODE_KEYS + 1];
+} Btree_Inner;
+
+typedef struct {
+    Btree_Node *root;
+    size_t length;
+    size_t height;           // 1 = la radice è una foglia
+    Arena arena;
+    Btree_Leaf *free_leaves; // nodi liberati, collegati tramite next
+    Btree_Inner *free_inners; // collegati tramite children[0]
+} Btree;
+
+/*
+    Posizione in una foglia, ottenuta da btree_first o btree_lower_bound
+*/
+typedef struct {
+    Btree_Leaf *leaf;
+    uint32_t index;
+} Btree_Iter;
+
+BTREEDEF Btree btree_init(void);
+/*
+    Libera tutti i nodi (i valori restano del chiamante)
+*/
+BTREEDEF void btree_deinit(Btree *tree);
+/*
+    Cerca una chiave
+    @param value se non NULL riceve il valore associato
+    @return true se la chiave è presente
+    @note O(log n)
+*/
+BTREEDEF bool btree_get(Btree *tree, Btree_Key key, void **value);
+/*
+    Associa value a key, sovrascrivendo il valore precedente
+    @return true se la chiave non era presente
+*/
+BTREEDEF bool btree_insert(Btree *tree, Btree_Key key, void *value);
+/*
+    Elimina una chiave
+    @param value se non NULL riceve il valore che era associato
+    @return false se la chiave non era presente
+*/
+BTREEDEF bool btree_delete(Btree *tree, Btree_Key key, void **value);
+/*
+    Costruisce l'albero da chiavi già ordinate in O(n), con foglie piene
+    @param tree albero vuoto (appena creato con btree_init)
+    @param keys chiavi strettamente crescenti
+    @param values valori delle chiavi, NULL = tutti NULL
+    @return 0, EINVAL se le chiavi non sono strettamente crescenti o l'albero non è vuoto
+*/
+BTREEDEF Errno btree_bulk_load(Btree *tree, const Btree_Key *keys, void *const *values, size_t n);
+
+/*
+    @return posizione della chiave più piccola
+*/
+BTREEDEF Btree_Iter btree_first(Btree *tree);
+/*
+    @return posizione della prima chiave >= key
+*/
+BTREEDEF Btree_Iter btree_lower_bound(Btree *tree, Btree_Key key);
+/*
+    @return false se l'iteratore è oltre l'ultima chiave
+*/
+BTREEDEF bool btree_iter_valid(Btree_Iter it);
+BTREEDEF void btree_iter_next(Btree_Iter *it);
+BTREEDEF Btree_Key btree_iter_key(Btree_Iter it);
+BTREEDEF void *btree_iter_value(Btree_Iter it);
+
+/*
+    Visita in ordine le chiavi in [low, high)
+    @param visit chiamata per ogni chiave, se ritorna false la visita si ferma
+    @return numero di chiavi visitate
+*/
+BTREEDEF size_t btree_range(Btree *tree, Btree_Key low, Btree_Key high,
+                            bool (*visit)(Btree_Key key, void *value, void *ctx), void *ctx);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+typedef Btree_Key Btree_Vec __attribute__((vector_size(BTREE_SIMD_BYTES)));
+#define BTREE_LANES (BTREE_SIMD_BYTES/sizeof(Btree_Key))
+
+// numero di chiavi del nodo < key (o <= key con or_equal), confronti su tutto l'array
+BTREEDEF uint32_t btree_rank(const Btree_Node *node, Btree_Key key, bool or_equal) {
+#if !BTREE_SIMD_SEARCH
+    // conteggio senza salti: i confronti sono indipendenti e il riempimento non conta mai
+    uint32_t rank = 0;
+    if(or_equal) for(uint32_t i = 0; i < BTREE_NODE_KEYS; i++) rank += node->keys[i] <= key;
+    else for(uint32_t i = 0; i < BTREE_NODE_KEYS; i++) rank += node->keys[i] < key;
+    return rank > node->count ? node->count : rank;
+#else
+    Btree_Vec acc = {0};
+    if(or_equal) {
+        for(size_t i = 0; i < BTREE_NODE_KEYS; i += BTREE_LANES) {
+            Btree_Vec v;
+            memcpy(&v, node->keys + i, sizeof(v));
+            acc += v <= key; // -1 dove vero
+        }
+    } else {
+        for(size_t i = 0; i < BTREE_NODE_KEYS; i += BTREE_LANES) {
+            Btree_Vec v;
+            memcpy(&v, node->keys + i, sizeof(v));
+            acc += v < key;
+        }
+    }
+    Btree_Key sum = 0;
+    for(size_t l = 0; l < BTREE_LANES; l++) sum -= acc[l];
+    // con key == INT64_MAX anche il riempimento risulterebbe <=
+    return sum > node->count ? node->count : (uint32_t)sum;
+#endif // BTREE_SIMD_SEARCH
+}
+
+// riempie le posizioni libere da from in poi
+BTREEDEF void btree_pad(Btree_Node *node, uint32_t from) {
+    for(uint32_t i = from; i < BTREE_NODE_KEYS; i++) node->keys[i] = INT64_MAX;
+}
+
+BTREEDEF void *btree_alloc_aligned(Btree *tree, size_t size) {
+    uintptr_t p = (uintptr_t)arena_alloc(&tree->arena, size + 63);
+    return (void*)((p + 63) & ~(uintptr_t)63);
+}
+
+BTREEDEF Btree_Leaf *btree_new_leaf(Btree *tree) {
+    Btree_Leaf *leaf = tree->free_leaves;
+    if(leaf != NULL) tree->free_leaves = leaf->next;
+    else leaf = (Btree_Leaf*)btree_alloc_aligned(tree, sizeof(Btree_Leaf));
+    leaf->base.count = 0;
+    leaf->base.leaf = 1;
+    leaf->next = NULL;
+    btree_pad(&leaf->base, 0);
+    return leaf;
+}
+
+BTREEDEF Btree_Inner *btree_new_inner(Btree *tree) {
+    Btree_Inner *inner = tree->free_inners;
+    if(inner != NULL) tree->free_inners = (Btree_Inner*)inner->children[0];
+    else inner = (Btree_Inner*)btree_alloc_aligned(tree, sizeof(Btree_Inner));
+    inner->base.count = 0;
+    inner->base.leaf = 0;
+    btree_pad(&inner->base, 0);
+    return inner;
+}
+
+BTREEDEF void btree_free_node(Btree *tree, Btree_Node *node) {
+    if(node->leaf) {
+        Btree_Leaf *leaf = (Btree_Leaf*)node;
+        leaf->next = tree->free_leaves;
+        tree->free_leaves = leaf;
+    } else {
+        Btree_Inner *inner = (Btree_Inner*)node;
+        inner->children[0] = (Btree_Node*)tree->free_inners;
+        tree->free_inners = inner;
+    }
+}
+
+Btree btree_init(void) {
+    Btree tree = {0};
+    tree.root = &btree_new_leaf(&tree)->base;
+    tree.height = 1;
+    return tree;
+}
+
+void btree_deinit(Btree *tree) {
+    arena_free(&tree->arena);
+    memset(tree, 0, sizeof(*tree));
+}
+
+BTREEDEF Btree_Leaf *btree_find_leaf(Btree *tree, Btree_Key key) {
+    Btree_Node *node = tree->root;
+    while(!node->leaf) {
+        node = ((Btree_Inner*)node)->children[btree_rank(node, key, true)];
+    }
+    return (Btree_Leaf*)node;
+}
+
+bool btree_get(Btree *tree, Btree_Key key, void **value) {
+    Btree_Leaf *leaf = btree_find_leaf(tree, key);
+    uint32_t i = btree_rank(&leaf->base, key, false);
+    if(i == leaf->base.count || leaf->base.keys[i] != key) return false;
+    if(value != NULL) *value = leaf->values[i];
+    return true;
+}
+
+/*
+    Divide il figlio pieno i di parent (che ha spazio) in due metà
+*/
+BTREEDEF void btree_split_child(Btree *tree, Btree_Inner *parent, uint32_t i) {
+    Btree_Node *child = parent->children[i];
+    uint32_t half = BTREE_NODE_KEYS/2;
+    Btree_Key separator;
+    Btree_Node *right;
+
+    if(child->leaf) {
+        Btree_Leaf *left_leaf = (Btree_Leaf*)child;
+        Btree_Leaf *right_leaf = btree_new_leaf(tree);
+        right_leaf->base.count = BTREE_NODE_KEYS - half;
+        memcpy(right_leaf->base.keys, child->keys + half, right_leaf->base.count*sizeof(Btree_Key));
+        memcpy(right_leaf->values, left_leaf->values + half, right_leaf->base.count*sizeof(void*));
+        right_leaf->next = left_leaf->next;
+        left_leaf->next = right_leaf;
+        // nelle foglie la chiave separatrice resta anche a destra
+        separator = right_leaf->base.keys[0];
+        right = &right_leaf->base;
+    } else {
+        Btree_Inner *left_inner = (Btree_Inner*)child;
+        Btree_Inner *right_inner = btree_new_inner(tree);
+        right_inner->base.count = BTREE_NODE_KEYS - half - 1;
+        memcpy(right_inner->base.keys, child->keys + half + 1, right_inner->base.count*sizeof(Btree_Key));
+        memcpy(right_inner->children, left_inner->children + half + 1,
+               (right_inner->base.count + 1)*sizeof(Btree_Node*));
+        // nei nodi interni la chiave separatrice sale nel padre
+        separator = child->keys[half];
+        right = &right_inner->base;
+    }
+    child->count = half;
+    btree_pad(child, half);
+
+    Btree_Node *p = &parent->base;
+    memmove(p->keys + i + 1, p->keys + i, (p->count - i)*sizeof(Btree_Key));
+    memmove(parent->children + i + 2, parent->children + i + 1, (p->count - i)*sizeof(Btree_Node*));
+    p->keys[i] = separator;
+    parent->children[i + 1] = right;
+    p->count++;
+}
+
+bool btree_insert(Btree *tree, Btree_Key key, void *value) {
+    if(tree->root->count == BTREE_NODE_KEYS) {
+        Btree_Inner *root = btree_new_inner(tree);
+        root->children[0] = tree->root;
+        btree_split_child(tree, root, 0);
+        tree->root = &root->base;
+        tree->height++;
+    }
+
+    // i nodi pieni vengono divisi scendendo, così il padre ha sempre spazio
+    Btree_Node *node = tree->root;
+    while(!node->leaf) {
+        Btree_Inner *inner = (Btree_Inner*)node;
+        uint32_t i = btree_rank(node, key, true);
+        if(inner->children[i]->count == BTREE_NODE_KEYS) {
+            btree_split_child(tree, inner, i);
+            if(key >= node->keys[i]) i++;
+        }
+        node = inner->children[i];
+    }
+
+    Btree_Leaf *leaf = (Btree_Leaf*)node;
+    uint32_t i = btree_rank(node, key, false);
+    if(i < node->count && node->keys[i] == key) {
+        leaf->values[i] = value;
+        return false;
+    }
+    memmove(node->keys + i + 1, node->keys + i, (node->count - i)*sizeof(Btree_Key));
+    memmove(leaf->values + i + 1, leaf->values + i, (node->count - i)*sizeof(void*));
+    node->keys[i] = key;
+    leaf->values[i] = value;
+    node->count++;
+    tree->length++;
+    return true;
+}
+
+// unisce il figlio i+1 di parent nel figlio i e toglie la separatrice dal padre
+BTREEDEF void btree_merge_children(Btree *tree, Btree_Inner *parent, uint32_t i) {
+    Btree_Node *left = parent->children[i];
+    Btree_Node *right = parent->children[i + 1];
+
+    if(left->leaf) {
+        Btree_Leaf *left_leaf = (Btree_Leaf*)left;
+        Btree_Leaf *right_leaf = (Btree_Leaf*)right;
+        memcpy(left->keys + left->count, right->keys, right->count*sizeof(Btree_Key));
+        memcpy(left_leaf->values + left->count, right_leaf->values, right->count*sizeof(void*));
+        left->count += right->count;
+        left_leaf->next = right_leaf->next;
+    } else {
+        Btree_Inner *left_inner = (Btree_Inner*)left;
+        Btree_Inner *right_inner = (Btree_Inner*)right;
+        left->keys[left->count] = parent->base.keys[i];
+        memcpy(left->keys + left->count + 1, right->keys, right->count*sizeof(Btree_Key));
+        memcpy(left_inner->children + left->count + 1, right_inner->children, (right->count + 1)*sizeof(Btree_Node*));
+        left->count += right->count + 1;
+    }
+    btree_free_node(tree, right);
+
+    Btree_Node *p = &parent->base;
+    memmove(p->keys + i, p->keys + i + 1, (p->count - i - 1)*sizeof(Btree_Key));
+    memmove(parent->children + i + 1, parent->children + i + 2, (p->count - i - 1)*sizeof(Btree_Node*));
+    p->count--;
+    btree_pad(p, p->count);
+}
+
+// sposta l'ultima chiave del figlio i-1 in testa al figlio i
+BTREEDEF void btree_borrow_left(Btree_Inner *parent, uint32_t i) {
+    Btree_Node *left = parent->children[i - 1];
+    Btree_Node *child = parent->children[i];
+    memmove(child->keys + 1, child->keys, child->count*sizeof(Btree_Key));
+
+    if(child->leaf) {
+        Btree_Leaf *left_leaf = (Btree_Leaf*)left;
+        Btree_Leaf *child_leaf = (Btree_Leaf*)child;
+        memmove(child_leaf->values + 1, child_leaf->values, child->count*sizeof(void*));
+        child->keys[0] = left->keys[left->count - 1];
+        child_leaf->values[0] = left_leaf->values[left->count - 1];
+        parent->base.keys[i - 1] = child->keys[0];
+    } else {
+        Btree_Inner *left_inner = (Btree_Inner*)left;
+        Btree_Inner *child_inner = (Btree_Inner*)child;
+        memmove(child_inner->children + 1, child_inner->children, (child->count + 1)*sizeof(Btree_Node*));
+        child->keys[0] = parent->base.keys[i - 1];
+        child_inner->children[0] = left_inner->children[left->count];
+        parent->base.keys[i - 1] = left->keys[left->count - 1];
+    }
+    child->count++;
+    left->count--;
+    btree_pad(left, left->count);
+}
+
+// sposta la prima chiave del figlio i+1 in coda al figlio i
+BTREEDEF void btree_borrow_right(Btree_Inner *parent, uint32_t i) {
+    Btree_Node *child = parent->children[i];
+    Btree_Node *right = parent->children[i + 1];
+
+    if(child->leaf) {
+        Btree_Leaf *child_leaf = (Btree_Leaf*)child;
+        Btree_Leaf *right_leaf = (Btree_Leaf*)right;
+        child->keys[child->count] = right->keys[0];
+        child_leaf->values[child->count] = right_leaf->values[0];
+        memmove(right_leaf->values, right_leaf->values + 1, (right->count - 1)*sizeof(void*));
+        memmove(right->keys, right->keys + 1, (right->count - 1)*sizeof(Btree_Key));
+        parent->base.keys[i] = right->keys[0];
+    } else {
+        Btree_Inner *child_inner = (Btree_Inner*)child;
+        Btree_Inner *right_inner = (Btree_Inner*)right;
+        child->keys[child->count] = parent->base.keys[i];
+        child_inner->children[child->count + 1] = right_inner->children[0];
+        parent->base.keys[i] = right->keys[0];
+        memmove(right->keys, right->keys + 1, (right->count - 1)*sizeof(Btree_Key));
+        memmove(right_inner->children, right_inner->children + 1, right->count*sizeof(Btree_Node*));
+    }
+    child->count++;
+    right->count--;
+    btree_pad(right, right->count);
+}
+
+bool btree_delete(Btree *tree, Btree_Key key, void **value) {
+    // scendendo ogni figlio viene portato sopra il minimo, così la rimozione
+    // dalla foglia non deve mai risalire l'albero
+    Btree_Node *node = tree->root;
+    while(!node->leaf) {
+        Btree_Inner *inner = (Btree_Inner*)node;
+        uint32_t i = btree_rank(node, key, true);
+        if(inner->children[i]->count <= BTREE_MIN_KEYS) {
+            if(i > 0 && inner->children[i - 1]->count > BTREE_MIN_KEYS) {
+                btree_borrow_left(inner, i);
+            } else if(i < node->count && inner->children[i + 1]->count > BTREE_MIN_KEYS) {
+                btree_borrow_right(inner, i);
+            } else {
+                if(i == node->count) i--;
+                btree_merge_children(tree, inner, i);
+                if(node->count == 0) {
+                    // solo la radice può restare con un figlio: l'albero si abbassa
+                    tree->root = inner->children[0];
+                    tree->height--;
+                    btree_free_node(tree, node);
+                    node = tree->root;
+                    continue;
+                }
+            }
+            i = btree_rank(node, key, true);
+        }
+        node = inner->children[i];
+    }
+
+    Btree_Leaf *leaf = (Btree_Leaf*)node;
+    uint32_t i = btree_rank(node, key, false);
+    if(i == node->count || node->keys[i] != key) return false;
+    if(value != NULL) *value = leaf->values[i];
+    memmove(node->keys + i, node->keys + i + 1, (node->count - i - 1)*sizeof(Btree_Key));
+    memmove(leaf->values + i, leaf->values + i + 1, (node->count - i - 1)*sizeof(void*));
+    node->count--;
+    node->keys[node->count] = INT64_MAX;
+    tree->length--;
+    return true;
+}
+
+Errno btree_bulk_load(Btree *tree, const Btree_Key *keys, void *const *values, size_t n) {
+    if(tree->length != 0) return EINVAL;
+    for(size_t i = 1; i < n; i++) {
+        if(keys[i - 1] >= keys[i]) return EINVAL;
+    }
+    if(n == 0) return 0;
+
+    // foglie piene quanto possibile, con le chiavi divise in parti uguali
+    size_t n_nodes = (n + BTREE_NODE_KEYS - 1)/BTREE_NODE_KEYS;
+    Btree_Node **level = malloc(n_nodes*sizeof(*level));
+    Btree_Key *first = malloc(n_nodes*sizeof(*first)); // chiave minima di ogni sottoalbero
+    fatal_if(level == NULL || first == NULL, MSG_ERR_FULL_MEMORY);
+
+    Btree_Leaf *leaf = (Btree_Leaf*)tree->root; // la foglia vuota di btree_init
+    size_t pos = 0;
+    for(size_t j = 0; j < n_nodes; j++) {
+        if(j > 0) {
+            Btree_Leaf *next = btree_new_leaf(tree);
+            leaf->next = next;
+            leaf = next;
+        }
+        size_t count = n/n_nodes + (j < n % n_nodes);
+        memcpy(leaf->base.keys, keys + pos, count*sizeof(Btree_Key));
+        if(values != NULL) memcpy(leaf->values, values + pos, count*sizeof(void*));
+        else memset(leaf->values, 0, count*sizeof(void*));
+        leaf->base.count = (uint32_t)count;
+        level[j] = &leaf->base;
+        first[j] = keys[pos];
+        pos += count;
+    }
+    tree->height = 1;
+
+    // ogni livello interno raggruppa i nodi di quello sotto, riusando gli stessi array
+    while(n_nodes > 1) {
+        size_t n_children = n_nodes;
+        n_nodes = (n_children + BTREE_NODE_KEYS)/(BTREE_NODE_KEYS + 1);
+        pos = 0;
+        for(size_t j = 0; j < n_nodes; j++) {
+            size_t count = n_children/n_nodes + (j < n_children % n_nodes);
+            Btree_Inner *inner = btree_new_inner(tree);
+            for(size_t c = 0; c < count; c++) {
+                inner->children[c] = level[pos + c];
+                if(c > 0) inner->base.keys[c - 1] = first[pos + c];
+            }
+            inner->base.count = (uint32_t)count - 1;
+            level[j] = &inner->base;
+            first[j] = first[pos];
+            pos += count;
+        }
+        tree->height++;
+    }
+    tree->root = level[0];
+    tree->length = n;
+    free(level);
+    free(first);
+    return 0;
+}
+
+Btree_Iter btree_first(Btree *tree) {
+    Btree_Node *node = tree->root;
+    while(!node->leaf) node = ((Btree_Inner*)node)->children[0];
+    Btree_Iter it = { (Btree_Leaf*)node, 0 };
+    if(node->count == 0) it.leaf = NULL;
+    return it;
+}
+
+Btree_Iter btree_lower_bound(Btree *tree, Btree_Key key) {
+    Btree_Iter it;
+    it.leaf = btree_find_leaf(tree, key);
+    it.index = btree_rank(&it.leaf->base, key, false);
+    if(it.index == it.leaf->base.count) {
+        // tutte le chiavi della foglia sono minori: si parte dalla successiva
+        it.leaf = it.leaf->next;
+        it.index = 0;
+    }
+    return it;
+}
+
+bool btree_iter_valid(Btree_Iter it) {
+    return it.leaf != NULL;
+}
+
+void btree_iter_next(Btree_Iter *it) {
+    if(++it->index == it->leaf->base.count) {
+        it->leaf = it->leaf->next;
+        it->index = 0;
+    }
+}
+
+Btree_Key btree_iter_key(Btree_Iter it) {
+    return it.leaf->base.keys[it.index];
+}
+
+void *btree_iter_value(Btree_Iter it) {
+    return it.leaf->values[it.index];
+}
+
+size_t btree_range(Btree *tree, Btree_Key low, Btree_Key high,
+                   bool (*visit)(Btree_Key key, void *value, void *ctx), void *ctx) {
+    size_t visited = 0;
+    Btree_Iter it = btree_lower_bound(tree, low);
+    while(it.leaf != NULL) {
+        Btree_Leaf *leaf = it.leaf;
+        for(uint32_t i = it.index; i < leaf->base.count; i++) {
+            if(leaf->base.keys[i] >= high) return visited;
+            visited++;
+            if(!visit(leaf->base.keys[i], leaf->values[i], ctx)) return visited;
+        }
+        it.leaf = leaf->next;
+        it.index = 0;
+    }
+    return visited;
+}
+
+#endif // BTREE_H_
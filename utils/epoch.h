@@ -0,0 +1,214 @@
+#ifndef EPOCH_H_
+#define EPOCH_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+
+#include "macros.h"
+#include "logging.h"
+
+#ifndef EPOCHDEF
+#define EPOCHDEF static inline
+#endif // EPOCHDEF
+
+/*
+    Epoch-based reclamation: permette ai lettori di attraversare strutture condivise
+    senza prendere lock, rimandando la free dei nodi rimossi finché nessun lettore
+    può ancora averli in mano.
+
+    Ogni thread pubblica in un suo record (una linea di cache, nessuna scrittura condivisa)
+    l'epoca globale vista all'inizio della sezione critica. Chi rimuove un nodo lo mette
+    in limbo con l'epoca corrente; l'epoca avanza solo quando tutti i thread dentro
+    una sezione critica l'hanno vista, quindi dopo due avanzamenti nessuno può più
+    vedere il nodo e viene liberato. Le free sono fatte a blocchi di EPOCH_RETIRE_BATCH.
+
+    Esempio (lettore):
+        epoch_enter();
+        for(node_t *n = atomic_load(&head); n != NULL; n = atomic_load(&n->next)) ...
+        epoch_exit();
+
+    Esempio (scrittore, dopo aver scollegato node):
+        epoch_retire(node, free);
+
+    @note un thread fermo dentro una sezione critica blocca la reclamation di tutti
+*/
+
+// oggetti rimossi da un thread prima di provare ad avanzare l'epoca e liberarli
+#ifndef EPOCH_RETIRE_BATCH
+#define EPOCH_RETIRE_BATCH 64
+#endif // EPOCH_RETIRE_BATCH
+
+/*
+    Inizio di una sezione critica: i puntatori letti da strutture condivise restano
+    validi fino alla epoch_exit corrispondente
+    @note le sezioni si possono annidare, conta solo la più esterna
+*/
+EPOCHDEF void epoch_enter(void);
+/*
+    Fine della sezione critica aperta da epoch_enter
+*/
+EPOCHDEF void epoch_exit(void);
+/*
+    Rimanda free_fn(ptr) a quando nessun thread può più vedere ptr
+    @param ptr oggetto già scollegato dalla struttura condivisa
+    @param free_fn funzione che lo dealloca (es. free)
+    @note si può chiamare dentro o fuori da una sezione critica
+*/
+EPOCHDEF void epoch_retire(void *ptr, void (*free_fn)(void*));
+/*
+    Prova ad avanzare l'epoca e libera gli oggetti del thread chiamante già liberabili,
+    senza aspettare il prossimo blocco di EPOCH_RETIRE_BATCH
+    @return oggetti del thread chiamante ancora in limbo
+*/
+EPOCHDEF size_t epoch_reclaim(void);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+#define EPOCH_QUIESCENT UINT64_MAX
+
+typedef struct {
+    void *ptr;
+    void (*free_fn)(void*);
+    uint64_t epoch;              // epoca globale al momento della rimozione
+} Epoch_Retired;
+
+typedef struct {
+    Epoch_Retired *data;         // in ordine di epoca crescente
+    size_t length;
+    size_t capacity;
+} Epoch_Limbo;
+
+typedef struct Epoch_Thread {
+    _Alignas(64) _Atomic uint64_t epoch; // EPOCH_QUIESCENT fuori dalle sezioni critiche
+    uint32_t depth;              // sezioni critiche annidate
+    struct Epoch_Thread *prev;
+    struct Epoch_Thread *next;
+    Epoch_Limbo limbo;
+    size_t retired;              // rimossi dall'ultimo tentativo di liberarli
+} Epoch_Thread;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_once_t once;
+    pthread_key_t key;
+    _Alignas(64) _Atomic uint64_t epoch;
+    Epoch_Thread *threads;
+    Epoch_Limbo orphans;         // limbo dei thread terminati
+} Epoch_State;
+
+SHARED_GLOBAL Epoch_State epoch_state = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+};
+
+SHARED_GLOBAL _Thread_local Epoch_Thread *epoch_thread;
+
+/*
+    Libera gli oggetti rimossi almeno due epoche fa: chi poteva vederli era dentro
+    una sezione critica iniziata prima che l'epoca avanzasse due volte, e l'ha già finita
+*/
+static inline void epoch_limbo_reclaim(Epoch_Limbo *limbo, uint64_t epoch) {
+    size_t kept = 0;
+    for(size_t i = 0; i < limbo->length; i++) {
+        Epoch_Retired r = limbo->data[i];
+        if(r.epoch + 2 <= epoch) r.free_fn(r.ptr);
+        else limbo->data[kept++] = r;
+    }
+    limbo->length = kept;
+}
+
+static inline void epoch_thread_exit(void *arg) {
+    Epoch_Thread *thread = (Epoch_Thread*)arg;
+    pthread_mutex_lock(&epoch_state.mutex);
+    if(thread->prev) thread->prev->next = thread->next;
+    else epoch_state.threads = thread->next;
+    if(thread->next) thread->next->prev = thread->prev;
+    // gli orfani vengono liberati dal prossimo thread che riesce ad avanzare l'epoca
+    for(size_t i = 0; i < thread->limbo.length; i++) append(&epoch_state.orphans, thread->limbo.data[i]);
+    pthread_mutex_unlock(&epoch_state.mutex);
+    free(thread->limbo.data);
+    free(thread);
+}
+
+static inline void epoch_create_key(void) {
+    int err = pthread_key_create(&epoch_state.key, epoch_thread_exit);
+    fatal_if(err != 0, "epoch: could not create the thread key: %s", strerror(err));
+}
+
+static inline Epoch_Thread *epoch_thread_get(void) {
+    Epoch_Thread *thread = epoch_thread;
+    if(thread != NULL) return thread;
+
+    pthread_once(&epoch_state.once, epoch_create_key);
+    thread = (Epoch_Thread*)aligned_alloc(_Alignof(Epoch_Thread), sizeof(*thread));
+    fatal_if(thread == NULL, MSG_ERR_FULL_MEMORY);
+    memset(thread, 0, sizeof(*thread));
+    atomic_init(&thread->epoch, EPOCH_QUIESCENT);
+
+    pthread_mutex_lock(&epoch_state.mutex);
+    thread->next = epoch_state.threads;
+    if(thread->next) thread->next->prev = thread;
+    epoch_state.threads = thread;
+    pthread_mutex_unlock(&epoch_state.mutex);
+
+    pthread_setspecific(epoch_state.key, thread);
+    epoch_thread = thread;
+    return thread;
+}
+
+/*
+    L'epoca avanza quando tutti i thread dentro una sezione critica hanno visto quella corrente.
+    Chi trova il mutex occupato rinuncia: ci sta già provando un altro thread.
+*/
+static inline void epoch_try_advance(void) {
+    if(pthread_mutex_trylock(&epoch_state.mutex) != 0) return;
+    uint64_t epoch = atomic_load(&epoch_state.epoch);
+    bool all_seen = true;
+    for(Epoch_Thread *it = epoch_state.threads; it != NULL && all_seen; it = it->next) {
+        uint64_t seen = atomic_load(&it->epoch);
+        all_seen = seen == EPOCH_QUIESCENT || seen == epoch;
+    }
+    if(all_seen) atomic_store(&epoch_state.epoch, ++epoch);
+    epoch_limbo_reclaim(&epoch_state.orphans, epoch);
+    pthread_mutex_unlock(&epoch_state.mutex);
+}
+
+void epoch_enter(void) {
+    Epoch_Thread *thread = epoch_thread_get();
+    if(thread->depth++ > 0) return;
+    uint64_t epoch = atomic_load_explicit(&epoch_state.epoch, memory_order_relaxed);
+    for(;;) {
+        // l'epoca pubblicata deve essere quella corrente, altrimenti potrebbe
+        // avanzare di due senza aspettare questo thread
+        atomic_store(&thread->epoch, epoch);
+        uint64_t now = atomic_load(&epoch_state.epoch);
+        if(now == epoch) break;
+        epoch = now;
+    }
+}
+
+void epoch_exit(void) {
+    Epoch_Thread *thread = epoch_thread;
+    if(--thread->depth > 0) return;
+    atomic_store_explicit(&thread->epoch, EPOCH_QUIESCENT, memory_order_release);
+}
+
+void epoch_retire(void *ptr, void (*free_fn)(void*)) {
+    Epoch_Thread *thread = epoch_thread_get();
+    Epoch_Retired retired = { ptr, free_fn, atomic_load(&epoch_state.epoch) };
+    append(&thread->limbo, retired);
+    if(++thread->retired >= EPOCH_RETIRE_BATCH) epoch_reclaim();
+}
+
+size_t epoch_reclaim(void) {
+    Epoch_Thread *thread = epoch_thread_get();
+    thread->retired = 0;
+    epoch_try_advance();
+    epoch_limbo_reclaim(&thread->limbo, atomic_load(&epoch_state.epoch));
+    return thread->limbo.length;
+}
+
+#endif // EPOCH_H_
@@ -0,0 +1,391 @@
+#ifndef FILE_BATCH_H_
+#define FILE_BATCH_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#include <linux/stat.h>
+#include <stdatomic.h>
+#endif
+
+#include "macros.h"
+#include "logging.h"
+#include "strings.h"
+#include "arena.h"
+#include "threadpool.h"
+
+#ifndef FILE_BATCHDEF
+#define FILE_BATCHDEF static inline
+#endif // FILE_BATCHDEF
+
+/*
+    Caricamento di molti file in un colpo solo, con il contenuto scritto direttamente
+    nella memoria di un'arena.
+
+    Su Linux open, statx, read e close di FILE_BATCH_QUEUE_DEPTH file alla volta vengono
+    accodate su un io_uring (syscall dirette, senza liburing): con una sola io_uring_enter
+    per giro si tengono in volo centinaia di richieste e la latenza del disco si sovrappone.
+    Se io_uring non c'è (kernel vecchio, seccomp, altri sistemi) i file vengono letti con
+    pread dai worker di threadpool_default().
+
+    Esempio:
+        File_Batch_Result *files = malloc(n*sizeof(*files));
+        size_t failed = file_batch_read(&arena, paths, n, files);
+        for(size_t i = 0; i < n; i++) if(files[i].error == 0) parse(files[i].content);
+
+    @note viene letta la dimensione riportata da statx: i file che la cambiano durante la
+          lettura, o come quelli in /proc non ne hanno una, vanno letti con sb_read_entire_file
+    @note il contenuto non è terminato da '\0'
+*/
+
+// file aperti contemporaneamente, ognuno tiene al massimo due richieste in volo
+#ifndef FILE_BATCH_QUEUE_DEPTH
+#define FILE_BATCH_QUEUE_DEPTH 128
+#endif // FILE_BATCH_QUEUE_DEPTH
+
+typedef struct {
+    String_View content; // memoria dell'arena, vuoto se c'è stato un errore
+    Errno error;         // 0 oppure l'errno di open, stat o read
+} File_Batch_Result;
+
+/*
+    Legge il contenuto di tutti i file
+
+    @param a arena in cui finisce il contenuto dei file
+    @param paths percorsi dei file
+    @param count numero di file
+    @param results riceve un risultato per ogni file, nello stesso ordine di paths
+
+    @return numero di file che non è stato possibile leggere
+*/
+FILE_BATCHDEF size_t file_batch_read(Arena *a, Cstr **paths, size_t count, File_Batch_Result *results);
+/*
+    Come file_batch_read ma sempre con pread sui worker di threadpool_default()
+*/
+FILE_BATCHDEF size_t file_batch_read_pread(Arena *a, Cstr **paths, size_t count, File_Batch_Result *results);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+typedef struct {
+    Arena *arena;
+    pthread_mutex_t mutex;   // l'arena non è thread safe
+    Cstr **paths;
+    File_Batch_Result *results;
+} File_Batch_Pread;
+
+/*
+    Ogni file viene aperto, letto e chiuso prima di passare al successivo:
+    al massimo un descrittore aperto per worker, qualunque sia RLIMIT_NOFILE
+*/
+static inline void file_batch_pread_range(void *ctx, size_t begin, size_t end) {
+    File_Batch_Pread *batch = (File_Batch_Pread*)ctx;
+    for(size_t i = begin; i < end; i++) {
+        File_Batch_Result *r = &batch->results[i];
+        struct stat st;
+        *r = (File_Batch_Result){0};
+
+        int fd = open(batch->paths[i], O_RDONLY | O_CLOEXEC);
+        if(fd < 0) {
+            r->error = errno;
+            continue;
+        }
+        if(fstat(fd, &st) < 0) {
+            r->error = errno;
+            close(fd);
+            continue;
+        }
+
+        size_t size = st.st_size;
+        pthread_mutex_lock(&batch->mutex);
+        r->content.data = (char*)arena_alloc(batch->arena, size);
+        pthread_mutex_unlock(&batch->mutex);
+
+        size_t done = 0;
+        while(r->error == 0 && done < size) {
+            ssize_t n = pread(fd, r->content.data + done, size - done, done);
+            if(n < 0 && errno != EINTR) r->error = errno;
+            else if(n == 0) break;
+            else if(n > 0) done += n;
+        }
+        if(r->error != 0) r->content = (String_View){0};
+        else r->content.length = done;
+        close(fd);
+    }
+}
+
+size_t file_batch_read_pread(Arena *a, Cstr **paths, size_t count, File_Batch_Result *results) {
+    File_Batch_Pread batch = { a, PTHREAD_MUTEX_INITIALIZER, paths, results };
+    parallel_for(0, count, 16, file_batch_pread_range, &batch);
+    pthread_mutex_destroy(&batch.mutex);
+
+    size_t failed = 0;
+    for(size_t i = 0; i < count; i++) failed += results[i].error != 0;
+    return failed;
+}
+
+#ifdef __linux__
+
+typedef struct {
+    int fd;
+    struct io_uring_sqe *sqes;
+    void *sq_ring;
+    void *cq_ring;
+    size_t sq_ring_size;
+    size_t cq_ring_size;
+    _Atomic uint32_t *sq_tail;
+    uint32_t *sq_mask;
+    uint32_t *sq_array;
+    _Atomic uint32_t *cq_head;
+    _Atomic uint32_t *cq_tail;
+    uint32_t *cq_mask;
+    struct io_uring_cqe *cqes;
+    uint32_t to_submit;
+} File_Batch_Ring;
+
+// stato di un file in volo, user_data delle richieste = indice dello slot << 8 | opcode
+typedef struct {
+    size_t file;            // SIZE_MAX se lo slot è libero
+    int fd;
+    uint32_t pending;       // richieste in volo
+    bool closing;
+    bool retry;             // openat senza descrittori liberi, il file va riprovato
+    uint64_t done;          // byte letti
+    struct statx stx;
+} File_Batch_Slot;
+
+static inline void file_batch_ring_deinit(File_Batch_Ring *ring) {
+    if(ring->sqes) munmap(ring->sqes, 2*FILE_BATCH_QUEUE_DEPTH*sizeof(struct io_uring_sqe));
+    if(ring->cq_ring && ring->cq_ring != ring->sq_ring) munmap(ring->cq_ring, ring->cq_ring_size);
+    if(ring->sq_ring) munmap(ring->sq_ring, ring->sq_ring_size);
+    if(ring->fd >= 0) close(ring->fd);
+}
+
+/*
+    Crea un ring con due richieste per file in volo
+    @return false se io_uring non è disponibile o non supporta openat/statx/read/close (kernel < 5.6)
+*/
+static inline bool file_batch_ring_init(File_Batch_Ring *ring) {
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    memset(ring, 0, sizeof(*ring));
+    ring->fd = syscall(SYS_io_uring_setup, 2*FILE_BATCH_QUEUE_DEPTH, &p);
+    if(ring->fd < 0) return false;
+    // IORING_FEAT_RW_CUR_POS è arrivata con il 5.6, insieme alle operazioni usate qui
+    if(!(p.features & IORING_FEAT_RW_CUR_POS) || p.sq_entries != 2*FILE_BATCH_QUEUE_DEPTH) {
+        file_batch_ring_deinit(ring);
+        return false;
+    }
+
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries*sizeof(uint32_t);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries*sizeof(struct io_uring_cqe);
+    bool single_mmap = p.features & IORING_FEAT_SINGLE_MMAP;
+    if(single_mmap && ring->cq_ring_size > ring->sq_ring_size) ring->sq_ring_size = ring->cq_ring_size;
+
+    void *sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+    ring->sq_ring = sq_ring == MAP_FAILED ? NULL : sq_ring;
+    void *cq_ring = single_mmap ? sq_ring
+                  : mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+    ring->cq_ring = cq_ring == MAP_FAILED ? NULL : cq_ring;
+    void *sqes = mmap(NULL, p.sq_entries*sizeof(struct io_uring_sqe), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES);
+    ring->sqes = sqes == MAP_FAILED ? NULL : (struct io_uring_sqe*)sqes;
+    if(ring->sq_ring == NULL || ring->cq_ring == NULL || ring->sqes == NULL) {
+        file_batch_ring_deinit(ring);
+        return false;
+    }
+
+    char *sq = (char*)ring->sq_ring;
+    char *cq = (char*)ring->cq_ring;
+    ring->sq_tail = (_Atomic uint32_t*)(sq + p.sq_off.tail);
+    ring->sq_mask = (uint32_t*)(sq + p.sq_off.ring_mask);
+    ring->sq_array = (uint32_t*)(sq + p.sq_off.array);
+    ring->cq_head = (_Atomic uint32_t*)(cq + p.cq_off.head);
+    ring->cq_tail = (_Atomic uint32_t*)(cq + p.cq_off.tail);
+    ring->cq_mask = (uint32_t*)(cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*)(cq + p.cq_off.cqes);
+    return true;
+}
+
+/*
+    Prende la prossima sqe libera. Ogni file ha al massimo due richieste in volo
+    e il ring ne ha due per file, quindi c'è sempre posto
+*/
+static inline struct io_uring_sqe *file_batch_sqe(File_Batch_Ring *ring, uint8_t opcode, size_t slot) {
+    uint32_t tail = atomic_load_explicit(ring->sq_tail, memory_order_relaxed);
+    uint32_t index = tail & *ring->sq_mask;
+    struct io_uring_sqe *sqe = &ring->sqes[index];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->user_data = (uint64_t)slot << 8 | opcode;
+    ring->sq_array[index] = index;
+    // il kernel legge la sqe dopo aver visto la nuova coda
+    atomic_store_explicit(ring->sq_tail, tail + 1, memory_order_release);
+    ring->to_submit++;
+    return sqe;
+}
+
+static inline void file_batch_close(File_Batch_Ring *ring, File_Batch_Slot *s, size_t slot) {
+    s->closing = true;
+    if(s->fd < 0) return;
+    struct io_uring_sqe *sqe = file_batch_sqe(ring, IORING_OP_CLOSE, slot);
+    sqe->fd = s->fd;
+    s->pending++;
+}
+
+static inline void file_batch_submit_read(File_Batch_Ring *ring, File_Batch_Slot *s, size_t slot, File_Batch_Result *r) {
+    struct io_uring_sqe *sqe = file_batch_sqe(ring, IORING_OP_READ, slot);
+    sqe->fd = s->fd;
+    sqe->addr = (uintptr_t)(r->content.data + s->done);
+    sqe->len = r->content.length - s->done;
+    sqe->off = s->done;
+    s->pending++;
+}
+
+/*
+    Gestisce il completamento di una richiesta e accoda la successiva per lo stesso file
+    @return true se il file è finito e lo slot si è liberato
+*/
+static inline bool file_batch_complete(File_Batch_Ring *ring, Arena *a, File_Batch_Slot *slots, size_t slot,
+                                       uint8_t opcode, int32_t res, File_Batch_Result *results) {
+    File_Batch_Slot *s = &slots[slot];
+    File_Batch_Result *r = &results[s->file];
+    s->pending--;
+
+    switch(opcode) {
+    case IORING_OP_OPENAT:
+        if(res == -EMFILE || res == -ENFILE) s->retry = true;
+        else if(res < 0) r->error = -res;
+        else s->fd = res;
+        break;
+    case IORING_OP_STATX:
+        if(res < 0) r->error = -res;
+        break;
+    case IORING_OP_READ:
+        if(res == -EINTR || res == -EAGAIN) {
+            file_batch_submit_read(ring, s, slot, r);
+            return false;
+        }
+        if(res < 0) r->error = -res;
+        else if(res == 0) r->content.length = s->done; // il file si è accorciato
+        else s->done += res;
+        if(r->error == 0 && s->done < r->content.length) {
+            file_batch_submit_read(ring, s, slot, r);
+            return false;
+        }
+        break;
+    case IORING_OP_CLOSE:
+        break;
+    }
+    if(s->pending > 0) return false;
+    if(s->closing) return true;
+    if(s->retry) {
+        *r = (File_Batch_Result){0};
+        file_batch_close(ring, s, slot);
+        return s->pending == 0;
+    }
+
+    // sia openat che statx sono finite: si legge oppure si chiude
+    if(r->error == 0 && opcode != IORING_OP_READ) {
+        r->content.length = s->stx.stx_size;
+        r->content.data = (char*)arena_alloc(a, r->content.length);
+        if(r->content.length > 0) {
+            file_batch_submit_read(ring, s, slot, r);
+            return false;
+        }
+    }
+    if(r->error != 0) r->content = (String_View){0};
+    file_batch_close(ring, s, slot);
+    return s->pending == 0;
+}
+
+static inline void file_batch_start(File_Batch_Ring *ring, File_Batch_Slot *s, size_t slot, size_t file, Cstr *path) {
+    memset(s, 0, sizeof(*s));
+    s->file = file;
+    s->fd = -1;
+
+    struct io_uring_sqe *sqe = file_batch_sqe(ring, IORING_OP_OPENAT, slot);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)path;
+    sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+    // statx sul percorso, così non deve aspettare la open
+    sqe = file_batch_sqe(ring, IORING_OP_STATX, slot);
+    sqe->fd = AT_FDCWD;
+    sqe->addr = (uintptr_t)path;
+    sqe->len = STATX_SIZE;
+    sqe->off = (uintptr_t)&s->stx;
+    s->pending = 2;
+}
+
+static inline size_t file_batch_read_uring(File_Batch_Ring *ring, Arena *a, Cstr **paths, size_t count, File_Batch_Result *results) {
+    File_Batch_Slot slots[FILE_BATCH_QUEUE_DEPTH];
+    // file da riaprire dopo un EMFILE: i file in volo scendono a quelli aperti in quel momento,
+    // così il batch si adatta a RLIMIT_NOFILE e ai descrittori già usati dal processo
+    size_t retry[FILE_BATCH_QUEUE_DEPTH];
+    size_t n_retry = 0, depth = FILE_BATCH_QUEUE_DEPTH, in_flight = 0;
+    size_t next = 0, finished = 0, failed = 0;
+
+    memset(results, 0, count*sizeof(*results));
+    for(size_t i = 0; i < FILE_BATCH_QUEUE_DEPTH; i++) slots[i].file = SIZE_MAX;
+
+    while(finished < count) {
+        for(size_t i = 0; i < FILE_BATCH_QUEUE_DEPTH && in_flight < depth && (n_retry > 0 || next < count); i++) {
+            if(slots[i].file != SIZE_MAX) continue;
+            size_t file = n_retry > 0 ? retry[--n_retry] : next++;
+            file_batch_start(ring, &slots[i], i, file, paths[file]);
+            in_flight++;
+        }
+
+        long n = syscall(SYS_io_uring_enter, ring->fd, ring->to_submit, 1, IORING_ENTER_GETEVENTS, NULL, 0);
+        if(n < 0 && errno == EINTR) continue;
+        fatal_if(n < 0, "file_batch: io_uring_enter failed: %s", strerror(errno));
+        ring->to_submit -= n;
+
+        uint32_t head = atomic_load_explicit(ring->cq_head, memory_order_relaxed);
+        uint32_t tail = atomic_load_explicit(ring->cq_tail, memory_order_acquire);
+        for(; head != tail; head++) {
+            struct io_uring_cqe *cqe = &ring->cqes[head & *ring->cq_mask];
+            size_t slot = cqe->user_data >> 8;
+            uint8_t opcode = cqe->user_data & 0xff;
+            if(!file_batch_complete(ring, a, slots, slot, opcode, cqe->res, results)) continue;
+            File_Batch_Slot *s = &slots[slot];
+            in_flight--;
+            if(s->retry && in_flight > 0) {
+                retry[n_retry++] = s->file;
+                depth = in_flight;
+            } else {
+                // senza altri file aperti un EMFILE non si risolve aspettando
+                if(s->retry) results[s->file].error = EMFILE;
+                failed += results[s->file].error != 0;
+                finished++;
+            }
+            s->file = SIZE_MAX;
+        }
+        atomic_store_explicit(ring->cq_head, head, memory_order_release);
+    }
+    return failed;
+}
+
+#endif // __linux__
+
+size_t file_batch_read(Arena *a, Cstr **paths, size_t count, File_Batch_Result *results) {
+    if(count == 0) return 0;
+#ifdef __linux__
+    File_Batch_Ring ring;
+    if(file_batch_ring_init(&ring)) {
+        size_t failed = file_batch_read_uring(&ring, a, paths, count, results);
+        file_batch_ring_deinit(&ring);
+        return failed;
+    }
+#endif // __linux__
+    return file_batch_read_pread(a, paths, count, results);
+}
+
+#endif // FILE_BATCH_H_
@@ -0,0 +1,110 @@
+#ifndef LINALG_H_
+#define LINALG_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include <string.h>
+#include <math.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "matrix.h"
+
+#ifndef LINALGDEF
+#define LINALGDEF static inline
+#endif // LINALGDEF
+
+/*
+    Algebra lineare densa su matrici row-major, per float e double.
+    Le fattorizzazioni sono a blocchi "right-looking": ogni pannello di LINALG_BLOCK
+    colonne viene fattorizzato e poi la parte restante della matrice viene aggiornata
+    con un prodotto tra matrici (matrix_gemm), che fa la maggior parte del lavoro.
+    L'aggiornamento può essere diviso tra più thread.
+    @note serve linkare la libreria matematica (-lm)
+*/
+#ifndef LINALG_BLOCK
+#define LINALG_BLOCK 64
+#endif // LINALG_BLOCK
+
+/*
+    Fattorizzazione LU con pivoting parziale: P*A = L*U
+    @param n ordine della matrice
+    @param a matrice n x n con righe distanti lda elementi, viene sovrascritta con L
+    (sotto la diagonale, con diagonale unitaria implicita) e U (diagonale e sopra)
+    @param ipiv vettore di n elementi: la riga i è stata scambiata con la riga ipiv[i]
+    @param n_threads numero di thread per l'aggiornamento della sottomatrice (0 o 1 = sequenziale)
+    @return 0 se è andato tutto bene, altrimenti i+1 dove i è il primo pivot nullo
+    (la fattorizzazione viene completata ma U è singolare)
+*/
+#define linalg_lu_factor(n, a, lda, ipiv, n_threads) \
+    MATRIX_GENERIC((a), linalg_lu_factor)((n), (a), (lda), (ipiv), (n_threads))
+
+/*
+    Risolve A*X = B usando la fattorizzazione calcolata da linalg_lu_factor
+    @param lu matrice fattorizzata da linalg_lu_factor
+    @param ipiv pivot restituiti da linalg_lu_factor
+    @param b matrice n x nrhs dei termini noti, viene sovrascritta con X
+*/
+#define linalg_lu_solve(n, lu, ldlu, ipiv, b, ldb, nrhs) \
+    MATRIX_GENERIC((b), linalg_lu_solve)((n), (lu), (ldlu), (ipiv), (b), (ldb), (nrhs))
+
+/*
+    Fattorizzazione di Cholesky di una matrice simmetrica definita positiva: A = L*L^T
+    @param a matrice n x n, viene letta solo la parte triangolare inferiore
+    che viene sovrascritta con L (la parte superiore non viene modificata in modo utile)
+    @param n_threads numero di thread per l'aggiornamento della sottomatrice (0 o 1 = sequenziale)
+    @return 0 se è andato tutto bene, altrimenti i+1 dove i è la prima colonna
+    in cui la matrice non risulta definita positiva
+*/
+#define linalg_cholesky_factor(n, a, lda, n_threads) \
+    MATRIX_GENERIC((a), linalg_cholesky_factor)((n), (a), (lda), (n_threads))
+
+/*
+    Risolve A*X = B usando la fattorizzazione calcolata da linalg_cholesky_factor
+    @param l matrice fattorizzata da linalg_cholesky_factor
+    @param b matrice n x nrhs dei termini noti, viene sovrascritta con X
+*/
+#define linalg_cholesky_solve(n, l, ldl, b, ldb, nrhs) \
+    MATRIX_GENERIC((b), linalg_cholesky_solve)((n), (l), (ldl), (b), (ldb), (nrhs))
+
+/*
+    Sostituzione in avanti: risolve L*X = B con L triangolare inferiore
+    @param l matrice n x n, viene letta solo la parte triangolare inferiore
+    @param unit_diag se true la diagonale di L viene considerata unitaria e non viene letta
+    @param b matrice n x nrhs dei termini noti, viene sovrascritta con X
+*/
+#define linalg_solve_lower(n, l, ldl, unit_diag, b, ldb, nrhs) \
+    MATRIX_GENERIC((b), linalg_solve_lower)((n), (l), (ldl), (unit_diag), (b), (ldb), (nrhs))
+
+/*
+    Sostituzione all'indietro: risolve U*X = B con U triangolare superiore
+    @param u matrice n x n, viene letta solo la parte triangolare superiore
+    @param unit_diag se true la diagonale di U viene considerata unitaria e non viene letta
+    @param b matrice n x nrhs dei termini noti, viene sovrascritta con X
+*/
+#define linalg_solve_upper(n, u, ldu, unit_diag, b, ldb, nrhs) \
+    MATRIX_GENERIC((b), linalg_solve_upper)((n), (u), (ldu), (unit_diag), (b), (ldb), (nrhs))
+
+/*
+    Sostituzione all'indietro con la trasposta: risolve L^T*X = B con L triangolare inferiore
+    @param l matrice n x n, viene letta solo la parte triangolare inferiore
+    @param b matrice n x nrhs dei termini noti, viene sovrascritta con X
+*/
+#define linalg_solve_lower_trans(n, l, ldl, b, ldb, nrhs) \
+    MATRIX_GENERIC((b), linalg_solve_lower_trans)((n), (l), (ldl), (b), (ldb), (nrhs))
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+#define MATRIX_T double
+#define MATRIX_SUFFIX f64
+#define MATRIX_SQRT sqrt
+#include "linalg_template.h"
+
+#define MATRIX_T float
+#define MATRIX_SUFFIX f32
+#define MATRIX_SQRT sqrtf
+#include "linalg_template.h"
+
+#endif // LINALG_H_
@@ -0,0 +1,270 @@
+/*
+    Template delle funzioni di linalg.h, istanziato una volta per ogni tipo di elemento.
+    Prima dell'include vanno definiti:
+        MATRIX_T      tipo degli elementi (float o double)
+        MATRIX_SUFFIX suffisso dei nomi generati (f32 o f64)
+        MATRIX_SQRT   radice quadrata per MATRIX_T
+    Non ha include guard perché viene incluso più volte, e non va incluso
+    direttamente: lo include linalg.h.
+*/
+#if !defined(LINALG_H_) || !defined(MATRIX_T) || !defined(MATRIX_SUFFIX) || !defined(MATRIX_SQRT)
+#error "linalg_template.h is included by linalg.h, include linalg.h instead"
+#endif
+
+#define MATRIX_FN(name) MATRIX_CONCAT(name, MATRIX_SUFFIX)
+#define LINALG_ABS(x) ((x) < 0 ? -(x) : (x))
+#define LINALG_MIN(a, b) ((a) < (b) ? (a) : (b))
+
+/*
+    Aggiornamento C -= A*B della sottomatrice restante, diviso in blocchi di LINALG_BLOCK
+    righe assegnati ai thread a turno (così anche la parte triangolare resta bilanciata)
+*/
+typedef struct {
+    size_t m;
+    size_t n;
+    size_t k;
+    const MATRIX_T *a;
+    size_t lda;
+    const MATRIX_T *b;
+    size_t ldb;
+    MATRIX_T *c;
+    size_t ldc;
+    bool lower; // aggiorna solo i blocchi che toccano la parte triangolare inferiore di C
+    size_t n_chunks;
+} MATRIX_FN(Linalg_Update);
+
+static inline void MATRIX_FN(linalg_update_chunk)(void *ctx, size_t index) {
+    MATRIX_FN(Linalg_Update) *job = (MATRIX_FN(Linalg_Update)*)ctx;
+    for(size_t r0 = index*LINALG_BLOCK; r0 < job->m; r0 += job->n_chunks*LINALG_BLOCK) {
+        size_t rows = LINALG_MIN(LINALG_BLOCK, job->m - r0);
+        size_t cols = job->lower ? LINALG_MIN(job->n, r0 + rows) : job->n;
+        MATRIX_FN(matrix_gemm)(rows, cols, job->k, -1, job->a + r0*job->lda, job->lda,
+                               job->b, job->ldb, 1, job->c + r0*job->ldc, job->ldc);
+    }
+}
+
+static inline void MATRIX_FN(linalg_update)(MATRIX_FN(Linalg_Update) *job, size_t n_threads) {
+    size_t blocks = (job->m + LINALG_BLOCK - 1)/LINALG_BLOCK;
+    job->n_chunks = n_threads == 0 ? 1 : LINALG_MIN(n_threads, blocks);
+    matrix_run_parallel(job->n_chunks, MATRIX_FN(linalg_update_chunk), job);
+}
+
+LINALGDEF int MATRIX_FN(linalg_lu_factor)(size_t n, MATRIX_T *a, size_t lda, size_t *ipiv, size_t n_threads) {
+    int info = 0;
+    for(size_t k0 = 0; k0 < n; k0 += LINALG_BLOCK) {
+        size_t k1 = LINALG_MIN(k0 + LINALG_BLOCK, n);
+
+        // fattorizzazione del pannello di colonne k0..k1 (livello 2, solo dentro il pannello)
+        for(size_t j = k0; j < k1; j++) {
+            size_t p = j;
+            MATRIX_T best = LINALG_ABS(a[j*lda + j]);
+            for(size_t i = j + 1; i < n; i++) {
+                MATRIX_T v = LINALG_ABS(a[i*lda + j]);
+                if(v > best) {
+                    best = v;
+                    p = i;
+                }
+            }
+            ipiv[j] = p;
+            if(p != j) {
+                // lo scambio viene applicato a tutta la riga, anche alla parte già fattorizzata
+                MATRIX_T *row_j = a + j*lda;
+                MATRIX_T *row_p = a + p*lda;
+                for(size_t c = 0; c < n; c++) {
+                    MATRIX_T temp = row_j[c];
+                    row_j[c] = row_p[c];
+                    row_p[c] = temp;
+                }
+            }
+            MATRIX_T pivot = a[j*lda + j];
+            if(pivot == 0) {
+                if(info == 0) info = j + 1;
+                continue;
+            }
+            MATRIX_T inv = 1/pivot;
+            for(size_t i = j + 1; i < n; i++) {
+                MATRIX_T l = a[i*lda + j] *= inv;
+                for(size_t c = j + 1; c < k1; c++) {
+                    a[i*lda + c] -= l*a[j*lda + c];
+                }
+            }
+        }
+        if(k1 == n) break;
+
+        // U12 = L11^-1 * A12
+        for(size_t i = k0 + 1; i < k1; i++) {
+            for(size_t r = k0; r < i; r++) {
+                MATRIX_FN(vector_axpy)(-a[i*lda + r], a + r*lda + k1, a + i*lda + k1, n - k1);
+            }
+        }
+
+        // A22 -= L21 * U12
+        MATRIX_FN(Linalg_Update) job = {
+            .m = n - k1, .n = n - k1, .k = k1 - k0,
+            .a = a + k1*lda + k0, .lda = lda,
+            .b = a + k0*lda + k1, .ldb = lda,
+            .c = a + k1*lda + k1, .ldc = lda,
+        };
+        MATRIX_FN(linalg_update)(&job, n_threads);
+    }
+    return info;
+}
+
+LINALGDEF void MATRIX_FN(linalg_solve_lower)(size_t n, const MATRIX_T *l, size_t ldl, bool unit_diag,
+                                             MATRIX_T *b, size_t ldb, size_t nrhs) {
+    for(size_t i0 = 0; i0 < n; i0 += LINALG_BLOCK) {
+        size_t i1 = LINALG_MIN(i0 + LINALG_BLOCK, n);
+        for(size_t i = i0; i < i1; i++) {
+            for(size_t r = i0; r < i; r++) {
+                MATRIX_FN(vector_axpy)(-l[i*ldl + r], b + r*ldb, b + i*ldb, nrhs);
+            }
+            if(!unit_diag) {
+                MATRIX_T inv = 1/l[i*ldl + i];
+                for(size_t j = 0; j < nrhs; j++) b[i*ldb + j] *= inv;
+            }
+        }
+        // le righe successive ricevono il contributo del blocco appena risolto
+        if(i1 < n) {
+            MATRIX_FN(matrix_gemm)(n - i1, nrhs, i1 - i0, -1, l + i1*ldl + i0, ldl,
+                                   b + i0*ldb, ldb, 1, b + i1*ldb, ldb);
+        }
+    }
+}
+
+LINALGDEF void MATRIX_FN(linalg_solve_upper)(size_t n, const MATRIX_T *u, size_t ldu, bool unit_diag,
+                                             MATRIX_T *b, size_t ldb, size_t nrhs) {
+    size_t blocks = (n + LINALG_BLOCK - 1)/LINALG_BLOCK;
+    for(size_t blk = blocks; blk-- > 0;) {
+        size_t i0 = blk*LINALG_BLOCK;
+        size_t i1 = LINALG_MIN(i0 + LINALG_BLOCK, n);
+        for(size_t i = i1; i-- > i0;) {
+            for(size_t r = i + 1; r < i1; r++) {
+                MATRIX_FN(vector_axpy)(-u[i*ldu + r], b + r*ldb, b + i*ldb, nrhs);
+            }
+            if(!unit_diag) {
+                MATRIX_T inv = 1/u[i*ldu + i];
+                for(size_t j = 0; j < nrhs; j++) b[i*ldb + j] *= inv;
+            }
+        }
+        if(i0 > 0) {
+            MATRIX_FN(matrix_gemm)(i0, nrhs, i1 - i0, -1, u + i0, ldu,
+                                   b + i0*ldb, ldb, 1, b, ldb);
+        }
+    }
+}
+
+LINALGDEF void MATRIX_FN(linalg_solve_lower_trans)(size_t n, const MATRIX_T *l, size_t ldl,
+                                                   MATRIX_T *b, size_t ldb, size_t nrhs) {
+    // blocco di L^T sopra il blocco diagonale, trasposto per poterlo passare alla gemm
+    MATRIX_T *w = (MATRIX_T*)malloc((n > 0 ? n : 1)*LINALG_BLOCK*sizeof(*w));
+    fatal_if(w == NULL, MSG_ERR_FULL_MEMORY);
+
+    size_t blocks = (n + LINALG_BLOCK - 1)/LINALG_BLOCK;
+    for(size_t blk = blocks; blk-- > 0;) {
+        size_t i0 = blk*LINALG_BLOCK;
+        size_t i1 = LINALG_MIN(i0 + LINALG_BLOCK, n);
+        size_t ib = i1 - i0;
+        for(size_t i = i1; i-- > i0;) {
+            for(size_t r = i + 1; r < i1; r++) {
+                MATRIX_FN(vector_axpy)(-l[r*ldl + i], b + r*ldb, b + i*ldb, nrhs);
+            }
+            MATRIX_T inv = 1/l[i*ldl + i];
+            for(size_t j = 0; j < nrhs; j++) b[i*ldb + j] *= inv;
+        }
+        if(i0 > 0) {
+            for(size_t c = 0; c < i0; c++) {
+                for(size_t r = 0; r < ib; r++) w[c*ib + r] = l[(i0 + r)*ldl + c];
+            }
+            MATRIX_FN(matrix_gemm)(i0, nrhs, ib, -1, w, ib, b + i0*ldb, ldb, 1, b, ldb);
+        }
+    }
+    free(w);
+}
+
+LINALGDEF void MATRIX_FN(linalg_lu_solve)(size_t n, const MATRIX_T *lu, size_t ldlu, const size_t *ipiv,
+                                          MATRIX_T *b, size_t ldb, size_t nrhs) {
+    for(size_t i = 0; i < n; i++) {
+        if(ipiv[i] == i) continue;
+        MATRIX_T *row_i = b + i*ldb;
+        MATRIX_T *row_p = b + ipiv[i]*ldb;
+        for(size_t j = 0; j < nrhs; j++) {
+            MATRIX_T temp = row_i[j];
+            row_i[j] = row_p[j];
+            row_p[j] = temp;
+        }
+    }
+    MATRIX_FN(linalg_solve_lower)(n, lu, ldlu, true, b, ldb, nrhs);
+    MATRIX_FN(linalg_solve_upper)(n, lu, ldlu, false, b, ldb, nrhs);
+}
+
+LINALGDEF int MATRIX_FN(linalg_cholesky_factor)(size_t n, MATRIX_T *a, size_t lda, size_t n_threads) {
+    int info = 0;
+    // pannello L21 trasposto, serve come B nella gemm dell'aggiornamento
+    MATRIX_T *w = (MATRIX_T*)malloc((n > 0 ? n : 1)*LINALG_BLOCK*sizeof(*w));
+    fatal_if(w == NULL, MSG_ERR_FULL_MEMORY);
+
+    for(size_t k0 = 0; k0 < n; k0 += LINALG_BLOCK) {
+        size_t k1 = LINALG_MIN(k0 + LINALG_BLOCK, n);
+        size_t kb = k1 - k0;
+
+        // blocco diagonale: L11 = chol(A11)
+        for(size_t j = k0; j < k1; j++) {
+            MATRIX_T d = a[j*lda + j];
+            for(size_t r = k0; r < j; r++) d -= a[j*lda + r]*a[j*lda + r];
+            if(!(d > 0)) {
+                info = j + 1;
+                goto defer;
+            }
+            d = MATRIX_SQRT(d);
+            a[j*lda + j] = d;
+            MATRIX_T inv = 1/d;
+            for(size_t i = j + 1; i < k1; i++) {
+                MATRIX_T s = a[i*lda + j];
+                for(size_t r = k0; r < j; r++) s -= a[i*lda + r]*a[j*lda + r];
+                a[i*lda + j] = s*inv;
+            }
+        }
+        if(k1 == n) break;
+
+        // L21 = A21 * L11^-T, una riga alla volta
+        for(size_t i = k1; i < n; i++) {
+            MATRIX_T *row = a + i*lda;
+            for(size_t j = k0; j < k1; j++) {
+                MATRIX_T s = row[j];
+                for(size_t r = k0; r < j; r++) s -= row[r]*a[j*lda + r];
+                row[j] = s/a[j*lda + j];
+            }
+        }
+
+        // A22 -= L21 * L21^T, solo la parte triangolare inferiore
+        size_t m = n - k1;
+        for(size_t c = 0; c < kb; c++) {
+            for(size_t i = 0; i < m; i++) w[c*m + i] = a[(k1 + i)*lda + k0 + c];
+        }
+        MATRIX_FN(Linalg_Update) job = {
+            .m = m, .n = m, .k = kb,
+            .a = a + k1*lda + k0, .lda = lda,
+            .b = w, .ldb = m,
+            .c = a + k1*lda + k1, .ldc = lda,
+            .lower = true,
+        };
+        MATRIX_FN(linalg_update)(&job, n_threads);
+    }
+
+defer:
+    free(w);
+    return info;
+}
+
+LINALGDEF void MATRIX_FN(linalg_cholesky_solve)(size_t n, const MATRIX_T *l, size_t ldl,
+                                                MATRIX_T *b, size_t ldb, size_t nrhs) {
+    MATRIX_FN(linalg_solve_lower)(n, l, ldl, false, b, ldb, nrhs);
+    MATRIX_FN(linalg_solve_lower_trans)(n, l, ldl, b, ldb, nrhs);
+}
+
+#undef LINALG_MIN
+#undef LINALG_ABS
+#undef MATRIX_FN
+#undef MATRIX_SQRT
+#undef MATRIX_SUFFIX
+#undef MATRIX_T
@@ -4,7 +4,9 @@
 #include <stdlib.h>
 //TODO: gestire il fatto che potrei includere la lista senza avere pthread
 #include <pthread.h>
+#include <stdatomic.h>
 #include "macros.h"
+#include "epoch.h"
 
 #ifndef LISTDEF
 #define LISTDEF static inline
@@ -12,19 +14,24 @@
 
 /*
     Lista ordinata di elementi
+
+    Le letture non prendono lock: attraversano la lista dentro una sezione critica di
+    epoch.h, mentre gli scrittori (serializzati da un mutex) pubblicano i nuovi nodi
+    con store atomici e mandano in limbo quelli rimossi, liberati quando nessun
+    lettore può più vederli.
 */
 typedef struct list_node_s list_node_t;
 
 struct list_node_s
 {
     void *data_p;
-    list_node_t *next; // può essere null
+    _Atomic(list_node_t*) next; // può essere null
 };
 
 typedef struct {
-    list_node_t *head;
+    _Atomic(list_node_t*) head;
     size_t length;
-    pthread_rwlock_t rwlock;
+    pthread_mutex_t mutex; // solo per gli scrittori
     int(*compare)(void*,void*);
 } list_head_t;
 
@@ -38,11 +45,12 @@ typedef struct {
 LISTDEF list_head_t list_init(int(*compare)(void*,void*));
 /*
     Deinizializza tutta la memoria allocata dalla lista, anche gli elementi stessi della lista
+    @note nessun altro thread deve usare la lista durante la chiamata
 */
 LISTDEF void list_deinit(list_head_t _this);
 /*
     Controlla se un elemento si trova nella lista
-    @note O(n) 
+    @note O(n), senza lock
 */
 LISTDEF bool list_is_member(list_head_t *_this, void *value);
 /*
@@ -86,84 +94,206 @@ LISTDEF int list_double_compare(void *_this, void *_that) {
 
 #define LIST_CMP_DOUBLE list_double_compare
 
-// TODO: aggiungere per più tipi
+// per altri tipi, senza void* e chiamate indirette, vedi DEFINE_LIST
+
+/* ---------------------- TYPED LISTS ---------------------- */
+
+/*
+    Compara due valori scalari (interi, reali, puntatori) senza overflow,
+    da usare come cmp di DEFINE_LIST
+*/
+#define LIST_CMP_SCALAR(a, b) (((a) > (b)) - ((a) < (b)))
+
+/*
+    Genera una lista ordinata specializzata per il tipo T: i valori sono salvati nel nodo
+    (una sola malloc per elemento) e il comparatore viene espanso dentro i cicli, senza
+    chiamate indirette né void*.
+
+    Esempio:
+        DEFINE_LIST(int_list, int, LIST_CMP_SCALAR)
+        int_list_t l = int_list_init();
+        int_list_insert(&l, 42);
+        int_list_deinit(&l);
+
+    @param name prefisso dei tipi (name_t, name_node_t) e delle funzioni generate
+    @param T tipo degli elementi, copiato per valore
+    @param cmp funzione o macro cmp(T a, T b) che ritorna <0, 0 o >0 come list_init
+    @note genera name_init, name_deinit, name_is_member, name_insert e name_delete,
+    con la stessa semantica di list_head_t: letture senza lock, scrittori serializzati
+*/
+#define DEFINE_LIST(name, T, cmp)                                                           \
+    typedef struct name##_node_s name##_node_t;                                             \
+                                                                                            \
+    struct name##_node_s {                                                                  \
+        T value;                                                                            \
+        _Atomic(name##_node_t*) next;                                                       \
+    };                                                                                      \
+                                                                                            \
+    typedef struct {                                                                        \
+        _Atomic(name##_node_t*) head;                                                       \
+        size_t length;                                                                      \
+        pthread_mutex_t mutex;                                                              \
+    } name##_t;                                                                             \
+                                                                                            \
+    LISTDEF name##_t name##_init(void) {                                                    \
+        name##_t _this = {0};                                                               \
+        pthread_mutex_init(&_this.mutex, NULL);                                             \
+        return _this;                                                                       \
+    }                                                                                       \
+                                                                                            \
+    LISTDEF void name##_deinit(name##_t *_this) {                                           \
+        pthread_mutex_destroy(&_this->mutex);                                               \
+        name##_node_t *curr_p = atomic_load(&_this->head);                                  \
+        while(curr_p != NULL) {                                                             \
+            name##_node_t *temp = atomic_load(&curr_p->next);                               \
+            free(curr_p);                                                                   \
+            curr_p = temp;                                                                  \
+        }                                                                                   \
+        atomic_store(&_this->head, NULL);                                                   \
+        _this->length = 0;                                                                  \
+    }                                                                                       \
+                                                                                            \
+    /*                                                                                      \
+        primo link il cui nodo è >= value: *node_p riceve il nodo letto dal link e          \
+        *last_compare il confronto con quel nodo                                            \
+    */                                                                                      \
+    LISTDEF _Atomic(name##_node_t*) *name##_find(name##_t *_this, T value,                  \
+                                                 name##_node_t **node_p, int *last_compare) { \
+        _Atomic(name##_node_t*) *link = &_this->head;                                       \
+        name##_node_t *node = atomic_load_explicit(link, memory_order_acquire);            \
+        *last_compare = 1;                                                                  \
+        while(node != NULL && (*last_compare = cmp(node->value, value)) < 0) {              \
+            link = &node->next;                                                             \
+            node = atomic_load_explicit(link, memory_order_acquire);                       \
+        }                                                                                   \
+        *node_p = node;                                                                     \
+        return link;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    LISTDEF bool name##_is_member(name##_t *_this, T value) {                               \
+        int last_compare;                                                                   \
+        name##_node_t *node;                                                                \
+        epoch_enter();                                                                      \
+        name##_find(_this, value, &node, &last_compare);                                    \
+        bool result = node != NULL && last_compare == 0;                                    \
+        epoch_exit();                                                                       \
+        return result;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    LISTDEF bool name##_insert(name##_t *_this, T value) {                                  \
+        int last_compare;                                                                   \
+        name##_node_t *node;                                                                \
+        bool result = false;                                                                \
+        pthread_mutex_lock(&_this->mutex);                                                  \
+        _Atomic(name##_node_t*) *link = name##_find(_this, value, &node, &last_compare);    \
+        if(node == NULL || last_compare > 0) {                                              \
+            name##_node_t *temp_p = (name##_node_t*)malloc(sizeof(name##_node_t));          \
+            fatal_if(temp_p == NULL, MSG_ERR_FULL_MEMORY);                                  \
+            temp_p->value = value;                                                          \
+            atomic_init(&temp_p->next, node);                                               \
+            atomic_store_explicit(link, temp_p, memory_order_release);                      \
+            _this->length++;                                                                \
+            result = true;                                                                  \
+        }                                                                                   \
+        pthread_mutex_unlock(&_this->mutex);                                                \
+        return result;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    LISTDEF bool name##_delete(name##_t *_this, T value) {                                  \
+        int last_compare;                                                                   \
+        name##_node_t *node;                                                                \
+        bool result = false;                                                                \
+        pthread_mutex_lock(&_this->mutex);                                                  \
+        _Atomic(name##_node_t*) *link = name##_find(_this, value, &node, &last_compare);    \
+        if(node != NULL && last_compare == 0) {                                             \
+            /* node->next resta valido per i lettori che sono ancora sul nodo */            \
+            atomic_store_explicit(link, atomic_load(&node->next), memory_order_release);    \
+            epoch_retire(node, free);                                                       \
+            _this->length--;                                                                \
+            result = true;                                                                  \
+        }                                                                                   \
+        pthread_mutex_unlock(&_this->mutex);                                                \
+        return result;                                                                      \
+    }
 
 /* ---------------------- IMPLEMENTATION ---------------------- */
 
+static inline void list_free_node(void *node_p) {
+    free(((list_node_t*)node_p)->data_p);
+    free(node_p);
+}
+
 list_head_t list_init(int(*compare)(void*,void*)) {
     list_head_t _this = {0};
     _this.compare = compare;
-    pthread_rwlock_init(&_this.rwlock, NULL);
+    pthread_mutex_init(&_this.mutex, NULL);
     return _this;
 }
 
 void list_deinit(list_head_t _this) {
-    pthread_rwlock_destroy(&_this.rwlock);
-
-    list_node_t *curr_p = _this.head;
-    if(curr_p == NULL) return;
+    pthread_mutex_destroy(&_this.mutex);
 
-    while(curr_p->next != NULL) {
-        list_node_t *temp = curr_p->next;
-        free(curr_p->data_p);
-        free(curr_p);
+    list_node_t *curr_p = atomic_load(&_this.head);
+    while(curr_p != NULL) {
+        list_node_t *temp = atomic_load(&curr_p->next);
+        list_free_node(curr_p);
         curr_p = temp;
     }
 }
 
 bool list_is_member(list_head_t *_this, void *value) {
     bool result;
-    pthread_rwlock_rdlock(&_this->rwlock);
+    epoch_enter();
 
-    list_node_t *curr_node = _this->head;
-    if(curr_node == NULL) return_defer(false);
+    list_node_t *curr_node = atomic_load_explicit(&_this->head, memory_order_acquire);
+    int last_compare = 0;
 
-    while(curr_node->next != NULL && _this->compare(curr_node->data_p, value) < 0) {
-       curr_node = curr_node->next; 
-    }
-    if(curr_node->next == NULL || _this->compare(curr_node->data_p, value) > 0) {
-        return_defer(false);
+    while(curr_node != NULL && (last_compare = _this->compare(curr_node->data_p, value)) < 0) {
+       curr_node = atomic_load_explicit(&curr_node->next, memory_order_acquire);
     }
-    result = true;
-defer:
-    pthread_rwlock_unlock(&_this->rwlock);
+    result = curr_node != NULL && last_compare == 0;
+
+    epoch_exit();
     return result;
 }
 
 bool list_insert(list_head_t *_this, void *value) {
     bool result;
-    pthread_rwlock_wrlock(&_this->rwlock);
-    list_node_t *curr_p = _this->head;
+    pthread_mutex_lock(&_this->mutex);
+    // solo gli scrittori modificano i link e sono serializzati: bastano load relaxed
+    list_node_t *curr_p = atomic_load_explicit(&_this->head, memory_order_relaxed);
     list_node_t *prec_p = NULL;
     list_node_t *temp_p;
 
-    while(curr_p->next != NULL || _this->compare(curr_p->data_p, value) < 0) {
+    while(curr_p != NULL && _this->compare(curr_p->data_p, value) < 0) {
         prec_p = curr_p;
-        curr_p = curr_p->next;
+        curr_p = atomic_load_explicit(&curr_p->next, memory_order_relaxed);
     }
 
     if (curr_p == NULL || _this->compare(curr_p->data_p, value) > 0) {
         temp_p = (list_node_t*)malloc(sizeof(list_node_t));
+        fatal_if(temp_p == NULL, MSG_ERR_FULL_MEMORY);
         temp_p->data_p = value;
-        temp_p->next = curr_p;
+        atomic_init(&temp_p->next, curr_p);
         _this->length++;
+        // la store release pubblica il nodo già inizializzato ai lettori
         if(prec_p == NULL) {
             // Devo modificare la testa
-            _this->head = temp_p;
-        } else prec_p->next = temp_p;
+            atomic_store_explicit(&_this->head, temp_p, memory_order_release);
+        } else atomic_store_explicit(&prec_p->next, temp_p, memory_order_release);
         return_defer(true);
     }
     result = false;
 defer:
-    pthread_rwlock_unlock(&_this->rwlock);
+    pthread_mutex_unlock(&_this->mutex);
     return result;
 }
 
 bool list_delete(list_head_t *_this, void *value_p) {
     bool result;
-    pthread_rwlock_wrlock(&_this->rwlock);
+    pthread_mutex_lock(&_this->mutex);
 
-    list_node_t *curr_p = _this->head;
+    list_node_t *curr_p = atomic_load_explicit(&_this->head, memory_order_relaxed);
     list_node_t *pred_p = NULL;
     int last_compare = 0;
 
@@ -171,27 +301,28 @@ bool list_delete(list_head_t *_this, void *value_p) {
 
     while(curr_p != NULL && (last_compare = _this->compare(curr_p->data_p, value_p)) < 0) {
         pred_p = curr_p;
-        curr_p = curr_p->next;
+        curr_p = atomic_load_explicit(&curr_p->next, memory_order_relaxed);
     }
 
     if(curr_p != NULL && last_compare == 0) {
         // Devo eliminare
         _this->length--;
+        list_node_t *next_p = atomic_load_explicit(&curr_p->next, memory_order_relaxed);
         if(pred_p == NULL) {
             // rimozione primo nodo dalla lista
-            _this->head = curr_p->next;
+            atomic_store_explicit(&_this->head, next_p, memory_order_release);
         } else {
-            pred_p->next = curr_p->next;
+            atomic_store_explicit(&pred_p->next, next_p, memory_order_release);
         }
-        free(curr_p->data_p);
-        free(curr_p);
+        // un lettore potrebbe essere ancora sul nodo: lo libera epoch.h quando è sicuro
+        epoch_retire(curr_p, list_free_node);
         return_defer(true);
     }
 
     result = false;
 
 defer:
-    pthread_rwlock_unlock(&_this->rwlock);
+    pthread_mutex_unlock(&_this->mutex);
     return result;
 }
 
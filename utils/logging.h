@@ -3,10 +3,19 @@
 
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
 
 #include "macros.h"
 
-#ifdef OMPI_MPI_H
+#if defined(OMPI_MPI_H) || defined(MPI_INCLUDED) // Open MPI o MPICH
 #define MPI_H_
 #endif
 
@@ -26,19 +35,146 @@ typedef enum {
     LOG_FATAL
 } log_t;
 
-static log_t log_level = LOG_INFO;
+/*
+    Livello minimo a tempo di compilazione (valore numerico di log_t, es. -DLOG_COMPILE_LEVEL=3
+    per LOG_WARNING): le chiamate sotto questo livello spariscono dal codice e i loro
+    argomenti non vengono valutati. I messaggi LOG_FATAL non vengono mai rimossi.
+*/
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL 1
+#endif // LOG_COMPILE_LEVEL
+
+// livello minimo a runtime, condiviso da tutte le translation unit
+SHARED_GLOBAL log_t log_level = LOG_INFO;
+
+/*
+    Prefissi delle righe di log
+*/
+typedef enum {
+    LOG_PREFIX_NONE = 0,
+    LOG_PREFIX_TIME = 1,   // secondi dal primo messaggio, da CLOCK_MONOTONIC_COARSE
+    LOG_PREFIX_THREAD = 2  // thread id del kernel
+} log_prefix_t;
+
+SHARED_GLOBAL unsigned log_prefix = LOG_PREFIX_TIME | LOG_PREFIX_THREAD;
 
 LOGGINGDEF Cstr *log_to_cstr(log_t log);
 LOGGINGDEF void set_log_level(log_t new_level);
+
+/*
+    Sceglie i prefissi delle righe
+    @param flags combinazione di log_prefix_t
+*/
+LOGGINGDEF void set_log_prefix(unsigned flags);
 LOGGINGDEF void base_log(log_t level, int err, Cstr *message, ...);
 
+/*
+    Cosa fa un produttore quando il buffer del logging asincrono è pieno
+*/
+typedef enum {
+    LOG_OVERFLOW_BLOCK = 1, // aspetta che il writer liberi spazio, nessun messaggio perso
+    LOG_OVERFLOW_DROP,      // scarta il messaggio
+    LOG_OVERFLOW_DROP_COUNT // scarta il messaggio e il writer scrive quanti ne sono stati persi
+} log_overflow_t;
+
+/*
+    Attiva il logging asincrono: base_log formatta la riga e la copia in un ring buffer
+    lock-free condiviso da tutti i thread (più produttori, un consumatore), e un thread
+    in background la scrive su stderr raggruppando più righe in una sola write.
+    @param capacity dimensione del ring buffer in byte (arrotondata a una potenza di 2)
+    @param policy comportamento quando il buffer è pieno
+    @note i messaggi LOG_FATAL non vengono mai scartati e svuotano il buffer prima di uscire
+    @note il buffer viene svuotato anche all'uscita del programma (atexit), senza liberarlo:
+          i thread ancora attivi passano al logging sincrono
+    @note le righe più lunghe di metà buffer vengono troncate
+*/
+LOGGINGDEF void log_async_init(size_t capacity, log_overflow_t policy);
+
+/*
+    Aspetta che tutte le righe inserite prima della chiamata siano state scritte
+*/
+LOGGINGDEF void log_async_flush(void);
+
+/*
+    Svuota il buffer, ferma il writer e torna al logging sincrono
+    @note gli altri thread non devono loggare durante la chiamata
+*/
+LOGGINGDEF void log_async_deinit(void);
+
+/*
+    @return numero di messaggi scartati perché il buffer era pieno
+*/
+LOGGINGDEF uint64_t log_dropped_count(void);
+
 #define log_message(level, err, message, ...)\
-    if((level) >= log_level) base_log(level, err, message, __VA_ARGS__)
+    if((level) >= LOG_COMPILE_LEVEL && (level) >= log_level) base_log(level, err, message, __VA_ARGS__)
 
+// chiamata rimossa: il compilatore controlla ancora formato e argomenti ma non li valuta
+#define log_stripped(...) do { if(0) base_log(LOG_DEBUG, 0, __VA_ARGS__, NULL); } while(0)
+
+#if LOG_COMPILE_LEVEL <= 1
 #define log_debug(...) log_message(LOG_DEBUG,0 , __VA_ARGS__, NULL)
+#else
+#define log_debug(...) log_stripped(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 2
 #define log_info(...) log_message(LOG_INFO,0 , __VA_ARGS__, NULL)
+#else
+#define log_info(...) log_stripped(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 3
 #define log_warning(...) log_message(LOG_WARNING,0 , __VA_ARGS__, NULL)
+#else
+#define log_warning(...) log_stripped(__VA_ARGS__)
+#endif
+#if LOG_COMPILE_LEVEL <= 4
 #define log_error(...) log_message(LOG_ERROR,0 , __VA_ARGS__, NULL)
+#else
+#define log_error(...) log_stripped(__VA_ARGS__)
+#endif
+
+/*
+    Logga solo la prima chiamata ogni n da questo punto del codice
+    (la 1a, la n+1-esima, ...), contando anche quelle sotto log_level.
+    Con n <= 1 (anche da configurazione) logga ogni chiamata
+*/
+#define log_every_n(level, n, ...)                                                               \
+    do {                                                                                         \
+        static _Atomic uint64_t log_every_count_ = 0;                                            \
+        uint64_t log_every_n_ = (n) > 1 ? (uint64_t)(n) : 1;                                     \
+        if((level) >= LOG_COMPILE_LEVEL &&                                                       \
+           atomic_fetch_add_explicit(&log_every_count_, 1, memory_order_relaxed) % log_every_n_ == 0 && \
+           (level) >= log_level) base_log(level, 0, __VA_ARGS__, NULL);                          \
+    } while(0)
+
+/*
+    Limite di messaggi al secondo per questo punto del codice: quelli in eccesso vengono
+    scartati senza formattarli, e all'inizio del secondo successivo viene scritto quanti
+    ne sono stati soppressi
+*/
+typedef struct {
+    _Atomic uint64_t window; // secondo del clock coarse a cui si riferisce count
+    _Atomic uint32_t count;
+    _Atomic uint64_t suppressed;
+} Log_Rate_Limit;
+
+/*
+    @return true se il messaggio può essere scritto
+    @param suppressed messaggi soppressi nel secondo precedente, da riportare (0 se nessuno)
+*/
+LOGGINGDEF bool log_rate_allow(Log_Rate_Limit *limit, uint32_t max_per_second, uint64_t *suppressed);
+
+#define log_rate_limited(level, max_per_second, ...)                                             \
+    do {                                                                                         \
+        static Log_Rate_Limit log_rate_limit_ = {0};                                             \
+        if((level) >= LOG_COMPILE_LEVEL && (level) >= log_level) {                               \
+            uint64_t log_suppressed_ = 0;                                                        \
+            bool log_allowed_ = log_rate_allow(&log_rate_limit_, (max_per_second), &log_suppressed_); \
+            if(log_suppressed_ > 0) base_log(level, 0, "%llu messages suppressed at %s:%d",      \
+                                             (unsigned long long)log_suppressed_, __FILE__, __LINE__); \
+            if(log_allowed_) base_log(level, 0, __VA_ARGS__, NULL);                              \
+        }                                                                                        \
+    } while(0)
 #define log_fatal(...) base_log(LOG_FATAL,-1, __VA_ARGS__) // return utily error
 #define log_fatal_err(err, ...) base_log(LOG_FATAL,(err), __VA_ARGS__) // return custom error
 
@@ -83,20 +219,411 @@ Cstr *log_to_cstr(log_t log) {
 
 void set_log_level(log_t new_level) { log_level = new_level; }
 
+void set_log_prefix(unsigned flags) { log_prefix = flags; }
+
+// istante del primo messaggio, origine dei timestamp
+SHARED_GLOBAL _Atomic uint64_t log_start_ns = 0;
+SHARED_GLOBAL _Thread_local long log_thread_id = 0;
+
+/*
+    CLOCK_MONOTONIC_COARSE legge il tick già calcolato dal kernel (vDSO, niente syscall):
+    risoluzione di qualche millisecondo, sufficiente per i log
+*/
+static inline uint64_t log_coarse_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline long log_get_thread_id(void) {
+    // gettid è una syscall: viene fatta una volta per thread
+    if (log_thread_id == 0) log_thread_id = (long)syscall(SYS_gettid);
+    return log_thread_id;
+}
+
+// scrive v in decimale con almeno width cifre (riempite a sinistra con pad)
+static inline char *log_put_uint(char *p, uint64_t v, int width, char pad) {
+    char digits[20];
+    int n = 0;
+    do {
+        digits[n++] = '0' + v%10;
+        v /= 10;
+    } while (v > 0);
+    for (int i = n; i < width; i++) *p++ = pad;
+    while (n > 0) *p++ = digits[--n];
+    return p;
+}
+
+// scrive i prefissi abilitati in buf, senza snprintf: è sul percorso di ogni messaggio
+static inline int log_format_prefix(char *buf, size_t size, log_t level) {
+    char prefix[64];
+    char *p = prefix;
+    unsigned flags = log_prefix;
+    if (flags & LOG_PREFIX_TIME) {
+        uint64_t now = log_coarse_ns();
+        uint64_t start = atomic_load_explicit(&log_start_ns, memory_order_relaxed);
+        if (start == 0) {
+            uint64_t expected = 0;
+            start = atomic_compare_exchange_strong(&log_start_ns, &expected, now) ? now : expected;
+        }
+        uint64_t elapsed_ms = (now - start)/1000000;
+        *p++ = '[';
+        p = log_put_uint(p, elapsed_ms/1000, 6, ' ');
+        *p++ = '.';
+        p = log_put_uint(p, elapsed_ms%1000, 3, '0');
+        *p++ = ']';
+        *p++ = ' ';
+    }
+    if (flags & LOG_PREFIX_THREAD) {
+        *p++ = '[';
+        p = log_put_uint(p, (uint64_t)log_get_thread_id(), 0, ' ');
+        *p++ = ']';
+        *p++ = ' ';
+    }
+    Cstr *log_type = log_to_cstr(level);
+    size_t type_len = strlen(log_type);
+    memcpy(p, log_type, type_len);
+    p += type_len;
+    *p++ = ':';
+    *p++ = ' ';
+    size_t n = p - prefix;
+    if (n >= size) n = size - 1;
+    memcpy(buf, prefix, n);
+    buf[n] = '\0';
+    return (int)n;
+}
+
+bool log_rate_allow(Log_Rate_Limit *limit, uint32_t max_per_second, uint64_t *suppressed) {
+    uint64_t second = log_coarse_ns()/1000000000ull;
+    uint64_t window = atomic_load_explicit(&limit->window, memory_order_relaxed);
+    *suppressed = 0;
+    // il primo thread che vede il nuovo secondo azzera il contatore e riporta i soppressi
+    if (window != second &&
+        atomic_compare_exchange_strong_explicit(&limit->window, &window, second,
+                                                memory_order_relaxed, memory_order_relaxed)) {
+        atomic_store_explicit(&limit->count, 0, memory_order_relaxed);
+        *suppressed = atomic_exchange_explicit(&limit->suppressed, 0, memory_order_relaxed);
+    }
+    if (atomic_fetch_add_explicit(&limit->count, 1, memory_order_relaxed) < max_per_second) return true;
+    atomic_fetch_add_explicit(&limit->suppressed, 1, memory_order_relaxed);
+    return false;
+}
+
+// righe più lunghe vengono formattate in un buffer sullo heap
+#ifndef LOG_LINE_MAX
+#define LOG_LINE_MAX 512
+#endif // LOG_LINE_MAX
+
+// per quanto il writer raccoglie righe prima di scriverle, finché ne continuano ad arrivare
+#ifndef LOG_ASYNC_PERIOD_NS
+#define LOG_ASYNC_PERIOD_NS 1000000
+#endif // LOG_ASYNC_PERIOD_NS
+
+/*
+    Ring buffer MPSC di byte. Ogni riga occupa un header di 8 byte (lunghezza + 1,
+    0 finché il produttore non ha finito di copiarla) seguito dal testo, allineato a 8.
+    I produttori si riservano lo spazio con una CAS su head; il writer legge da tail,
+    azzera i byte consumati e poi fa avanzare tail.
+    Quando un giro non trova niente il writer segna sleeping e dorme su wake senza timeout:
+    lo sveglia il primo produttore che pubblica una riga e vede sleeping.
+*/
+typedef struct {
+    _Alignas(64) _Atomic uint64_t head;
+    _Alignas(64) _Atomic uint64_t tail;
+    _Atomic uint64_t written; // byte consumati che sono già stati scritti su stderr
+    _Atomic uint64_t dropped;
+    _Alignas(64) char *buffer;
+    size_t capacity;
+    log_overflow_t policy;
+    _Atomic bool enabled;
+    _Atomic bool running;
+    _Atomic bool sleeping;    // il writer aspetta wake senza timeout
+    bool exit_registered;
+    uint64_t dropped_reported;
+    char *batch;
+    pthread_t writer;
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t drained;
+} Log_Async;
+
+SHARED_GLOBAL Log_Async log_async = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .wake = PTHREAD_COND_INITIALIZER,
+    .drained = PTHREAD_COND_INITIALIZER,
+};
+
+#define LOG_ASYNC_HEADER 8
+#define LOG_ASYNC_ALIGN(n) (((n) + 7) & ~(uint64_t)7)
+
+/*
+    Formatta "[prefissi] LIVELLO: messaggio\n" in buf se ci sta, altrimenti in un buffer sullo heap
+    @return la riga, da liberare se diversa da buf
+*/
+static inline char *log_format_line(char *buf, size_t size, size_t *length, log_t level, Cstr *message, va_list ap) {
+    va_list copy;
+    va_copy(copy, ap);
+    int prefix = log_format_prefix(buf, size, level);
+    int body = vsnprintf(buf + prefix, size - prefix, message, copy);
+    va_end(copy);
+    if (body < 0) body = 0;
+    size_t total = (size_t)prefix + (size_t)body + 1;
+    char *line = buf;
+    if (total > size) {
+        line = (char*)malloc(total + 1);
+        if (line == NULL) {
+            // senza memoria si tiene la riga troncata
+            line = buf;
+            total = size;
+        } else {
+            memcpy(line, buf, prefix);
+            vsnprintf(line + prefix, total - prefix, message, ap);
+        }
+    }
+    line[total - 1] = '\n';
+    *length = total;
+    return line;
+}
+
+static inline void log_write_all(int fd, const char *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n <= 0) return;
+        data += n;
+        size -= (size_t)n;
+    }
+}
+
+static inline void log_async_copy_in(Log_Async *a, uint64_t pos, const char *data, size_t size) {
+    size_t offset = pos & (a->capacity - 1);
+    size_t first = a->capacity - offset < size ? a->capacity - offset : size;
+    memcpy(a->buffer + offset, data, first);
+    memcpy(a->buffer, data + first, size - first);
+}
+
+/*
+    @return false se la riga è stata scartata
+*/
+static inline bool log_async_push(Log_Async *a, char *line, size_t length, bool must_deliver) {
+    // una riga non può occupare più di metà buffer, le più lunghe vengono troncate
+    if (length > a->capacity/2 - LOG_ASYNC_HEADER) {
+        length = a->capacity/2 - LOG_ASYNC_HEADER;
+        line[length - 1] = '\n';
+    }
+    uint64_t total = LOG_ASYNC_HEADER + LOG_ASYNC_ALIGN(length);
+    uint64_t head = atomic_load_explicit(&a->head, memory_order_relaxed);
+    for (;;) {
+        uint64_t tail = atomic_load_explicit(&a->tail, memory_order_acquire);
+        if (head + total - tail > a->capacity) {
+            if (a->policy != LOG_OVERFLOW_BLOCK && !must_deliver) {
+                atomic_fetch_add_explicit(&a->dropped, 1, memory_order_relaxed);
+                return false;
+            }
+            pthread_mutex_lock(&a->mutex);
+            pthread_cond_signal(&a->wake);
+            pthread_mutex_unlock(&a->mutex);
+            sched_yield();
+            head = atomic_load_explicit(&a->head, memory_order_relaxed);
+            continue;
+        }
+        if (atomic_compare_exchange_weak_explicit(&a->head, &head, head + total,
+                                                  memory_order_relaxed, memory_order_relaxed)) break;
+    }
+    log_async_copy_in(a, head + LOG_ASYNC_HEADER, line, length);
+    _Atomic uint32_t *header = (_Atomic uint32_t*)(a->buffer + (head & (a->capacity - 1)));
+    atomic_store_explicit(header, (uint32_t)length + 1, memory_order_release);
+    // accoppiato al fence del writer: o lui vede head avanzato o noi vediamo sleeping
+    atomic_thread_fence(memory_order_seq_cst);
+    if (atomic_load_explicit(&a->sleeping, memory_order_relaxed)) {
+        pthread_mutex_lock(&a->mutex);
+        pthread_cond_signal(&a->wake);
+        pthread_mutex_unlock(&a->mutex);
+    }
+    return true;
+}
+
+/*
+    Copia nel batch le righe complete a partire da tail e le scrive con una sola write
+    @return byte consumati
+*/
+static inline uint64_t log_async_drain(Log_Async *a) {
+    uint64_t start = atomic_load_explicit(&a->tail, memory_order_relaxed);
+    uint64_t tail = start;
+    size_t out = 0;
+    for (;;) {
+        size_t offset = tail & (a->capacity - 1);
+        uint32_t size = atomic_load_explicit((_Atomic uint32_t*)(a->buffer + offset), memory_order_acquire);
+        // riga riservata ma non ancora completa (o buffer vuoto)
+        if (size == 0) break;
+        size_t length = size - 1;
+        size_t total = LOG_ASYNC_HEADER + LOG_ASYNC_ALIGN(length);
+        size_t data = (offset + LOG_ASYNC_HEADER) & (a->capacity - 1);
+        size_t first = a->capacity - data < length ? a->capacity - data : length;
+        memcpy(a->batch + out, a->buffer + data, first);
+        memcpy(a->batch + out + first, a->buffer, length - first);
+        out += length;
+        // il prossimo header può cadere ovunque nello spazio liberato: va tutto azzerato
+        size_t clear = a->capacity - offset < total ? a->capacity - offset : total;
+        memset(a->buffer + offset, 0, clear);
+        memset(a->buffer, 0, total - clear);
+        tail += total;
+    }
+    if (tail != start) atomic_store_explicit(&a->tail, tail, memory_order_release);
+
+    if (a->policy == LOG_OVERFLOW_DROP_COUNT) {
+        uint64_t dropped = atomic_load_explicit(&a->dropped, memory_order_relaxed);
+        if (dropped != a->dropped_reported) {
+            out += snprintf(a->batch + out, 64, "WARNING: %llu log messages dropped\n",
+                            (unsigned long long)(dropped - a->dropped_reported));
+            a->dropped_reported = dropped;
+        }
+    }
+    if (out > 0) log_write_all(STDERR_FILENO, a->batch, out);
+    atomic_store_explicit(&a->written, tail, memory_order_release);
+    return tail - start;
+}
+
+static inline void *log_async_writer(void *arg) {
+    Log_Async *a = (Log_Async*)arg;
+    for (;;) {
+        uint64_t consumed = log_async_drain(a);
+        pthread_mutex_lock(&a->mutex);
+        pthread_cond_broadcast(&a->drained);
+        // a vuoto dopo un giro senza righe si dorme finché un produttore, flush o stop non svegliano
+        if (consumed == 0) atomic_store_explicit(&a->sleeping, true, memory_order_relaxed);
+        atomic_thread_fence(memory_order_seq_cst);
+        bool empty = atomic_load_explicit(&a->head, memory_order_relaxed) ==
+                     atomic_load_explicit(&a->tail, memory_order_relaxed);
+        if (empty && !atomic_load_explicit(&a->running, memory_order_acquire)) {
+            atomic_store_explicit(&a->sleeping, false, memory_order_relaxed);
+            pthread_mutex_unlock(&a->mutex);
+            return NULL;
+        }
+        if (empty && consumed == 0) {
+            pthread_cond_wait(&a->wake, &a->mutex);
+        } else if (empty) {
+            // righe appena arrivate: probabilmente ne arrivano altre, si aspetta per scriverle insieme
+            struct timespec deadline;
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_nsec += LOG_ASYNC_PERIOD_NS;
+            if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec += 1;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&a->wake, &a->mutex, &deadline);
+        }
+        atomic_store_explicit(&a->sleeping, false, memory_order_relaxed);
+        pthread_mutex_unlock(&a->mutex);
+        // riga riservata ma non ancora completa: si lascia la CPU al produttore
+        if (!empty && consumed == 0) sched_yield();
+    }
+}
+
+/*
+    Torna al logging sincrono e ferma il writer dopo che ha svuotato il buffer
+*/
+static inline void log_async_stop(Log_Async *a) {
+    atomic_store(&a->enabled, false);
+
+    pthread_mutex_lock(&a->mutex);
+    atomic_store(&a->running, false);
+    pthread_cond_signal(&a->wake);
+    pthread_mutex_unlock(&a->mutex);
+    pthread_join(a->writer, NULL);
+}
+
+/*
+    All'uscita altri thread (anche detached) possono essere ancora dentro log_async_push:
+    chi arriva dopo vede enabled a false e scrive in modo sincrono, ma il buffer
+    non viene liberato perché qualcuno potrebbe ancora copiarci dentro.
+    Le righe completate dopo l'ultimo giro del writer vengono scritte qui.
+*/
+static inline void log_async_at_exit(void) {
+    Log_Async *a = &log_async;
+    if (!atomic_load(&a->enabled)) return;
+    log_async_stop(a);
+    log_async_drain(a);
+}
+
+void log_async_init(size_t capacity, log_overflow_t policy) {
+    Log_Async *a = &log_async;
+    if (atomic_load(&a->enabled)) log_async_deinit();
+
+    size_t size = 4096;
+    while (size < capacity) size *= 2;
+    a->capacity = size;
+    a->policy = policy;
+    a->buffer = (char*)aligned_alloc(64, size);
+    // il batch contiene al più un buffer intero più l'avviso dei messaggi persi
+    a->batch = (char*)malloc(size + 64);
+    fatal_if(a->buffer == NULL || a->batch == NULL, MSG_ERR_FULL_MEMORY);
+    memset(a->buffer, 0, size);
+    atomic_store(&a->head, 0);
+    atomic_store(&a->tail, 0);
+    atomic_store(&a->written, 0);
+    atomic_store(&a->dropped, 0);
+    a->dropped_reported = 0;
+
+    atomic_store(&a->running, true);
+    atomic_store(&a->sleeping, false);
+    int err = pthread_create(&a->writer, NULL, log_async_writer, a);
+    fatal_if(err != 0, "log_async_init: could not start the writer thread: %s", strerror(err));
+    atomic_store_explicit(&a->enabled, true, memory_order_release);
+    if (!a->exit_registered) {
+        atexit(log_async_at_exit);
+        a->exit_registered = true;
+    }
+}
+
+void log_async_flush(void) {
+    Log_Async *a = &log_async;
+    if (!atomic_load_explicit(&a->enabled, memory_order_acquire)) return;
+    uint64_t target = atomic_load_explicit(&a->head, memory_order_acquire);
+    pthread_mutex_lock(&a->mutex);
+    while (atomic_load_explicit(&a->written, memory_order_acquire) < target) {
+        pthread_cond_signal(&a->wake);
+        pthread_cond_wait(&a->drained, &a->mutex);
+    }
+    pthread_mutex_unlock(&a->mutex);
+}
+
+void log_async_deinit(void) {
+    Log_Async *a = &log_async;
+    if (!atomic_load(&a->enabled)) return;
+    log_async_stop(a);
+
+    free(a->buffer);
+    free(a->batch);
+    a->buffer = NULL;
+    a->batch = NULL;
+}
+
+uint64_t log_dropped_count(void) {
+    return atomic_load_explicit(&log_async.dropped, memory_order_relaxed);
+}
+
 void base_log(log_t level, int err, Cstr *message, ...) {
 
     va_list ap;
     va_start(ap, message);
 
-    Cstr *log_type = log_to_cstr(level);
-
-    fprintf(stderr, "%s: ", log_type);
-    vfprintf(stderr, message, ap);
-    putc('\n', stderr);
+    char buf[LOG_LINE_MAX];
+    size_t length;
+    char *line = log_format_line(buf, sizeof(buf), &length, level, message, ap);
 
     va_end(ap);
 
+    bool async = atomic_load_explicit(&log_async.enabled, memory_order_acquire);
+    if (async) {
+        log_async_push(&log_async, line, length, level == LOG_FATAL);
+    } else {
+        // una sola write per riga: le righe di thread diversi non si mescolano
+        log_write_all(STDERR_FILENO, line, length);
+    }
+    if (line != buf) free(line);
+
     if(level == LOG_FATAL) {
+        if (async) log_async_flush();
     #ifdef MPI_H_
         MPI_Abort(MPI_COMM_WORLD, err);
     #else
@@ -11,12 +11,27 @@
 
 typedef const char Cstr;
 
+/*
+    Tipo reale di default delle matrici. Definire REAL_T_F32 prima degli include
+    per usare float (metà banda di memoria e il doppio delle lane SIMD)
+*/
+#ifdef REAL_T_F32
+typedef float real_t;
+#else
 typedef double real_t;
+#endif // REAL_T_F32
 
 typedef int Errno;
 
 #define MSG_ERR_FULL_MEMORY "Out of memory, buy more RAM"
 
+/*
+    Variabile globale definita in un header: ogni translation unit ne emette una
+    definizione debole e il linker ne tiene una sola, così lo stato è condiviso
+    da tutto il programma invece di avere una copia per file
+*/
+#define SHARED_GLOBAL __attribute__((weak))
+
 // Append several items to a dynamic array
 #define append_many(da, new_items, new_items_count)                                  \
     do {                                                                                    \
@@ -28,7 +43,7 @@ typedef int Errno;
                 (da)->capacity *= 2;                                                        \
             }                                                                               \
             (da)->data = realloc((da)->data, (da)->capacity*sizeof(*(da)->data));    \
-            fatal_if((da)->data != NULL, MSG_ERR_FULL_MEMORY);                          \
+            fatal_if((da)->data == NULL, MSG_ERR_FULL_MEMORY);                          \
         }                                                                                   \
         memcpy((da)->data + (da)->length, new_items, new_items_count*sizeof(*(da)->data)); \
         (da)->length += new_items_count;                                                     \
@@ -80,12 +95,17 @@ typedef int Errno;
 
 #define TODO(msg) log_fatal(msg)
 
-#include <sys/time.h> //TODO sistemare questo import
+#include <time.h>
 
+/*
+    Scrive in *(now) i secondi (double) di CLOCK_MONOTONIC: va usato per differenze di tempo.
+    Per misure ripetute vedere profile.h
+*/
 #define GET_TIME(now) \
     do {\
-    struct timeval t;\
-    *(now) = t.tv_sec + t.tv_usec/1000000.0;  \
+    struct timespec t;\
+    clock_gettime(CLOCK_MONOTONIC, &t);\
+    *(now) = t.tv_sec + t.tv_nsec/1000000000.0;  \
 } while(0)
 
 #define _aligned_alloc(size) aligned_alloc(glob_ctx.dcache_line_size, (size))
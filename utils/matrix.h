@@ -5,42 +5,154 @@
 #include <stdint.h>
 
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
 
 #include "macros.h"
 #include "random.h"
 #include "logging.h"
+#include "strings.h"
+#include "threadpool.h"
 
 #ifndef MATRIXDEF
 #define MATRIXDEF static inline
 #endif // MATRIXDEF
 
 /*
-    Genera una matrice randomica casuale
+    Matrice densa row-major con le sue dimensioni.
+    Se la matrice è stata caricata tramite mmap, mapping punta all'inizio
+    della mappatura del file e data è in sola lettura.
+*/
+typedef enum {
+    MATRIX_DTYPE_F64 = 1,
+    MATRIX_DTYPE_F32 = 2,
+} matrix_dtype_t;
+
+typedef struct {
+    union {
+        double *data;    // dtype == MATRIX_DTYPE_F64
+        float *data_f32; // dtype == MATRIX_DTYPE_F32
+    };
+    matrix_dtype_t dtype;
+    size_t rows;
+    size_t cols;
+    void *mapping; // NULL se data è stato allocato nello heap
+    size_t mapping_size;
+} Matrix;
+
+/*
+    Formato binario usato da matrix_save e matrix_load:
+    un header di MATRIX_FILE_ALIGNMENT byte seguito dal payload row-major,
+    che inizia ad un offset multiplo di MATRIX_FILE_ALIGNMENT
+*/
+#define MATRIX_FILE_MAGIC "UTILSMTX"
+#define MATRIX_FILE_VERSION 1
+#define MATRIX_FILE_ENDIAN_TAG 0x01020304u
+#define MATRIX_FILE_ALIGNMENT 64
+
+typedef struct {
+    char magic[8];
+    uint32_t endian; // MATRIX_FILE_ENDIAN_TAG scritto nell'ordine dei byte di chi ha salvato
+    uint16_t version;
+    uint16_t dtype;
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t data_offset;
+    uint8_t reserved[MATRIX_FILE_ALIGNMENT - 40];
+} Matrix_File_Header;
+
+_Static_assert(sizeof(Matrix_File_Header) == MATRIX_FILE_ALIGNMENT, "matrix file header must fill one block");
+
+/*
+    Le funzioni sulle matrici esistono per float e double: le versioni con suffisso
+    _f32 e _f64 vengono generate da matrix_template.h, mentre i nomi senza suffisso
+    scelgono la versione giusta dal tipo del puntatore passato.
+    Le funzioni che non ricevono una matrice usano real_t (vedi REAL_T_F32 in macros.h).
+*/
+#define MATRIX_CONCAT_(name, suffix) name##_##suffix
+#define MATRIX_CONCAT(name, suffix) MATRIX_CONCAT_(name, suffix)
+
+#define MATRIX_GENERIC(ptr, name) _Generic((ptr), \
+    float*: MATRIX_CONCAT(name, f32),              \
+    const float*: MATRIX_CONCAT(name, f32),        \
+    default: MATRIX_CONCAT(name, f64))
+
+#define MATRIX_REAL_GENERIC(name) _Generic((real_t)0, \
+    float: MATRIX_CONCAT(name, f32),                  \
+    default: MATRIX_CONCAT(name, f64))
+
+/*
+    Larghezza in byte dei vettori SIMD usati dai kernel: con float
+    ogni vettore contiene il doppio degli elementi rispetto a double
+*/
+#ifndef MATRIX_SIMD_BYTES
+#if defined(__AVX512F__)
+#define MATRIX_SIMD_BYTES 64
+#elif defined(__AVX__)
+#define MATRIX_SIMD_BYTES 32
+#else
+#define MATRIX_SIMD_BYTES 16
+#endif
+#endif // MATRIX_SIMD_BYTES
+
+/*
+    Genera una matrice randomica casuale di real_t
     @param rows righe della matrice da generare
     @param cols colonne della matrice da generare
     @param min_val valore minimo (incluso) dei numeri casuali nelle posizioni $c_{i,j}$ della matrice
-    @param max_val valore massimo (incluso) dei numeri casuali nelle posizioni $c_{i,j}$ della matrice
+    @param max_val valore massimo (escluso) dei numeri casuali nelle posizioni $c_{i,j}$ della matrice
     @return Ritorna puntatore all'inizio della matrice (prima riga prima colonna)
     @note il puntatore va deallocato dopo l'uso della matrice
+    @note generate_random_matrix_f32 e generate_random_matrix_f64 scelgono il tipo esplicitamente
+*/
+#define generate_random_matrix(rows, cols, min_val, max_val) \
+    MATRIX_REAL_GENERIC(generate_random_matrix)((rows), (cols), (min_val), (max_val))
+
+/*
+    Genera una matrice randomica riproducibile di real_t: l'elemento (i, j) dipende solo
+    da seed e da i*cols + j (stream Philox, vedi random.h), quindi il risultato è
+    identico bit per bit con qualsiasi numero di thread o processi
+    @param seed seed dello stream
+    @param n_threads numero di thread tra cui vengono divise le righe (0 o 1 = sequenziale)
+    @note il puntatore va deallocato dopo l'uso della matrice
 */
-MATRIXDEF double *generate_random_matrix(size_t rows, size_t cols, double min_val, double max_val);
+#define generate_random_matrix_seeded(rows, cols, min_val, max_val, seed, n_threads) \
+    MATRIX_REAL_GENERIC(generate_random_matrix_seeded)((rows), (cols), (min_val), (max_val), (seed), (n_threads))
+
+/*
+    Rigenera una porzione della matrice prodotta da generate_random_matrix_seeded,
+    senza generare il resto (es. il blocco locale di un processo MPI)
+    @param out blocco tile_rows x tile_cols con righe distanti ld elementi (float* o double*)
+    @param row0 riga globale della prima riga del blocco
+    @param col0 colonna globale della prima colonna del blocco
+    @param cols colonne della matrice intera
+*/
+#define random_matrix_tile(out, ld, row0, col0, tile_rows, tile_cols, cols, min_val, max_val, seed) \
+    MATRIX_GENERIC((out), random_matrix_tile)((out), (ld), (row0), (col0), (tile_rows), (tile_cols), \
+                                              (cols), (min_val), (max_val), (seed))
 
 /*
     Modifica la matrice in input (quadrata) e la rende trasposta
-    @param mtx puntatore alla matrice da modificare
+    @param mtx puntatore alla matrice da modificare (float* o double*)
     @param order ordine della matrice in input
     @note La matrice in input DEVE essere quadrata
 */
-MATRIXDEF void square_trasposed_matrix(double *mtx, size_t order);
+#define square_trasposed_matrix(mtx, order) \
+    MATRIX_GENERIC((mtx), square_trasposed_matrix)((mtx), (order))
 
 /*
     Stampa la matrice in output nello stream.
     @param stream luogo dove verrà scritta la matrice in output
-    @param mtx matrice da stampare
+    @param mtx matrice da stampare (float* o double*)
     @param rows numero di righe della matrice
     @param cols numero di colonne della matrice
 */
-MATRIXDEF void fprintMatrix(FILE *stream, double *mtx, size_t rows, size_t cols);
+#define fprintMatrix(stream, mtx, rows, cols) \
+    MATRIX_GENERIC((mtx), fprintMatrix)((stream), (mtx), (rows), (cols))
 
 /*
     Stampa la matrice nello standard error.
@@ -62,64 +174,573 @@ MATRIXDEF void fprintMatrix(FILE *stream, double *mtx, size_t rows, size_t cols)
 
 /*
     Calcola il prodotto scalare tra due vettori di lunghezza len
-    @param vec1 puntatore al primo vettore
-    @param vec2 puntatore al secondo vettore
+    @param vec1 puntatore al primo vettore (float* o double*)
+    @param vec2 puntatore al secondo vettore, dello stesso tipo del primo
     @param len grandezza dei due vettori
     @return Ritorna il prodotto scalare dei due vettori
 */
-double dot_product(double *vec1, double *vec2, size_t len);
+#define dot_product(vec1, vec2, len) \
+    MATRIX_GENERIC((vec1), dot_product)((vec1), (vec2), (len))
+
+/*
+    y = alpha*x + y (axpy di BLAS)
+    @param alpha scalare che moltiplica x
+    @param x vettore di lunghezza len (float* o double*)
+    @param y vettore di lunghezza len dello stesso tipo di x, viene modificato
+*/
+#define vector_axpy(alpha, x, y, len) \
+    MATRIX_GENERIC((x), vector_axpy)((alpha), (x), (y), (len))
+
+/*
+    Prodotto tra matrici row-major (gemm di BLAS): C = alpha*A*B + beta*C
+    @param m righe di A e C
+    @param n colonne di B e C
+    @param k colonne di A e righe di B
+    @param a matrice m x k con righe distanti lda elementi
+    @param b matrice k x n con righe distanti ldb elementi
+    @param c matrice m x n con righe distanti ldc elementi, viene sovrascritta (float* o double*)
+    @note lda, ldb e ldc permettono di passare sottomatrici di matrici più grandi
+*/
+#define matrix_gemm(m, n, k, alpha, a, lda, b, ldb, beta, c, ldc) \
+    MATRIX_GENERIC((c), matrix_gemm)((m), (n), (k), (alpha), (a), (lda), (b), (ldb), (beta), (c), (ldc))
+
+// blocchi della gemm: righe per micro-kernel, profondità e larghezza del blocco di B tenuto in cache
+#define MATRIX_GEMM_MR 4
+#define MATRIX_GEMM_KC 256
+#define MATRIX_GEMM_NC 256
+
+/*
+    Salva la matrice nel formato binario (header + payload allineato a 64 byte)
+    @param path file da creare o sovrascrivere
+    @param mtx matrice da salvare (float* o double*), il dtype del file segue il tipo
+    @param rows numero di righe della matrice
+    @param cols numero di colonne della matrice
+    @return 0 se è andato tutto bene, altrimenti il codice di errore (errno)
+*/
+#define matrix_save(path, mtx, rows, cols) \
+    MATRIX_GENERIC((mtx), matrix_save)((path), (mtx), (rows), (cols))
+
+/*
+    Carica una matrice salvata con matrix_save
+    @param path file da leggere
+    @param m matrice dove verrà caricato il contenuto del file
+    @param use_mmap se true il payload viene mappato in sola lettura senza copie,
+    altrimenti viene copiato in memoria allineata allocata nello heap
+    @return 0 se è andato tutto bene, EINVAL se il file non è nel formato corretto,
+    altrimenti il codice di errore (errno)
+    @note se i byte del file sono in un ordine diverso da quello della macchina
+    la matrice viene sempre copiata, anche con use_mmap
+    @note m->dtype dice se leggere m->data (double) o m->data_f32 (float)
+    @note la matrice va liberata con matrix_free
+*/
+MATRIXDEF Errno matrix_load(Cstr *path, Matrix *m, bool use_mmap);
+
+/*
+    Libera la memoria di una matrice caricata con matrix_load o matrix_read_text
+*/
+MATRIXDEF void matrix_free(Matrix *m);
+
+// caratteri che separano i valori sulla stessa riga nel formato testuale
+#define MATRIX_TEXT_DELIMS " \t\r,;"
+
+/*
+    Legge una matrice in formato testuale: una riga della matrice per ogni riga del file,
+    valori separati da spazi, tab, ',' o ';' (le righe vuote vengono ignorate).
+    Il file viene mappato in memoria (o letto tutto se non si può mappare),
+    contato in una prima passata per dimensionare la matrice e poi convertito
+    senza copie intermedie.
+    @param path file da leggere
+    @param m matrice dove verrà caricato il contenuto del file
+    @param n_threads numero di thread che leggono porzioni di righe del file in parallelo (0 o 1 = sequenziale)
+    @return 0 se è andato tutto bene, EINVAL se il testo non è una matrice valida,
+    altrimenti il codice di errore (errno)
+    @note la matrice va liberata con matrix_free
+*/
+MATRIXDEF Errno matrix_read_text(Cstr *path, Matrix *m, size_t n_threads);
+
+/*
+    Come matrix_read_text, ma legge la matrice da un buffer già in memoria
+*/
+MATRIXDEF Errno matrix_parse_text(String_View text, Matrix *m, size_t n_threads);
+
+/*
+    Scrive la matrice in formato testuale, con abbastanza cifre per poterla rileggere identica.
+    Le righe vengono formattate in memoria e scritte con una sola write per thread.
+    @param path file da creare o sovrascrivere
+    @param mtx matrice da scrivere
+    @param rows numero di righe della matrice
+    @param cols numero di colonne della matrice
+    @param delim carattere che separa i valori (es. ',' per CSV o ' ')
+    @param n_threads numero di thread che formattano porzioni di righe in parallelo (0 o 1 = sequenziale)
+    @return 0 se è andato tutto bene, altrimenti il codice di errore (errno)
+*/
+MATRIXDEF Errno matrix_write_text(Cstr *path, double *mtx, size_t rows, size_t cols, char delim, size_t n_threads);
 
 /* ---------------------- IMPLEMENTATION ---------------------- */
 
-double *generate_random_matrix(size_t rows, size_t cols, double min_val, double max_val) {
-    size_t tot_length = rows*cols;
+static inline size_t matrix_dtype_size(matrix_dtype_t dtype) {
+    switch (dtype) {
+    case MATRIX_DTYPE_F64:
+        return sizeof(double);
+    case MATRIX_DTYPE_F32:
+        return sizeof(float);
+    default:
+        return 0;
+    }
+}
+
+static inline uint64_t matrix_bswap64(uint64_t x) {
+    return __builtin_bswap64(x);
+}
+
+static inline void matrix_header_bswap(Matrix_File_Header *h) {
+    h->endian = __builtin_bswap32(h->endian);
+    h->version = __builtin_bswap16(h->version);
+    h->dtype = __builtin_bswap16(h->dtype);
+    h->rows = matrix_bswap64(h->rows);
+    h->cols = matrix_bswap64(h->cols);
+    h->data_offset = matrix_bswap64(h->data_offset);
+}
+
+/*
+    Controlla l'header e riporta i campi nell'ordine dei byte della macchina
+    @param swapped viene messo a true se i byte del payload vanno invertiti
+    @return 0 se l'header è valido, EINVAL altrimenti
+*/
+static inline Errno matrix_check_header(Matrix_File_Header *h, size_t file_size, Cstr *path, bool *swapped) {
+    if(memcmp(h->magic, MATRIX_FILE_MAGIC, sizeof(h->magic)) != 0) {
+        log_error("'%s' is not a matrix file", path);
+        return EINVAL;
+    }
+    *swapped = false;
+    if(h->endian != MATRIX_FILE_ENDIAN_TAG) {
+        matrix_header_bswap(h);
+        if(h->endian != MATRIX_FILE_ENDIAN_TAG) {
+            log_error("'%s': unknown byte order", path);
+            return EINVAL;
+        }
+        *swapped = true;
+    }
+    size_t elem_size = matrix_dtype_size(h->dtype);
+    if(h->version != MATRIX_FILE_VERSION || elem_size == 0) {
+        log_error("'%s': unsupported version %u or dtype %u", path, h->version, h->dtype);
+        return EINVAL;
+    }
+    if(h->cols != 0 && h->rows > SIZE_MAX/elem_size/h->cols) {
+        log_error("'%s': matrix %llux%llu is too big", path,
+            (unsigned long long)h->rows, (unsigned long long)h->cols);
+        return EINVAL;
+    }
+    size_t payload = h->rows*h->cols*elem_size;
+    if(h->data_offset % MATRIX_FILE_ALIGNMENT != 0 || h->data_offset < sizeof(*h) ||
+       h->data_offset > file_size || file_size - h->data_offset < payload) {
+        log_error("'%s': truncated or corrupted payload", path);
+        return EINVAL;
+    }
+    return 0;
+}
 
-    double *result = (double*)malloc(tot_length*sizeof(*result));
-    fatal_if(result == NULL ,MSG_ERR_FULL_MEMORY);
+/*
+    Salva il payload di una matrice di elementi di tipo dtype, usato da matrix_save_f32 e matrix_save_f64
+*/
+static inline Errno matrix_save_raw(Cstr *path, const void *mtx, matrix_dtype_t dtype, size_t rows, size_t cols) {
+    Errno result = 0;
+    size_t elem_size = matrix_dtype_size(dtype);
 
-    for(size_t i = 0; i < tot_length; i++) {
-        result[i] = uniform_real_distribution(min_val, max_val);
+    Matrix_File_Header h = {0};
+    memcpy(h.magic, MATRIX_FILE_MAGIC, sizeof(h.magic));
+    h.endian = MATRIX_FILE_ENDIAN_TAG;
+    h.version = MATRIX_FILE_VERSION;
+    h.dtype = dtype;
+    h.rows = rows;
+    h.cols = cols;
+    h.data_offset = sizeof(h);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    // il payload viene scritto con una sola fwrite, che per buffer grandi
+    // diventa una write diretta senza passare dal buffer di stdio
+    if(fwrite(&h, sizeof(h), 1, f) != 1 ||
+       fwrite(mtx, elem_size, rows*cols, f) != rows*cols ||
+       fflush(f) != 0) {
+        int err = errno;
+        log_error("Could not write on the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
     }
 
+defer:
+    if (f) fclose(f);
     return result;
 }
 
-//TODO: rendere possibile la trasposizione di matrici rows x cols
-void square_trasposed_matrix(double *mtx, size_t order) {
-    double temp;
-    for(size_t i = 0; i < order; i++) {
-        for(size_t j = i+1; j < order; j++) {
-            if(i < j) {
-                size_t index = i*order + j;
-                temp = mtx[index];
-                mtx[index] = mtx[j*order + i];
-                mtx[j*order + i] = temp;
+Errno matrix_load(Cstr *path, Matrix *m, bool use_mmap) {
+    Errno result = 0;
+    struct stat st;
+    Matrix_File_Header h;
+    bool swapped;
+
+    *m = (Matrix){0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    if (fstat(fd, &st) < 0) {
+        int err = errno;
+        log_error("Could not stat the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    if ((size_t)st.st_size < sizeof(h) || pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h)) {
+        log_error("'%s' is not a matrix file", path);
+        return_defer(EINVAL);
+    }
+    Errno header_err = matrix_check_header(&h, st.st_size, path, &swapped);
+    if (header_err != 0) return_defer(header_err);
+
+    m->dtype = h.dtype;
+    m->rows = h.rows;
+    m->cols = h.cols;
+    size_t elem_size = matrix_dtype_size(h.dtype);
+    size_t payload = h.rows*h.cols*elem_size;
+    if (payload == 0) return_defer(0);
+
+    if (use_mmap && !swapped) {
+        void *mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapping == MAP_FAILED) {
+            int err = errno;
+            log_error("Could not map the file '%s', errno: %s", path, strerror(err));
+            return_defer(err);
+        }
+        m->mapping = mapping;
+        m->mapping_size = st.st_size;
+        m->data = (double*)((char*)mapping + h.data_offset);
+        return_defer(0);
+    }
+
+    size_t alloc_size = (payload + MATRIX_FILE_ALIGNMENT - 1)/MATRIX_FILE_ALIGNMENT*MATRIX_FILE_ALIGNMENT;
+    m->data = (double*)aligned_alloc(MATRIX_FILE_ALIGNMENT, alloc_size);
+    fatal_if(m->data == NULL, MSG_ERR_FULL_MEMORY);
+
+    size_t done = 0;
+    while (done < payload) {
+        ssize_t n = pread(fd, (char*)m->data + done, payload - done, h.data_offset + done);
+        if (n <= 0) {
+            int err = n < 0 ? errno : EINVAL;
+            log_error("Could not read the file '%s', errno: %s", path, strerror(err));
+            free(m->data);
+            m->data = NULL;
+            return_defer(err);
+        }
+        done += n;
+    }
+    if (swapped && elem_size == sizeof(uint64_t)) {
+        uint64_t *words = (uint64_t*)m->data;
+        for(size_t i = 0; i < h.rows*h.cols; i++) words[i] = matrix_bswap64(words[i]);
+    } else if (swapped) {
+        uint32_t *words = (uint32_t*)m->data;
+        for(size_t i = 0; i < h.rows*h.cols; i++) words[i] = __builtin_bswap32(words[i]);
+    }
+
+defer:
+    if (fd >= 0) close(fd);
+    if (result != 0) *m = (Matrix){0};
+    return result;
+}
+
+void matrix_free(Matrix *m) {
+    if (m->mapping != NULL) munmap(m->mapping, m->mapping_size);
+    else free(m->data);
+    *m = (Matrix){0};
+}
+
+typedef struct {
+    void (*fn)(void *ctx, size_t index);
+    void *ctx;
+    size_t index;
+} Matrix_Task;
+
+static inline void matrix_task_entry(void *arg) {
+    Matrix_Task *task = (Matrix_Task*)arg;
+    task->fn(task->ctx, task->index);
+}
+
+/*
+    Esegue fn(ctx, i) per i da 0 a n_tasks-1 sui worker del pool condiviso di threadpool.h,
+    senza creare thread a ogni chiamata. Il task 0 viene eseguito dal thread chiamante.
+*/
+static inline void matrix_run_parallel(size_t n_tasks, void (*fn)(void *ctx, size_t index), void *ctx) {
+    if (n_tasks == 0) return;
+    if (n_tasks == 1) {
+        fn(ctx, 0);
+        return;
+    }
+    Matrix_Task *tasks = (Matrix_Task*)malloc(n_tasks*sizeof(*tasks));
+    fatal_if(tasks == NULL, MSG_ERR_FULL_MEMORY);
+
+    Task_Group group;
+    task_group_init(&group, threadpool_default());
+    for (size_t i = 1; i < n_tasks; i++) {
+        tasks[i] = (Matrix_Task){ .fn = fn, .ctx = ctx, .index = i };
+        task_group_spawn(&group, matrix_task_entry, &tasks[i]);
+    }
+    fn(ctx, 0);
+    task_group_wait(&group);
+    free(tasks);
+}
+
+typedef struct {
+    String_View text; // righe complete assegnate al chunk
+    size_t rows;
+    size_t cols;      // 0 se il chunk non contiene righe
+    size_t first_row;
+    Errno err;
+} Matrix_Text_Chunk;
+
+typedef struct {
+    Matrix_Text_Chunk *chunks;
+    Matrix *m;
+} Matrix_Text_Job;
+
+static inline bool matrix_text_is_delim(char c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == ',' || c == ';';
+}
+
+static inline size_t matrix_text_count_fields(String_View line) {
+    size_t fields = 0;
+    size_t i = 0;
+    while (i < line.length) {
+        while (i < line.length && matrix_text_is_delim(line.data[i])) i++;
+        if (i == line.length) break;
+        fields++;
+        while (i < line.length && !matrix_text_is_delim(line.data[i])) i++;
+    }
+    return fields;
+}
+
+static inline void matrix_text_count_chunk(void *ctx, size_t index) {
+    Matrix_Text_Chunk *chunk = &((Matrix_Text_Job*)ctx)->chunks[index];
+    String_View text = chunk->text;
+    while (text.length > 0) {
+        String_View line = sv_chop_by_delim(&text, '\n');
+        size_t fields = matrix_text_count_fields(line);
+        if (fields == 0) continue;
+        if (chunk->cols == 0) chunk->cols = fields;
+        else if (chunk->cols != fields) {
+            log_error("matrix text: row with %zu values, expected %zu", fields, chunk->cols);
+            chunk->err = EINVAL;
+            return;
+        }
+        chunk->rows++;
+    }
+}
+
+static inline void matrix_text_parse_chunk(void *ctx, size_t index) {
+    Matrix_Text_Job *job = (Matrix_Text_Job*)ctx;
+    Matrix_Text_Chunk *chunk = &job->chunks[index];
+    String_View text = chunk->text;
+    double *out = job->m->data + chunk->first_row*job->m->cols;
+    while (text.length > 0) {
+        String_View line = sv_chop_by_delim(&text, '\n');
+        while (line.length > 0) {
+            while (line.length > 0 && matrix_text_is_delim(*line.data)) {
+                line.data++;
+                line.length--;
+            }
+            if (line.length == 0) break;
+            String_View token_start = line;
+            if (!sv_chop_double(&line, out) || (line.length > 0 && !matrix_text_is_delim(*line.data))) {
+                String_View token = sv_chop_by_delims(&token_start, MATRIX_TEXT_DELIMS);
+                log_error("matrix text: invalid number '%.*s'", (int)token.length, token.data);
+                chunk->err = EINVAL;
+                return;
             }
+            out++;
         }
     }
 }
 
-void fprintMatrix(FILE *stream, double *mtx, size_t rows, size_t cols) {
-    for(size_t i=0; i < rows; i++) {
-        fprintf(stream ,"    ");
-        for(size_t j=0; j < cols; j++) {
-            fprintf(stream, "%lf", mtx[i*cols + j]);
-            if(j == cols - 1)
-                putc('\n', stream);
-            else fprintf(stream, " ,");
+Errno matrix_parse_text(String_View text, Matrix *m, size_t n_threads) {
+    Errno result = 0;
+    *m = (Matrix){0};
+
+    if (n_threads == 0) n_threads = 1;
+    // ogni chunk deve avere abbastanza testo da ammortizzare la creazione del thread
+    size_t max_chunks = text.length/(64*1024) + 1;
+    if (n_threads > max_chunks) n_threads = max_chunks;
+
+    Matrix_Text_Chunk *chunks = (Matrix_Text_Chunk*)calloc(n_threads, sizeof(*chunks));
+    fatal_if(chunks == NULL, MSG_ERR_FULL_MEMORY);
+    Matrix_Text_Job job = { .chunks = chunks, .m = m };
+
+    // i confini dei chunk vengono spostati all'inizio della riga successiva
+    size_t begin = 0;
+    for (size_t i = 0; i < n_threads; i++) {
+        size_t end = i + 1 == n_threads ? text.length : text.length/n_threads*(i + 1);
+        if (end < begin) end = begin;
+        if (end < text.length) {
+            char *nl = (char*)memchr(text.data + end, '\n', text.length - end);
+            end = nl != NULL ? (size_t)(nl - text.data) + 1 : text.length;
         }
+        chunks[i].text = sv_from_parts(text.data + begin, end - begin);
+        begin = end;
     }
-    
+
+    matrix_run_parallel(n_threads, matrix_text_count_chunk, &job);
+
+    size_t rows = 0;
+    size_t cols = 0;
+    for (size_t i = 0; i < n_threads; i++) {
+        if (chunks[i].err != 0) return_defer(chunks[i].err);
+        if (chunks[i].rows == 0) continue;
+        if (cols == 0) cols = chunks[i].cols;
+        else if (cols != chunks[i].cols) {
+            log_error("matrix text: row with %zu values, expected %zu", chunks[i].cols, cols);
+            return_defer(EINVAL);
+        }
+        chunks[i].first_row = rows;
+        rows += chunks[i].rows;
+    }
+
+    m->dtype = MATRIX_DTYPE_F64;
+    m->rows = rows;
+    m->cols = cols;
+    if (rows*cols == 0) return_defer(0);
+    m->data = (double*)malloc(rows*cols*sizeof(double));
+    fatal_if(m->data == NULL, MSG_ERR_FULL_MEMORY);
+
+    matrix_run_parallel(n_threads, matrix_text_parse_chunk, &job);
+    for (size_t i = 0; i < n_threads; i++) {
+        if (chunks[i].err != 0) return_defer(chunks[i].err);
+    }
+
+defer:
+    free(chunks);
+    if (result != 0) matrix_free(m);
+    return result;
 }
 
-double dot_product(double *vec1, double *vec2, size_t len) {
-    double result = 0;
-    for(size_t i = 0; i < len; i++) {
-        result += vec1[i]*vec2[i];
+Errno matrix_read_text(Cstr *path, Matrix *m, size_t n_threads) {
+    Errno result = 0;
+    String_Builder sb = {0};
+    void *mapping = MAP_FAILED;
+    struct stat st;
+
+    *m = (Matrix){0};
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+        mapping = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
     }
+
+    String_View text;
+    if (mapping != MAP_FAILED) {
+        madvise(mapping, st.st_size, MADV_SEQUENTIAL);
+        text = sv_from_parts((char*)mapping, st.st_size);
+    } else {
+        // pipe, file speciali o file vuoti: si legge tutto in memoria
+        Errno err = sb_read_entire_file(&sb, path);
+        if (err != 0) return_defer(err);
+        text = sv_from_sb(&sb);
+    }
+
+    result = matrix_parse_text(text, m, n_threads);
+
+defer:
+    if (mapping != MAP_FAILED) munmap(mapping, st.st_size);
+    free(sb.data);
+    if (fd >= 0) close(fd);
     return result;
 }
 
+typedef struct {
+    double *mtx;
+    size_t rows;
+    size_t cols;
+    char delim;
+    size_t n_chunks;
+    String_Builder *out;
+} Matrix_Format_Job;
+
+// "%.17g" produce al massimo 24 caratteri (es. -1.2345678901234567e-308)
+#define MATRIX_TEXT_MAX_VALUE_LEN 24
+
+static inline void matrix_text_format_chunk(void *ctx, size_t index) {
+    Matrix_Format_Job *job = (Matrix_Format_Job*)ctx;
+    size_t first = job->rows*index/job->n_chunks;
+    size_t last = job->rows*(index + 1)/job->n_chunks;
+
+    // il buffer viene dimensionato una volta sola per il caso peggiore
+    String_Builder sb = sb_with_capacity((last - first)*job->cols*(MATRIX_TEXT_MAX_VALUE_LEN + 1) + 1);
+    for (size_t i = first; i < last; i++) {
+        for (size_t j = 0; j < job->cols; j++) {
+            sb.length += snprintf(sb.data + sb.length, MATRIX_TEXT_MAX_VALUE_LEN + 1, "%.17g", job->mtx[i*job->cols + j]);
+            sb.data[sb.length++] = j == job->cols - 1 ? '\n' : job->delim;
+        }
+    }
+    job->out[index] = sb;
+}
+
+Errno matrix_write_text(Cstr *path, double *mtx, size_t rows, size_t cols, char delim, size_t n_threads) {
+    Errno result = 0;
+
+    if (n_threads == 0) n_threads = 1;
+    if (n_threads > rows) n_threads = rows > 0 ? rows : 1;
+
+    String_Builder *out = (String_Builder*)calloc(n_threads, sizeof(*out));
+    fatal_if(out == NULL, MSG_ERR_FULL_MEMORY);
+
+    FILE *f = fopen(path, "wb");
+    if (f == NULL) {
+        int err = errno;
+        log_error("Could not open the file '%s', errno: %s", path, strerror(err));
+        return_defer(err);
+    }
+
+    if (cols > 0) {
+        Matrix_Format_Job job = {
+            .mtx = mtx, .rows = rows, .cols = cols, .delim = delim,
+            .n_chunks = n_threads, .out = out
+        };
+        matrix_run_parallel(n_threads, matrix_text_format_chunk, &job);
+    }
+
+    for (size_t i = 0; i < n_threads; i++) {
+        if (fwrite(out[i].data, 1, out[i].length, f) != out[i].length) {
+            int err = errno;
+            log_error("Could not write on the file '%s', errno: %s", path, strerror(err));
+            return_defer(err);
+        }
+    }
+
+defer:
+    if (f && fclose(f) != 0 && result == 0) {
+        result = errno;
+        log_error("Could not write on the file '%s', errno: %s", path, strerror(result));
+    }
+    for (size_t i = 0; i < n_threads; i++) free(out[i].data);
+    free(out);
+    return result;
+}
+
+#define MATRIX_T double
+#define MATRIX_SUFFIX f64
+#include "matrix_template.h"
+
+#define MATRIX_T float
+#define MATRIX_SUFFIX f32
+#include "matrix_template.h"
+
 void fprintArrayFloat(FILE *stream, float *array,size_t lenght){
 
     for(size_t i=0;i<lenght;i++){
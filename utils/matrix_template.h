@@ -0,0 +1,218 @@
+/*
+    Template dei kernel di matrix.h, istanziato una volta per ogni tipo di elemento.
+    Prima dell'include vanno definiti:
+        MATRIX_T      tipo degli elementi (float o double)
+        MATRIX_SUFFIX suffisso dei nomi generati (f32 o f64)
+    Non ha include guard perché viene incluso più volte, e non va incluso
+    direttamente: lo include matrix.h.
+*/
+#if !defined(MATRIX_H_) || !defined(MATRIX_T) || !defined(MATRIX_SUFFIX)
+#error "matrix_template.h is included by matrix.h, include matrix.h instead"
+#endif
+
+#define MATRIX_FN(name) MATRIX_CONCAT(name, MATRIX_SUFFIX)
+
+// vettore SIMD di MATRIX_SIMD_BYTES byte: con AVX 4 double o 8 float
+typedef MATRIX_T MATRIX_FN(matrix_vec) __attribute__((vector_size(MATRIX_SIMD_BYTES)));
+#define MATRIX_VEC MATRIX_FN(matrix_vec)
+#define MATRIX_LANES (MATRIX_SIMD_BYTES/sizeof(MATRIX_T))
+
+MATRIXDEF MATRIX_T *MATRIX_FN(generate_random_matrix)(size_t rows, size_t cols, MATRIX_T min_val, MATRIX_T max_val) {
+    size_t tot_length = rows*cols;
+
+    MATRIX_T *result = (MATRIX_T*)malloc(tot_length*sizeof(*result));
+    fatal_if(result == NULL ,MSG_ERR_FULL_MEMORY);
+
+    MATRIX_FN(random_fill)(result, tot_length, min_val, max_val);
+
+    return result;
+}
+
+MATRIXDEF void MATRIX_FN(random_matrix_tile)(MATRIX_T *out, size_t ld, size_t row0, size_t col0,
+                                             size_t tile_rows, size_t tile_cols, size_t cols,
+                                             MATRIX_T min_val, MATRIX_T max_val, uint64_t seed) {
+    for(size_t i = 0; i < tile_rows; i++) {
+        MATRIX_FN(philox_fill)(seed, 0, (row0 + i)*cols + col0, out + i*ld, tile_cols, min_val, max_val);
+    }
+}
+
+typedef struct {
+    MATRIX_T *result;
+    size_t rows;
+    size_t cols;
+    MATRIX_T min_val;
+    MATRIX_T max_val;
+    uint64_t seed;
+    size_t n_chunks;
+} MATRIX_FN(Matrix_Random_Job);
+
+static inline void MATRIX_FN(matrix_random_chunk)(void *ctx, size_t index) {
+    MATRIX_FN(Matrix_Random_Job) *job = (MATRIX_FN(Matrix_Random_Job)*)ctx;
+    size_t first = job->rows*index/job->n_chunks;
+    size_t last = job->rows*(index + 1)/job->n_chunks;
+    MATRIX_FN(random_matrix_tile)(job->result + first*job->cols, job->cols, first, 0, last - first, job->cols,
+                                  job->cols, job->min_val, job->max_val, job->seed);
+}
+
+MATRIXDEF MATRIX_T *MATRIX_FN(generate_random_matrix_seeded)(size_t rows, size_t cols, MATRIX_T min_val, MATRIX_T max_val,
+                                                             uint64_t seed, size_t n_threads) {
+    MATRIX_T *result = (MATRIX_T*)malloc(rows*cols*sizeof(*result));
+    fatal_if(result == NULL ,MSG_ERR_FULL_MEMORY);
+
+    MATRIX_FN(Matrix_Random_Job) job = {
+        .result = result, .rows = rows, .cols = cols,
+        .min_val = min_val, .max_val = max_val, .seed = seed,
+        .n_chunks = n_threads == 0 ? 1 : (n_threads < rows ? n_threads : (rows > 0 ? rows : 1)),
+    };
+    matrix_run_parallel(job.n_chunks, MATRIX_FN(matrix_random_chunk), &job);
+    return result;
+}
+
+//TODO: rendere possibile la trasposizione di matrici rows x cols
+MATRIXDEF void MATRIX_FN(square_trasposed_matrix)(MATRIX_T *mtx, size_t order) {
+    MATRIX_T temp;
+    for(size_t i = 0; i < order; i++) {
+        for(size_t j = i+1; j < order; j++) {
+            size_t index = i*order + j;
+            temp = mtx[index];
+            mtx[index] = mtx[j*order + i];
+            mtx[j*order + i] = temp;
+        }
+    }
+}
+
+MATRIXDEF void MATRIX_FN(fprintMatrix)(FILE *stream, MATRIX_T *mtx, size_t rows, size_t cols) {
+    for(size_t i=0; i < rows; i++) {
+        fprintf(stream ,"    ");
+        for(size_t j=0; j < cols; j++) {
+            fprintf(stream, "%lf", (double)mtx[i*cols + j]);
+            if(j == cols - 1)
+                putc('\n', stream);
+            else fprintf(stream, " ,");
+        }
+    }
+}
+
+MATRIXDEF MATRIX_T MATRIX_FN(dot_product)(MATRIX_T *vec1, MATRIX_T *vec2, size_t len) {
+    // due accumulatori vettoriali indipendenti nascondono la latenza delle somme
+    MATRIX_VEC acc0 = {0};
+    MATRIX_VEC acc1 = {0};
+    size_t i = 0;
+    for(; i + 2*MATRIX_LANES <= len; i += 2*MATRIX_LANES) {
+        MATRIX_VEC a0, a1, b0, b1;
+        memcpy(&a0, vec1 + i, sizeof(a0));
+        memcpy(&b0, vec2 + i, sizeof(b0));
+        memcpy(&a1, vec1 + i + MATRIX_LANES, sizeof(a1));
+        memcpy(&b1, vec2 + i + MATRIX_LANES, sizeof(b1));
+        acc0 += a0*b0;
+        acc1 += a1*b1;
+    }
+    acc0 += acc1;
+    MATRIX_T result = 0;
+    for(size_t l = 0; l < MATRIX_LANES; l++) {
+        result += acc0[l];
+    }
+    for(; i < len; i++) {
+        result += vec1[i]*vec2[i];
+    }
+    return result;
+}
+
+MATRIXDEF void MATRIX_FN(vector_axpy)(MATRIX_T alpha, MATRIX_T *restrict x, MATRIX_T *restrict y, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        y[i] += alpha*x[i];
+    }
+}
+
+/*
+    Micro-kernel della gemm: C[4 x 2*MATRIX_LANES] += alpha*A[4 x kc]*B[kc x 2*MATRIX_LANES],
+    tutto il blocco di C rimane nei registri durante il ciclo su kc
+*/
+static inline void MATRIX_FN(matrix_gemm_kernel)(size_t kc, MATRIX_T alpha, const MATRIX_T *a, size_t lda,
+                                                 const MATRIX_T *b, size_t ldb, MATRIX_T *c, size_t ldc) {
+    MATRIX_VEC acc[MATRIX_GEMM_MR][2] = {{{0}}};
+    for(size_t p = 0; p < kc; p++) {
+        MATRIX_VEC b0, b1;
+        memcpy(&b0, b + p*ldb, sizeof(b0));
+        memcpy(&b1, b + p*ldb + MATRIX_LANES, sizeof(b1));
+        for(size_t r = 0; r < MATRIX_GEMM_MR; r++) {
+            MATRIX_T a_rp = a[r*lda + p];
+            acc[r][0] += a_rp*b0;
+            acc[r][1] += a_rp*b1;
+        }
+    }
+    for(size_t r = 0; r < MATRIX_GEMM_MR; r++) {
+        MATRIX_VEC c0, c1;
+        memcpy(&c0, c + r*ldc, sizeof(c0));
+        memcpy(&c1, c + r*ldc + MATRIX_LANES, sizeof(c1));
+        c0 += alpha*acc[r][0];
+        c1 += alpha*acc[r][1];
+        memcpy(c + r*ldc, &c0, sizeof(c0));
+        memcpy(c + r*ldc + MATRIX_LANES, &c1, sizeof(c1));
+    }
+}
+
+// bordi che non riempiono un micro-kernel: C[mr x nr] += alpha*A[mr x kc]*B[kc x nr]
+static inline void MATRIX_FN(matrix_gemm_edge)(size_t mr, size_t nr, size_t kc, MATRIX_T alpha,
+                                               const MATRIX_T *a, size_t lda, const MATRIX_T *b, size_t ldb,
+                                               MATRIX_T *c, size_t ldc) {
+    for(size_t i = 0; i < mr; i++) {
+        for(size_t p = 0; p < kc; p++) {
+            MATRIX_T a_ip = alpha*a[i*lda + p];
+            for(size_t j = 0; j < nr; j++) {
+                c[i*ldc + j] += a_ip*b[p*ldb + j];
+            }
+        }
+    }
+}
+
+MATRIXDEF void MATRIX_FN(matrix_gemm)(size_t m, size_t n, size_t k, MATRIX_T alpha,
+                                      const MATRIX_T *a, size_t lda, const MATRIX_T *b, size_t ldb,
+                                      MATRIX_T beta, MATRIX_T *c, size_t ldc) {
+    const size_t nr = 2*MATRIX_LANES;
+
+    if(beta != 1) {
+        for(size_t i = 0; i < m; i++) {
+            MATRIX_T *c_row = c + i*ldc;
+            if(beta == 0) memset(c_row, 0, n*sizeof(*c_row));
+            else for(size_t j = 0; j < n; j++) c_row[j] *= beta;
+        }
+    }
+    if(alpha == 0 || k == 0) return;
+
+    // il blocco KC x NC di B resta in cache mentre viene usato da tutte le righe di A
+    for(size_t jj = 0; jj < n; jj += MATRIX_GEMM_NC) {
+        size_t nc = n - jj < MATRIX_GEMM_NC ? n - jj : MATRIX_GEMM_NC;
+        for(size_t pp = 0; pp < k; pp += MATRIX_GEMM_KC) {
+            size_t kc = k - pp < MATRIX_GEMM_KC ? k - pp : MATRIX_GEMM_KC;
+            const MATRIX_T *b_block = b + pp*ldb + jj;
+            size_t i = 0;
+            for(; i + MATRIX_GEMM_MR <= m; i += MATRIX_GEMM_MR) {
+                const MATRIX_T *a_panel = a + i*lda + pp;
+                MATRIX_T *c_panel = c + i*ldc + jj;
+                size_t j = 0;
+                for(; j + nr <= nc; j += nr) {
+                    MATRIX_FN(matrix_gemm_kernel)(kc, alpha, a_panel, lda, b_block + j, ldb, c_panel + j, ldc);
+                }
+                if(j < nc) {
+                    MATRIX_FN(matrix_gemm_edge)(MATRIX_GEMM_MR, nc - j, kc, alpha, a_panel, lda,
+                                                b_block + j, ldb, c_panel + j, ldc);
+                }
+            }
+            if(i < m) {
+                MATRIX_FN(matrix_gemm_edge)(m - i, nc, kc, alpha, a + i*lda + pp, lda,
+                                            b_block, ldb, c + i*ldc + jj, ldc);
+            }
+        }
+    }
+}
+
+MATRIXDEF Errno MATRIX_FN(matrix_save)(Cstr *path, MATRIX_T *mtx, size_t rows, size_t cols) {
+    return matrix_save_raw(path, mtx, sizeof(MATRIX_T) == sizeof(float) ? MATRIX_DTYPE_F32 : MATRIX_DTYPE_F64, rows, cols);
+}
+
+#undef MATRIX_LANES
+#undef MATRIX_VEC
+#undef MATRIX_FN
+#undef MATRIX_SUFFIX
+#undef MATRIX_T
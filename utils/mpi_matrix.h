@@ -0,0 +1,400 @@
+#ifndef MPI_MATRIX_H_
+#define MPI_MATRIX_H_
+
+/*
+    Matrici distribuite con MPI su una griglia di processi.
+    Va incluso prima degli altri header (o dopo mpi.h), così logging.h
+    termina tutti i processi con MPI_Abort in caso di errore fatale.
+    Compilare con mpicc ed eseguire con mpirun -np <processi>.
+*/
+#include <mpi.h>
+
+#ifndef MPI_H_
+#define MPI_H_
+#endif // MPI_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "matrix.h"
+
+#ifndef MPIMATRIXDEF
+#define MPIMATRIXDEF static inline
+#endif // MPIMATRIXDEF
+
+/*
+    Matrice rows x cols divisa in blocchi su una griglia grid_rows x grid_cols di processi.
+    Il processo (my_row, my_col) possiede il blocco di righe row_offset..row_offset+local_rows
+    e colonne col_offset..col_offset+local_cols, salvato row-major in data.
+    Una distribuzione a blocchi di righe è una griglia size x 1.
+*/
+typedef struct {
+    MPI_Comm comm;
+    MPI_Comm row_comm; // processi sulla stessa riga della griglia, ordinati per colonna
+    MPI_Comm col_comm; // processi sulla stessa colonna della griglia, ordinati per riga
+    int rank;
+    int size;
+    int grid_rows;
+    int grid_cols;
+    int my_row;
+    int my_col;
+    size_t rows;
+    size_t cols;
+    size_t local_rows;
+    size_t local_cols;
+    size_t row_offset;
+    size_t col_offset;
+    double *data;
+} Dist_Matrix;
+
+/*
+    Crea una matrice distribuita (collettiva su comm)
+    @param comm comunicatore dei processi che condividono la matrice
+    @param rows righe globali
+    @param cols colonne globali
+    @param grid_rows righe della griglia di processi, 0 per sceglierla con MPI_Dims_create
+    @param grid_cols colonne della griglia di processi, 0 per sceglierla con MPI_Dims_create
+    @note grid_rows*grid_cols deve essere uguale al numero di processi di comm
+    @note il blocco locale viene inizializzato a zero
+*/
+MPIMATRIXDEF Dist_Matrix dist_matrix_init(MPI_Comm comm, size_t rows, size_t cols, int grid_rows, int grid_cols);
+
+/*
+    Crea una matrice distribuita a blocchi di righe (griglia size x 1)
+*/
+#define dist_matrix_init_block_row(comm, rows, cols) \
+    dist_matrix_init((comm), (rows), (cols), 0, 1)
+
+/*
+    Crea una matrice con la stessa griglia di processi di like
+*/
+MPIMATRIXDEF Dist_Matrix dist_matrix_init_like(Dist_Matrix *like, size_t rows, size_t cols);
+
+/*
+    Libera il blocco locale e i comunicatori (collettiva)
+*/
+MPIMATRIXDEF void dist_matrix_free(Dist_Matrix *m);
+
+/*
+    Distribuisce una matrice row-major che si trova sul processo root
+    @param global matrice rows x cols, letta solo dal processo root (può essere NULL sugli altri)
+    @param root rank del processo che possiede la matrice intera
+*/
+MPIMATRIXDEF void dist_matrix_scatter(Dist_Matrix *m, const double *global, int root);
+
+/*
+    Raccoglie la matrice intera sul processo root
+    @param global matrice rows x cols, scritta solo sul processo root (può essere NULL sugli altri)
+*/
+MPIMATRIXDEF void dist_matrix_gather(Dist_Matrix *m, double *global, int root);
+
+/*
+    Riempie il blocco locale con i valori di generate_random_matrix_seeded(rows, cols, min_val, max_val, seed, ...):
+    ogni processo genera solo la sua parte, senza comunicazione, e la matrice
+    risultante non dipende dal numero di processi o dalla griglia
+*/
+MPIMATRIXDEF void dist_matrix_fill_random(Dist_Matrix *m, double min_val, double max_val, uint64_t seed);
+
+/*
+    Prodotto distribuito C = A*B con l'algoritmo SUMMA: ad ogni passo un pannello di
+    colonne di A viene trasmesso lungo le righe della griglia e un pannello di righe di B
+    lungo le colonne, e ogni processo aggiorna il suo blocco di C con matrix_gemm.
+    La trasmissione del pannello successivo (MPI_Ibcast) si sovrappone al calcolo
+    su quello corrente.
+    @note A, B e C devono stare sulla stessa griglia di processi,
+    con A rows x k, B k x cols e C rows x cols
+*/
+MPIMATRIXDEF void dist_matrix_multiply(Dist_Matrix *c, Dist_Matrix *a, Dist_Matrix *b);
+
+/*
+    Prodotto scalare di Frobenius (somma degli a_ij*b_ij) tra due matrici con la stessa distribuzione
+    @return il risultato, uguale su tutti i processi
+*/
+MPIMATRIXDEF double dist_matrix_dot(Dist_Matrix *a, Dist_Matrix *b);
+
+/*
+    @return norma di Frobenius della matrice, uguale su tutti i processi
+*/
+MPIMATRIXDEF double dist_matrix_norm(Dist_Matrix *a);
+
+// righe/colonne di default di un pannello SUMMA
+#ifndef DIST_MATRIX_PANEL
+#define DIST_MATRIX_PANEL 128
+#endif // DIST_MATRIX_PANEL
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+// dimensione e offset del blocco idx quando n elementi vengono divisi in parts blocchi
+static inline size_t dist_block_size(size_t n, int parts, int idx) {
+    return n/parts + ((size_t)idx < n%parts);
+}
+
+static inline size_t dist_block_offset(size_t n, int parts, int idx) {
+    size_t rem = n%parts;
+    return idx*(n/parts) + ((size_t)idx < rem ? (size_t)idx : rem);
+}
+
+// blocco che contiene l'indice globale g
+static inline int dist_block_owner(size_t n, int parts, size_t g) {
+    size_t base = n/parts;
+    size_t rem = n%parts;
+    if (g < rem*(base + 1)) return g/(base + 1);
+    return rem + (g - rem*(base + 1))/base;
+}
+
+/*
+    Conteggi degli elementi nelle chiamate MPI. Da MPI 4 esistono le versioni _c con MPI_Count;
+    prima i conteggi sono int e un blocco oltre INT_MAX elementi verrebbe troncato
+    in silenzio, quindi il programma termina
+*/
+#if MPI_VERSION >= 4
+typedef MPI_Count Dist_Count;
+#define DIST_MPI(name) name##_c
+#else
+typedef int Dist_Count;
+#define DIST_MPI(name) name
+#endif // MPI_VERSION
+
+static inline Dist_Count dist_count(size_t n, Cstr *what) {
+#if MPI_VERSION < 4
+    fatal_if(n > INT_MAX, "%s: %zu elements do not fit the int counts of MPI %d.%d",
+             what, n, MPI_VERSION, MPI_SUBVERSION);
+#else
+    (void)what;
+#endif // MPI_VERSION
+    return (Dist_Count)n;
+}
+
+static inline Dist_Matrix dist_matrix_init_grid(MPI_Comm comm, size_t rows, size_t cols, int grid_rows, int grid_cols,
+                                                MPI_Comm row_comm, MPI_Comm col_comm) {
+    Dist_Matrix m = {
+        .comm = comm,
+        .grid_rows = grid_rows,
+        .grid_cols = grid_cols,
+        .rows = rows,
+        .cols = cols,
+    };
+    Control(MPI_Comm_rank(comm, &m.rank));
+    Control(MPI_Comm_size(comm, &m.size));
+    m.my_row = m.rank/grid_cols;
+    m.my_col = m.rank%grid_cols;
+    if (row_comm == MPI_COMM_NULL) {
+        Control(MPI_Comm_split(comm, m.my_row, m.my_col, &row_comm));
+        Control(MPI_Comm_split(comm, m.my_col, m.my_row, &col_comm));
+    } else {
+        Control(MPI_Comm_dup(row_comm, &row_comm));
+        Control(MPI_Comm_dup(col_comm, &col_comm));
+    }
+    m.row_comm = row_comm;
+    m.col_comm = col_comm;
+    m.local_rows = dist_block_size(rows, grid_rows, m.my_row);
+    m.local_cols = dist_block_size(cols, grid_cols, m.my_col);
+    m.row_offset = dist_block_offset(rows, grid_rows, m.my_row);
+    m.col_offset = dist_block_offset(cols, grid_cols, m.my_col);
+    size_t local = m.local_rows*m.local_cols;
+    m.data = (double*)calloc(local > 0 ? local : 1, sizeof(double));
+    fatal_if(m.data == NULL, MSG_ERR_FULL_MEMORY);
+    return m;
+}
+
+Dist_Matrix dist_matrix_init(MPI_Comm comm, size_t rows, size_t cols, int grid_rows, int grid_cols) {
+    int size;
+    Control(MPI_Comm_size(comm, &size));
+    int dims[2] = { grid_rows, grid_cols };
+    Control(MPI_Dims_create(size, 2, dims));
+    fatal_if(dims[0]*dims[1] != size, "process grid %dx%d does not match %d processes", dims[0], dims[1], size);
+    return dist_matrix_init_grid(comm, rows, cols, dims[0], dims[1], MPI_COMM_NULL, MPI_COMM_NULL);
+}
+
+Dist_Matrix dist_matrix_init_like(Dist_Matrix *like, size_t rows, size_t cols) {
+    return dist_matrix_init_grid(like->comm, rows, cols, like->grid_rows, like->grid_cols,
+                                 like->row_comm, like->col_comm);
+}
+
+void dist_matrix_free(Dist_Matrix *m) {
+    free(m->data);
+    Control(MPI_Comm_free(&m->row_comm));
+    Control(MPI_Comm_free(&m->col_comm));
+    *m = (Dist_Matrix){0};
+}
+
+/*
+    Tipo MPI che descrive il blocco del processo dest dentro la matrice globale
+    @return false se il blocco è vuoto
+*/
+static inline bool dist_block_type(Dist_Matrix *m, int dest, MPI_Datatype *type, size_t *offset) {
+    int r = dest/m->grid_cols;
+    int c = dest%m->grid_cols;
+    size_t rows = dist_block_size(m->rows, m->grid_rows, r);
+    size_t cols = dist_block_size(m->cols, m->grid_cols, c);
+    if (rows*cols == 0) return false;
+    *offset = dist_block_offset(m->rows, m->grid_rows, r)*m->cols + dist_block_offset(m->cols, m->grid_cols, c);
+    Control(DIST_MPI(MPI_Type_vector)(dist_count(rows, "dist_block_type"), dist_count(cols, "dist_block_type"),
+                                      dist_count(m->cols, "dist_block_type"), MPI_DOUBLE, type));
+    Control(MPI_Type_commit(type));
+    return true;
+}
+
+void dist_matrix_scatter(Dist_Matrix *m, const double *global, int root) {
+    size_t local = m->local_rows*m->local_cols;
+    if (m->rank != root) {
+        if (local > 0) Control(DIST_MPI(MPI_Recv)(m->data, dist_count(local, "dist_matrix_scatter"), MPI_DOUBLE,
+                                                  root, 0, m->comm, MPI_STATUS_IGNORE));
+        return;
+    }
+
+    MPI_Request *requests = (MPI_Request*)malloc(m->size*sizeof(*requests));
+    MPI_Datatype *types = (MPI_Datatype*)malloc(m->size*sizeof(*types));
+    fatal_if(requests == NULL || types == NULL, MSG_ERR_FULL_MEMORY);
+    int n_requests = 0;
+    for (int dest = 0; dest < m->size; dest++) {
+        size_t offset;
+        if (dest == root || !dist_block_type(m, dest, &types[n_requests], &offset)) continue;
+        Control(MPI_Isend(global + offset, 1, types[n_requests], dest, 0, m->comm, &requests[n_requests]));
+        n_requests++;
+    }
+    // il blocco locale viene copiato mentre gli altri sono in viaggio
+    for (size_t i = 0; i < m->local_rows; i++) {
+        memcpy(m->data + i*m->local_cols, global + (m->row_offset + i)*m->cols + m->col_offset,
+               m->local_cols*sizeof(double));
+    }
+    Control(MPI_Waitall(n_requests, requests, MPI_STATUSES_IGNORE));
+    for (int i = 0; i < n_requests; i++) Control(MPI_Type_free(&types[i]));
+    free(types);
+    free(requests);
+}
+
+void dist_matrix_gather(Dist_Matrix *m, double *global, int root) {
+    size_t local = m->local_rows*m->local_cols;
+    if (m->rank != root) {
+        if (local > 0) Control(DIST_MPI(MPI_Send)(m->data, dist_count(local, "dist_matrix_gather"), MPI_DOUBLE,
+                                                  root, 1, m->comm));
+        return;
+    }
+
+    MPI_Request *requests = (MPI_Request*)malloc(m->size*sizeof(*requests));
+    MPI_Datatype *types = (MPI_Datatype*)malloc(m->size*sizeof(*types));
+    fatal_if(requests == NULL || types == NULL, MSG_ERR_FULL_MEMORY);
+    int n_requests = 0;
+    for (int src = 0; src < m->size; src++) {
+        size_t offset;
+        if (src == root || !dist_block_type(m, src, &types[n_requests], &offset)) continue;
+        Control(MPI_Irecv(global + offset, 1, types[n_requests], src, 1, m->comm, &requests[n_requests]));
+        n_requests++;
+    }
+    for (size_t i = 0; i < m->local_rows; i++) {
+        memcpy(global + (m->row_offset + i)*m->cols + m->col_offset, m->data + i*m->local_cols,
+               m->local_cols*sizeof(double));
+    }
+    Control(MPI_Waitall(n_requests, requests, MPI_STATUSES_IGNORE));
+    for (int i = 0; i < n_requests; i++) Control(MPI_Type_free(&types[i]));
+    free(types);
+    free(requests);
+}
+
+/*
+    Pannello SUMMA: colonne k0..k0+kb di A (local_rows x kb) e righe k0..k0+kb di B (kb x local_cols)
+*/
+typedef struct {
+    size_t k0;
+    size_t kb;
+    double *a;
+    double *b;
+    MPI_Request requests[2];
+} Dist_Panel;
+
+/*
+    Prossimo pannello che inizia da k0: non attraversa i confini dei blocchi
+    delle colonne di A né delle righe di B, così ha un solo proprietario per ognuno
+*/
+static inline void dist_panel_start(Dist_Matrix *a, Dist_Matrix *b, Dist_Panel *p, size_t k0) {
+    size_t k = a->cols;
+    int a_owner = dist_block_owner(k, a->grid_cols, k0);
+    int b_owner = dist_block_owner(k, b->grid_rows, k0);
+    size_t a_end = dist_block_offset(k, a->grid_cols, a_owner) + dist_block_size(k, a->grid_cols, a_owner);
+    size_t b_end = dist_block_offset(k, b->grid_rows, b_owner) + dist_block_size(k, b->grid_rows, b_owner);
+    size_t end = k0 + DIST_MATRIX_PANEL;
+    if (a_end < end) end = a_end;
+    if (b_end < end) end = b_end;
+    p->k0 = k0;
+    p->kb = end - k0;
+
+    if (a->my_col == a_owner) {
+        for (size_t i = 0; i < a->local_rows; i++) {
+            memcpy(p->a + i*p->kb, a->data + i*a->local_cols + (k0 - a->col_offset), p->kb*sizeof(double));
+        }
+    }
+    if (b->my_row == b_owner) {
+        memcpy(p->b, b->data + (k0 - b->row_offset)*b->local_cols, p->kb*b->local_cols*sizeof(double));
+    }
+    Control(DIST_MPI(MPI_Ibcast)(p->a, dist_count(a->local_rows*p->kb, "dist_matrix_multiply"), MPI_DOUBLE,
+                                 a_owner, a->row_comm, &p->requests[0]));
+    Control(DIST_MPI(MPI_Ibcast)(p->b, dist_count(p->kb*b->local_cols, "dist_matrix_multiply"), MPI_DOUBLE,
+                                 b_owner, b->col_comm, &p->requests[1]));
+}
+
+void dist_matrix_multiply(Dist_Matrix *c, Dist_Matrix *a, Dist_Matrix *b) {
+    fatal_if(a->cols != b->rows || c->rows != a->rows || c->cols != b->cols,
+        "dist_matrix_multiply: %zux%zu * %zux%zu -> %zux%zu", a->rows, a->cols, b->rows, b->cols, c->rows, c->cols);
+    fatal_if(a->grid_rows != c->grid_rows || a->grid_cols != c->grid_cols ||
+             b->grid_rows != c->grid_rows || b->grid_cols != c->grid_cols,
+        "dist_matrix_multiply: matrices must share the process grid");
+
+    memset(c->data, 0, c->local_rows*c->local_cols*sizeof(double));
+    size_t k = a->cols;
+    if (k == 0) return;
+
+    // doppio buffer: mentre si calcola con un pannello arriva il successivo
+    Dist_Panel panels[2];
+    for (int i = 0; i < 2; i++) {
+        panels[i].a = (double*)malloc((a->local_rows*DIST_MATRIX_PANEL + 1)*sizeof(double));
+        panels[i].b = (double*)malloc((DIST_MATRIX_PANEL*b->local_cols + 1)*sizeof(double));
+        fatal_if(panels[i].a == NULL || panels[i].b == NULL, MSG_ERR_FULL_MEMORY);
+    }
+
+    int curr = 0;
+    dist_panel_start(a, b, &panels[curr], 0);
+    while (true) {
+        Dist_Panel *p = &panels[curr];
+        Control(MPI_Waitall(2, p->requests, MPI_STATUSES_IGNORE));
+        size_t next_k0 = p->k0 + p->kb;
+        if (next_k0 < k) dist_panel_start(a, b, &panels[1 - curr], next_k0);
+
+        matrix_gemm_f64(c->local_rows, c->local_cols, p->kb, 1.0, p->a, p->kb,
+                        p->b, c->local_cols, 1.0, c->data, c->local_cols);
+
+        if (next_k0 >= k) break;
+        curr = 1 - curr;
+    }
+
+    for (int i = 0; i < 2; i++) {
+        free(panels[i].a);
+        free(panels[i].b);
+    }
+}
+
+void dist_matrix_fill_random(Dist_Matrix *m, double min_val, double max_val, uint64_t seed) {
+    random_matrix_tile_f64(m->data, m->local_cols, m->row_offset, m->col_offset,
+                           m->local_rows, m->local_cols, m->cols, min_val, max_val, seed);
+}
+
+double dist_matrix_dot(Dist_Matrix *a, Dist_Matrix *b) {
+    fatal_if(a->local_rows != b->local_rows || a->local_cols != b->local_cols,
+        "dist_matrix_dot: matrices must have the same distribution");
+    double local = dot_product_f64(a->data, b->data, a->local_rows*a->local_cols);
+    double result;
+    Control(MPI_Allreduce(&local, &result, 1, MPI_DOUBLE, MPI_SUM, a->comm));
+    return result;
+}
+
+double dist_matrix_norm(Dist_Matrix *a) {
+    return sqrt(dist_matrix_dot(a, a));
+}
+
+#endif // MPI_MATRIX_H_
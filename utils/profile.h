@@ -0,0 +1,413 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define PROFILE_HAS_TSC
+#endif
+
+#include "macros.h"
+#include "logging.h"
+
+#ifndef PROFILEDEF
+#define PROFILEDEF static inline
+#endif // PROFILEDEF
+
+/*
+    Timer e istogrammi di latenza per misurare in produzione senza perf.
+
+    Le zone si misurano con PROFILE_ZONE("nome"), che registra la durata fino alla fine
+    del blocco in cui compare. Ogni thread ha i propri istogrammi, aggiornati senza lock
+    né istruzioni atomiche read-modify-write; profile_report li unisce e stampa
+    count, media, min, p50, p99, p999 e max di ogni zona.
+*/
+
+// numero massimo di zone distinte nel programma
+#ifndef PROFILE_MAX_ZONES
+#define PROFILE_MAX_ZONES 256
+#endif // PROFILE_MAX_ZONES
+
+/*
+    Sotto-secchi per ogni potenza di 2 dell'istogramma (2^PROFILE_SUB_BITS): con 5 bit
+    l'errore relativo dei percentili è al più 1/32, come un HDR histogram a 2 cifre
+*/
+#ifndef PROFILE_SUB_BITS
+#define PROFILE_SUB_BITS 5
+#endif // PROFILE_SUB_BITS
+
+#define PROFILE_SUB_BUCKETS (1 << PROFILE_SUB_BITS)
+#define PROFILE_BUCKETS ((64 - PROFILE_SUB_BITS + 1)*PROFILE_SUB_BUCKETS)
+
+/*
+    Istogramma log-lineare di valori a 64 bit (nanosecondi per le zone).
+    Un solo thread scrive, gli altri possono leggere in qualsiasi momento.
+*/
+typedef struct {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t min;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[PROFILE_BUCKETS];
+} Profile_Histogram;
+
+/*
+    Una zona misurata: una variabile statica per ogni uso di PROFILE_ZONE
+*/
+typedef struct {
+    Cstr *name;
+    _Atomic int id; // -1 finché non viene registrata
+} Profile_Site;
+
+typedef struct {
+    Profile_Site *site;
+    uint64_t start;
+} Profile_Scope;
+
+/*
+    Calibra il contatore di cicli (circa 10 ms). Viene chiamata in automatico
+    alla prima zona, chiamarla all'avvio evita il ritardo sulla prima misura.
+*/
+PROFILEDEF void profile_init(void);
+
+/*
+    @return nanosecondi di CLOCK_MONOTONIC
+*/
+PROFILEDEF uint64_t profile_now_ns(void);
+
+/*
+    @return contatore di cicli (rdtsc) o, senza TSC, nanosecondi
+*/
+PROFILEDEF uint64_t profile_ticks(void);
+
+/*
+    Converte una differenza di profile_ticks in nanosecondi
+*/
+PROFILEDEF uint64_t profile_ticks_to_ns(uint64_t ticks);
+
+/*
+    Aggiunge un valore all'istogramma
+    @note un solo thread può scrivere in un istogramma
+*/
+PROFILEDEF void profile_histogram_record(Profile_Histogram *h, uint64_t value);
+
+/*
+    Unisce src in dst
+*/
+PROFILEDEF void profile_histogram_merge(Profile_Histogram *dst, const Profile_Histogram *src);
+
+/*
+    @param q quantile in [0, 1] (es. 0.99)
+    @return valore sotto cui cade una frazione q dei campioni (limite superiore del secchio)
+*/
+PROFILEDEF uint64_t profile_histogram_percentile(const Profile_Histogram *h, double q);
+
+/*
+    Registra una durata misurata a mano per la zona site
+*/
+PROFILEDEF void profile_record(Profile_Site *site, uint64_t ns);
+
+/*
+    Stampa una riga per zona con i dati di tutti i thread, anche di quelli terminati
+*/
+PROFILEDEF void profile_report(FILE *out);
+
+/*
+    @return istogramma della zona con i dati di tutti i thread, false se la zona non esiste
+*/
+PROFILEDEF bool profile_zone_histogram(Cstr *name, Profile_Histogram *out);
+
+PROFILEDEF Profile_Scope profile_scope_begin(Profile_Site *site);
+PROFILEDEF void profile_scope_end(Profile_Scope *scope);
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+/*
+    Misura il tempo da qui alla fine del blocco corrente
+    @param name nome della zona (stringa costante)
+*/
+#define PROFILE_ZONE(name)                                                                  \
+    static Profile_Site PROFILE_CONCAT(profile_site_, __LINE__) = { (name), -1 };           \
+    Profile_Scope PROFILE_CONCAT(profile_scope_, __LINE__) __attribute__((cleanup(profile_scope_end))) = \
+        profile_scope_begin(&PROFILE_CONCAT(profile_site_, __LINE__))
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+typedef struct Profile_Thread {
+    struct Profile_Thread *prev;
+    struct Profile_Thread *next;
+    _Atomic(Profile_Histogram*) zones[PROFILE_MAX_ZONES];
+} Profile_Thread;
+
+typedef struct {
+    pthread_mutex_t mutex;
+    pthread_once_t once;
+    pthread_key_t key;
+    double ns_per_tick;
+    _Atomic int n_sites;
+    Profile_Site *sites[PROFILE_MAX_ZONES];
+    Profile_Thread *threads;                      // thread vivi
+    Profile_Histogram *retired[PROFILE_MAX_ZONES]; // dati dei thread terminati
+} Profile_State;
+
+SHARED_GLOBAL Profile_State profile_state = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+    .once = PTHREAD_ONCE_INIT,
+    .ns_per_tick = 1.0,
+};
+
+SHARED_GLOBAL _Thread_local Profile_Thread *profile_thread;
+
+uint64_t profile_now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t profile_ticks(void) {
+#ifdef PROFILE_HAS_TSC
+    return __rdtsc();
+#else
+    return profile_now_ns();
+#endif // PROFILE_HAS_TSC
+}
+
+uint64_t profile_ticks_to_ns(uint64_t ticks) {
+    return (uint64_t)((double)ticks*profile_state.ns_per_tick);
+}
+
+// scrittura di un contatore che ha un solo writer: load + store, niente lock prefix
+static inline void profile_add(_Atomic uint64_t *counter, uint64_t value) {
+    atomic_store_explicit(counter, atomic_load_explicit(counter, memory_order_relaxed) + value, memory_order_relaxed);
+}
+
+static inline int profile_bucket(uint64_t value) {
+    if (value < PROFILE_SUB_BUCKETS) return (int)value;
+    int exponent = 63 - __builtin_clzll(value);
+    int shift = exponent - PROFILE_SUB_BITS;
+    return (shift + 1)*PROFILE_SUB_BUCKETS + (int)((value >> shift) - PROFILE_SUB_BUCKETS);
+}
+
+// valore più alto che finisce nel secchio
+static inline uint64_t profile_bucket_high(int bucket) {
+    if (bucket < PROFILE_SUB_BUCKETS) return (uint64_t)bucket;
+    int shift = bucket/PROFILE_SUB_BUCKETS - 1;
+    uint64_t mantissa = (uint64_t)(bucket%PROFILE_SUB_BUCKETS + PROFILE_SUB_BUCKETS);
+    return (mantissa << shift) + ((1ull << shift) - 1);
+}
+
+void profile_histogram_record(Profile_Histogram *h, uint64_t value) {
+    uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+    if (count == 0 || value < atomic_load_explicit(&h->min, memory_order_relaxed)) {
+        atomic_store_explicit(&h->min, value, memory_order_relaxed);
+    }
+    if (value > atomic_load_explicit(&h->max, memory_order_relaxed)) {
+        atomic_store_explicit(&h->max, value, memory_order_relaxed);
+    }
+    profile_add(&h->buckets[profile_bucket(value)], 1);
+    profile_add(&h->sum, value);
+    atomic_store_explicit(&h->count, count + 1, memory_order_relaxed);
+}
+
+void profile_histogram_merge(Profile_Histogram *dst, const Profile_Histogram *src) {
+    uint64_t src_count = atomic_load_explicit(&src->count, memory_order_relaxed);
+    if (src_count == 0) return;
+    uint64_t dst_count = atomic_load_explicit(&dst->count, memory_order_relaxed);
+    uint64_t src_min = atomic_load_explicit(&src->min, memory_order_relaxed);
+    uint64_t src_max = atomic_load_explicit(&src->max, memory_order_relaxed);
+    if (dst_count == 0 || src_min < atomic_load_explicit(&dst->min, memory_order_relaxed)) {
+        atomic_store_explicit(&dst->min, src_min, memory_order_relaxed);
+    }
+    if (src_max > atomic_load_explicit(&dst->max, memory_order_relaxed)) {
+        atomic_store_explicit(&dst->max, src_max, memory_order_relaxed);
+    }
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        uint64_t n = atomic_load_explicit(&src->buckets[i], memory_order_relaxed);
+        if (n) profile_add(&dst->buckets[i], n);
+    }
+    profile_add(&dst->sum, atomic_load_explicit(&src->sum, memory_order_relaxed));
+    profile_add(&dst->count, src_count);
+}
+
+uint64_t profile_histogram_percentile(const Profile_Histogram *h, double q) {
+    uint64_t count = 0;
+    // il conteggio viene rifatto sui secchi: con un writer attivo può essere avanti rispetto a count
+    for (int i = 0; i < PROFILE_BUCKETS; i++) count += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+    if (count == 0) return 0;
+    uint64_t rank = (uint64_t)(q*(double)count + 0.5);
+    if (rank < 1) rank = 1;
+    if (rank > count) rank = count;
+    uint64_t seen = 0;
+    uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+    for (int i = 0; i < PROFILE_BUCKETS; i++) {
+        seen += atomic_load_explicit(&h->buckets[i], memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t high = profile_bucket_high(i);
+            return high < max ? high : max;
+        }
+    }
+    return max;
+}
+
+static inline void profile_calibrate(void) {
+#ifdef PROFILE_HAS_TSC
+    uint64_t ns_start = profile_now_ns();
+    uint64_t tick_start = __rdtsc();
+    uint64_t ns_end;
+    do {
+        ns_end = profile_now_ns();
+    } while (ns_end - ns_start < 10000000);
+    uint64_t tick_end = __rdtsc();
+    profile_state.ns_per_tick = (double)(ns_end - ns_start)/(double)(tick_end - tick_start);
+#endif // PROFILE_HAS_TSC
+}
+
+static inline void profile_thread_exit(void *arg) {
+    Profile_Thread *thread = (Profile_Thread*)arg;
+    pthread_mutex_lock(&profile_state.mutex);
+    for (int i = 0; i < PROFILE_MAX_ZONES; i++) {
+        Profile_Histogram *h = atomic_load_explicit(&thread->zones[i], memory_order_relaxed);
+        if (h == NULL) continue;
+        if (profile_state.retired[i] == NULL) {
+            profile_state.retired[i] = (Profile_Histogram*)calloc(1, sizeof(Profile_Histogram));
+            fatal_if(profile_state.retired[i] == NULL, MSG_ERR_FULL_MEMORY);
+        }
+        profile_histogram_merge(profile_state.retired[i], h);
+        free(h);
+    }
+    if (thread->prev) thread->prev->next = thread->next;
+    else profile_state.threads = thread->next;
+    if (thread->next) thread->next->prev = thread->prev;
+    pthread_mutex_unlock(&profile_state.mutex);
+    free(thread);
+}
+
+static inline void profile_setup(void) {
+    profile_calibrate();
+    int err = pthread_key_create(&profile_state.key, profile_thread_exit);
+    fatal_if(err != 0, "profile: could not create the thread key: %s", strerror(err));
+}
+
+void profile_init(void) {
+    pthread_once(&profile_state.once, profile_setup);
+}
+
+// percorso lento: prima misura della zona nel programma
+static inline int profile_register(Profile_Site *site) {
+    profile_init();
+    pthread_mutex_lock(&profile_state.mutex);
+    int id = atomic_load_explicit(&site->id, memory_order_relaxed);
+    if (id < 0) {
+        // zone con lo stesso nome in punti diversi del codice vengono unite
+        int n = atomic_load_explicit(&profile_state.n_sites, memory_order_relaxed);
+        for (int i = 0; i < n && id < 0; i++) {
+            if (strcmp(profile_state.sites[i]->name, site->name) == 0) id = i;
+        }
+        if (id < 0) {
+            fatal_if(n >= PROFILE_MAX_ZONES, "profile: more than %d zones, increase PROFILE_MAX_ZONES", PROFILE_MAX_ZONES);
+            id = n;
+            profile_state.sites[n] = site;
+            atomic_store_explicit(&profile_state.n_sites, n + 1, memory_order_release);
+        }
+        atomic_store_explicit(&site->id, id, memory_order_release);
+    }
+    pthread_mutex_unlock(&profile_state.mutex);
+    return id;
+}
+
+static inline Profile_Histogram *profile_thread_histogram(int id) {
+    Profile_Thread *thread = profile_thread;
+    if (thread == NULL) {
+        thread = (Profile_Thread*)calloc(1, sizeof(*thread));
+        fatal_if(thread == NULL, MSG_ERR_FULL_MEMORY);
+        pthread_mutex_lock(&profile_state.mutex);
+        thread->next = profile_state.threads;
+        if (thread->next) thread->next->prev = thread;
+        profile_state.threads = thread;
+        pthread_mutex_unlock(&profile_state.mutex);
+        pthread_setspecific(profile_state.key, thread);
+        profile_thread = thread;
+    }
+    Profile_Histogram *h = atomic_load_explicit(&thread->zones[id], memory_order_relaxed);
+    if (h == NULL) {
+        h = (Profile_Histogram*)calloc(1, sizeof(*h));
+        fatal_if(h == NULL, MSG_ERR_FULL_MEMORY);
+        atomic_store_explicit(&thread->zones[id], h, memory_order_release);
+    }
+    return h;
+}
+
+void profile_record(Profile_Site *site, uint64_t ns) {
+    int id = atomic_load_explicit(&site->id, memory_order_acquire);
+    if (id < 0) id = profile_register(site);
+    profile_histogram_record(profile_thread_histogram(id), ns);
+}
+
+Profile_Scope profile_scope_begin(Profile_Site *site) {
+    if (atomic_load_explicit(&site->id, memory_order_relaxed) < 0) profile_register(site);
+    return (Profile_Scope){ .site = site, .start = profile_ticks() };
+}
+
+void profile_scope_end(Profile_Scope *scope) {
+    uint64_t end = profile_ticks();
+    profile_record(scope->site, profile_ticks_to_ns(end - scope->start));
+}
+
+// somma dei dati di tutti i thread per la zona id, con il mutex preso
+static inline void profile_collect(int id, Profile_Histogram *out) {
+    memset(out, 0, sizeof(*out));
+    if (profile_state.retired[id]) profile_histogram_merge(out, profile_state.retired[id]);
+    for (Profile_Thread *t = profile_state.threads; t != NULL; t = t->next) {
+        Profile_Histogram *h = atomic_load_explicit(&t->zones[id], memory_order_acquire);
+        if (h) profile_histogram_merge(out, h);
+    }
+}
+
+bool profile_zone_histogram(Cstr *name, Profile_Histogram *out) {
+    bool found = false;
+    pthread_mutex_lock(&profile_state.mutex);
+    int n = atomic_load_explicit(&profile_state.n_sites, memory_order_acquire);
+    for (int i = 0; i < n && !found; i++) {
+        if (strcmp(profile_state.sites[i]->name, name) == 0) {
+            profile_collect(i, out);
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&profile_state.mutex);
+    return found;
+}
+
+void profile_report(FILE *out) {
+    Profile_Histogram *h = (Profile_Histogram*)malloc(sizeof(*h));
+    fatal_if(h == NULL, MSG_ERR_FULL_MEMORY);
+
+    fprintf(out, "%-24s %10s %12s %10s %10s %10s %10s %10s %10s\n",
+            "zone", "count", "total ms", "mean ns", "min ns", "p50 ns", "p99 ns", "p999 ns", "max ns");
+    pthread_mutex_lock(&profile_state.mutex);
+    int n = atomic_load_explicit(&profile_state.n_sites, memory_order_acquire);
+    for (int i = 0; i < n; i++) {
+        profile_collect(i, h);
+        uint64_t count = atomic_load_explicit(&h->count, memory_order_relaxed);
+        uint64_t sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+        fprintf(out, "%-24s %10llu %12.3f %10.0f %10llu %10llu %10llu %10llu %10llu\n",
+                profile_state.sites[i]->name, (unsigned long long)count, (double)sum*1e-6,
+                count ? (double)sum/(double)count : 0.0,
+                (unsigned long long)atomic_load_explicit(&h->min, memory_order_relaxed),
+                (unsigned long long)profile_histogram_percentile(h, 0.50),
+                (unsigned long long)profile_histogram_percentile(h, 0.99),
+                (unsigned long long)profile_histogram_percentile(h, 0.999),
+                (unsigned long long)atomic_load_explicit(&h->max, memory_order_relaxed));
+    }
+    pthread_mutex_unlock(&profile_state.mutex);
+    free(h);
+}
+
+#endif // PROFILE_H_
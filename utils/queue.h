@@ -0,0 +1,418 @@
+#ifndef QUEUE_H_
+#define QUEUE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <sched.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
+
+#include "macros.h"
+#include "logging.h"
+
+#ifndef QUEUEDEF
+#define QUEUEDEF static inline
+#endif // QUEUEDEF
+
+/*
+    Code limitate senza lock per passare elementi fra gli stadi di una pipeline.
+
+    Spsc_Ring: un solo produttore e un solo consumatore. Ognuno scrive solo il proprio
+    indice (su linee di cache separate) e tiene una copia locale dell'indice dell'altro,
+    riletta solo quando la coda sembra piena o vuota.
+
+    Mpmc_Queue: più produttori e più consumatori (Vyukov). Ogni cella ha un numero di
+    sequenza che dice di quale giro è e se è piena; produttori e consumatori si contendono
+    solo il proprio indice con una CAS, e le operazioni a blocchi prenotano più celle
+    con una sola CAS.
+
+    Gli elementi hanno dimensione fissa e vengono copiati nella coda. Le varianti _wait
+    aspettano con un futex quando la coda è piena o vuota, senza occupare la cpu;
+    close sveglia chi aspetta e fa terminare i consumatori una volta svuotata la coda.
+*/
+
+// tentativi (cedendo la cpu) prima di dormire sul futex nelle varianti _wait
+#ifndef QUEUE_SPIN
+#define QUEUE_SPIN 64
+#endif // QUEUE_SPIN
+
+/*
+    Contatore di eventi su cui dormono le varianti _wait: chi aspetta legge seq, si
+    registra in waiters, ricontrolla la coda e dorme solo se seq non è cambiato
+*/
+typedef struct {
+    _Alignas(64) _Atomic uint32_t seq;
+    _Atomic uint32_t waiters;
+} Queue_Event;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t head;   // prossimo da leggere, scritto solo dal consumatore
+    size_t cached_tail;                 // copia del consumatore
+    _Alignas(64) _Atomic size_t tail;   // prossimo da scrivere, scritto solo dal produttore
+    size_t cached_head;                 // copia del produttore
+    _Alignas(64) unsigned char *data;
+    size_t capacity;                    // potenza di 2
+    size_t elem_size;
+    _Atomic bool closed;
+    Queue_Event not_empty;
+    Queue_Event not_full;
+} Spsc_Ring;
+
+typedef struct {
+    _Alignas(64) _Atomic size_t enqueue_pos;
+    _Alignas(64) _Atomic size_t dequeue_pos;
+    _Alignas(64) unsigned char *cells;  // [sequenza | elemento] per ogni cella
+    size_t capacity;                    // potenza di 2
+    size_t elem_size;
+    size_t cell_size;
+    _Atomic bool closed;
+    Queue_Event not_empty;
+    Queue_Event not_full;
+} Mpmc_Queue;
+
+/*
+    Crea una coda per un produttore e un consumatore
+    @param capacity numero di elementi, arrotondato alla potenza di 2 successiva
+    @param elem_size dimensione in byte di un elemento
+*/
+QUEUEDEF Spsc_Ring spsc_ring_init(size_t capacity, size_t elem_size);
+QUEUEDEF void spsc_ring_deinit(Spsc_Ring *ring);
+/*
+    @return false se la coda è piena
+    @note solo dal thread produttore
+*/
+QUEUEDEF bool spsc_ring_push(Spsc_Ring *ring, const void *elem);
+/*
+    @return false se la coda è vuota
+    @note solo dal thread consumatore
+*/
+QUEUEDEF bool spsc_ring_pop(Spsc_Ring *ring, void *elem);
+/*
+    Inserisce fino a n elementi consecutivi di elems con un solo aggiornamento dell'indice
+    @return numero di elementi inseriti
+*/
+QUEUEDEF size_t spsc_ring_push_many(Spsc_Ring *ring, const void *elems, size_t n);
+/*
+    Estrae fino a max elementi in elems
+    @return numero di elementi estratti
+*/
+QUEUEDEF size_t spsc_ring_pop_many(Spsc_Ring *ring, void *elems, size_t max);
+/*
+    Come push, ma aspetta finché c'è spazio
+    @return false se la coda è stata chiusa
+*/
+QUEUEDEF bool spsc_ring_push_wait(Spsc_Ring *ring, const void *elem);
+/*
+    Come pop, ma aspetta finché c'è un elemento
+    @return false se la coda è chiusa e vuota
+*/
+QUEUEDEF bool spsc_ring_pop_wait(Spsc_Ring *ring, void *elem);
+/*
+    Chiude la coda: le _wait in attesa vengono svegliate
+    @note il produttore non deve più inserire dopo la chiusura
+*/
+QUEUEDEF void spsc_ring_close(Spsc_Ring *ring);
+
+/*
+    Crea una coda per più produttori e più consumatori, stessi parametri di spsc_ring_init
+*/
+QUEUEDEF Mpmc_Queue mpmc_queue_init(size_t capacity, size_t elem_size);
+QUEUEDEF void mpmc_queue_deinit(Mpmc_Queue *queue);
+QUEUEDEF bool mpmc_queue_push(Mpmc_Queue *queue, const void *elem);
+QUEUEDEF bool mpmc_queue_pop(Mpmc_Queue *queue, void *elem);
+/*
+    Prenota con una sola CAS le celle libere consecutive, fino a n
+    @return numero di elementi inseriti (0 se la coda è piena)
+*/
+QUEUEDEF size_t mpmc_queue_push_many(Mpmc_Queue *queue, const void *elems, size_t n);
+QUEUEDEF size_t mpmc_queue_pop_many(Mpmc_Queue *queue, void *elems, size_t max);
+QUEUEDEF bool mpmc_queue_push_wait(Mpmc_Queue *queue, const void *elem);
+QUEUEDEF bool mpmc_queue_pop_wait(Mpmc_Queue *queue, void *elem);
+/*
+    Come spsc_ring_close: va chiamata quando tutti i produttori hanno finito di inserire
+*/
+QUEUEDEF void mpmc_queue_close(Mpmc_Queue *queue);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+static inline size_t queue_round_capacity(size_t capacity) {
+    size_t result = 2;
+    while(result < capacity) result *= 2;
+    return result;
+}
+
+static inline void queue_futex_wait(_Atomic uint32_t *addr, uint32_t expected) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAIT_PRIVATE, expected, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)expected;
+    sched_yield();
+#endif
+}
+
+static inline void queue_futex_wake(_Atomic uint32_t *addr, int count) {
+#ifdef __linux__
+    syscall(SYS_futex, (uint32_t*)addr, FUTEX_WAKE_PRIVATE, count, NULL, NULL, 0);
+#else
+    (void)addr;
+    (void)count;
+#endif
+}
+
+/*
+    Sveglia fino a count thread in attesa. La fence si accoppia con l'incremento di
+    waiters in queue_wait: o chi aspetta vede il nuovo stato della coda, o qui si vede
+    chi aspetta. Senza nessuno in attesa costa solo la fence.
+*/
+static inline void queue_notify(Queue_Event *event, size_t count) {
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&event->waiters, memory_order_relaxed) == 0) return;
+    atomic_fetch_add(&event->seq, 1);
+    queue_futex_wake(&event->seq, count > INT_MAX ? INT_MAX : (int)count);
+}
+
+static inline void queue_notify_all(Queue_Event *event) {
+    atomic_fetch_add(&event->seq, 1);
+    queue_futex_wake(&event->seq, INT_MAX);
+}
+
+/*
+    Ripete try_fn finché riesce, dormendo sull'evento dopo QUEUE_SPIN tentativi
+    @param drain a coda chiusa prova un'ultima volta try_fn (pop), altrimenti si ferma subito (push)
+    @return false se la coda è stata chiusa
+*/
+static inline bool queue_wait(Queue_Event *event, _Atomic bool *closed, bool drain,
+                              bool (*try_fn)(void *queue, void *elem), void *queue, void *elem) {
+    for(size_t spin = 0;; spin++) {
+        if(!drain && atomic_load(closed)) return false;
+        if(try_fn(queue, elem)) return true;
+        // gli elementi inseriti prima della chiusura vanno comunque consegnati
+        if(drain && atomic_load(closed)) return try_fn(queue, elem);
+        if(spin < QUEUE_SPIN) {
+            sched_yield();
+            continue;
+        }
+        uint32_t key = atomic_load(&event->seq);
+        atomic_fetch_add(&event->waiters, 1);
+        bool done = try_fn(queue, elem);
+        if(!done && !atomic_load(closed)) queue_futex_wait(&event->seq, key);
+        atomic_fetch_sub(&event->waiters, 1);
+        if(done) return true;
+    }
+}
+
+/* ---------------------- SPSC ---------------------- */
+
+Spsc_Ring spsc_ring_init(size_t capacity, size_t elem_size) {
+    Spsc_Ring ring = {0};
+    ring.capacity = queue_round_capacity(capacity);
+    ring.elem_size = elem_size;
+    ring.data = (unsigned char*)malloc(ring.capacity*elem_size);
+    fatal_if(ring.data == NULL, MSG_ERR_FULL_MEMORY);
+    return ring;
+}
+
+void spsc_ring_deinit(Spsc_Ring *ring) {
+    free(ring->data);
+    ring->data = NULL;
+}
+
+bool spsc_ring_push(Spsc_Ring *ring, const void *elem) {
+    return spsc_ring_push_many(ring, elem, 1) == 1;
+}
+
+bool spsc_ring_pop(Spsc_Ring *ring, void *elem) {
+    return spsc_ring_pop_many(ring, elem, 1) == 1;
+}
+
+// copia count elementi fra la coda (da index, anche a cavallo della fine) e buffer
+static inline void spsc_ring_copy(Spsc_Ring *ring, size_t index, void *buffer, size_t count, bool to_ring) {
+    size_t start = index & (ring->capacity - 1);
+    size_t first = count < ring->capacity - start ? count : ring->capacity - start;
+    unsigned char *slot = ring->data + start*ring->elem_size;
+    unsigned char *bytes = (unsigned char*)buffer;
+    if(to_ring) {
+        memcpy(slot, bytes, first*ring->elem_size);
+        memcpy(ring->data, bytes + first*ring->elem_size, (count - first)*ring->elem_size);
+    } else {
+        memcpy(bytes, slot, first*ring->elem_size);
+        memcpy(bytes + first*ring->elem_size, ring->data, (count - first)*ring->elem_size);
+    }
+}
+
+size_t spsc_ring_push_many(Spsc_Ring *ring, const void *elems, size_t n) {
+    size_t tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    size_t free_slots = ring->capacity - (tail - ring->cached_head);
+    if(free_slots < n) {
+        ring->cached_head = atomic_load_explicit(&ring->head, memory_order_acquire);
+        free_slots = ring->capacity - (tail - ring->cached_head);
+    }
+    size_t count = n < free_slots ? n : free_slots;
+    if(count == 0) return 0;
+    spsc_ring_copy(ring, tail, (void*)elems, count, true);
+    atomic_store_explicit(&ring->tail, tail + count, memory_order_release);
+    queue_notify(&ring->not_empty, count);
+    return count;
+}
+
+size_t spsc_ring_pop_many(Spsc_Ring *ring, void *elems, size_t max) {
+    size_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    size_t available = ring->cached_tail - head;
+    if(available < max) {
+        ring->cached_tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        available = ring->cached_tail - head;
+    }
+    size_t count = max < available ? max : available;
+    if(count == 0) return 0;
+    spsc_ring_copy(ring, head, elems, count, false);
+    atomic_store_explicit(&ring->head, head + count, memory_order_release);
+    queue_notify(&ring->not_full, count);
+    return count;
+}
+
+static inline bool spsc_ring_try_push(void *ring, void *elem) {
+    return spsc_ring_push((Spsc_Ring*)ring, elem);
+}
+
+static inline bool spsc_ring_try_pop(void *ring, void *elem) {
+    return spsc_ring_pop((Spsc_Ring*)ring, elem);
+}
+
+bool spsc_ring_push_wait(Spsc_Ring *ring, const void *elem) {
+    return queue_wait(&ring->not_full, &ring->closed, false, spsc_ring_try_push, ring, (void*)elem);
+}
+
+bool spsc_ring_pop_wait(Spsc_Ring *ring, void *elem) {
+    return queue_wait(&ring->not_empty, &ring->closed, true, spsc_ring_try_pop, ring, elem);
+}
+
+void spsc_ring_close(Spsc_Ring *ring) {
+    atomic_store(&ring->closed, true);
+    queue_notify_all(&ring->not_empty);
+    queue_notify_all(&ring->not_full);
+}
+
+/* ---------------------- MPMC ---------------------- */
+
+#define mpmc_queue_cell(queue, pos) ((queue)->cells + ((pos) & ((queue)->capacity - 1))*(queue)->cell_size)
+#define mpmc_queue_seq(cell) ((_Atomic size_t*)(cell))
+#define mpmc_queue_elem(cell) ((cell) + sizeof(_Atomic size_t))
+
+Mpmc_Queue mpmc_queue_init(size_t capacity, size_t elem_size) {
+    Mpmc_Queue queue = {0};
+    queue.capacity = queue_round_capacity(capacity);
+    queue.elem_size = elem_size;
+    // la sequenza della cella successiva deve restare allineata
+    queue.cell_size = (sizeof(_Atomic size_t) + elem_size + _Alignof(_Atomic size_t) - 1)
+                      /_Alignof(_Atomic size_t)*_Alignof(_Atomic size_t);
+    queue.cells = (unsigned char*)malloc(queue.capacity*queue.cell_size);
+    fatal_if(queue.cells == NULL, MSG_ERR_FULL_MEMORY);
+    // la cella i è libera per la posizione i
+    for(size_t i = 0; i < queue.capacity; i++) atomic_init(mpmc_queue_seq(mpmc_queue_cell(&queue, i)), i);
+    return queue;
+}
+
+void mpmc_queue_deinit(Mpmc_Queue *queue) {
+    free(queue->cells);
+    queue->cells = NULL;
+}
+
+bool mpmc_queue_push(Mpmc_Queue *queue, const void *elem) {
+    return mpmc_queue_push_many(queue, elem, 1) == 1;
+}
+
+bool mpmc_queue_pop(Mpmc_Queue *queue, void *elem) {
+    return mpmc_queue_pop_many(queue, elem, 1) == 1;
+}
+
+/*
+    Prenota fino a n celle consecutive da *index_p: la cella pos + i è pronta quando la sua
+    sequenza vale pos + i + ready_offset. Le celle controllate non possono cambiare stato
+    prima della CAS, perché solo chi prenota la loro posizione le modifica.
+    @return celle prenotate, la prima posizione in *pos_p
+*/
+static inline size_t mpmc_queue_claim(Mpmc_Queue *queue, _Atomic size_t *index_p, size_t ready_offset,
+                                      size_t n, size_t *pos_p) {
+    size_t pos = atomic_load_explicit(index_p, memory_order_relaxed);
+    for(;;) {
+        size_t count = 0;
+        intptr_t diff = 0;
+        while(count < n) {
+            unsigned char *cell = mpmc_queue_cell(queue, pos + count);
+            size_t seq = atomic_load_explicit(mpmc_queue_seq(cell), memory_order_acquire);
+            diff = (intptr_t)(seq - (pos + count + ready_offset));
+            if(diff != 0) break;
+            count++;
+        }
+        if(count == 0 && diff < 0) return 0; // piena (push) o vuota (pop)
+        if(count > 0) {
+            if(atomic_compare_exchange_weak_explicit(index_p, &pos, pos + count,
+                                                     memory_order_relaxed, memory_order_relaxed)) {
+                *pos_p = pos;
+                return count;
+            }
+            // pos è stato aggiornato dalla CAS fallita
+        } else {
+            // un altro thread ha già preso la cella: si riparte dall'indice aggiornato
+            pos = atomic_load_explicit(index_p, memory_order_relaxed);
+        }
+    }
+}
+
+size_t mpmc_queue_push_many(Mpmc_Queue *queue, const void *elems, size_t n) {
+    size_t pos;
+    size_t count = mpmc_queue_claim(queue, &queue->enqueue_pos, 0, n, &pos);
+    const unsigned char *bytes = (const unsigned char*)elems;
+    for(size_t i = 0; i < count; i++) {
+        unsigned char *cell = mpmc_queue_cell(queue, pos + i);
+        memcpy(mpmc_queue_elem(cell), bytes + i*queue->elem_size, queue->elem_size);
+        atomic_store_explicit(mpmc_queue_seq(cell), pos + i + 1, memory_order_release);
+    }
+    if(count > 0) queue_notify(&queue->not_empty, count);
+    return count;
+}
+
+size_t mpmc_queue_pop_many(Mpmc_Queue *queue, void *elems, size_t max) {
+    size_t pos;
+    size_t count = mpmc_queue_claim(queue, &queue->dequeue_pos, 1, max, &pos);
+    unsigned char *bytes = (unsigned char*)elems;
+    for(size_t i = 0; i < count; i++) {
+        unsigned char *cell = mpmc_queue_cell(queue, pos + i);
+        memcpy(bytes + i*queue->elem_size, mpmc_queue_elem(cell), queue->elem_size);
+        // libera la cella per il giro successivo
+        atomic_store_explicit(mpmc_queue_seq(cell), pos + i + queue->capacity, memory_order_release);
+    }
+    if(count > 0) queue_notify(&queue->not_full, count);
+    return count;
+}
+
+static inline bool mpmc_queue_try_push(void *queue, void *elem) {
+    return mpmc_queue_push((Mpmc_Queue*)queue, elem);
+}
+
+static inline bool mpmc_queue_try_pop(void *queue, void *elem) {
+    return mpmc_queue_pop((Mpmc_Queue*)queue, elem);
+}
+
+bool mpmc_queue_push_wait(Mpmc_Queue *queue, const void *elem) {
+    return queue_wait(&queue->not_full, &queue->closed, false, mpmc_queue_try_push, queue, (void*)elem);
+}
+
+bool mpmc_queue_pop_wait(Mpmc_Queue *queue, void *elem) {
+    return queue_wait(&queue->not_empty, &queue->closed, true, mpmc_queue_try_pop, queue, elem);
+}
+
+void mpmc_queue_close(Mpmc_Queue *queue) {
+    atomic_store(&queue->closed, true);
+    queue_notify_all(&queue->not_empty);
+    queue_notify_all(&queue->not_full);
+}
+
+#endif // QUEUE_H_
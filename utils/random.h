@@ -2,6 +2,10 @@
 #define RANDOM_H_
 
 #include <stdlib.h>
+#include <stdint.h>
+#include <stdatomic.h>
+#include <math.h>
+#include <pthread.h>
 
 #include <string.h>
 #include <fcntl.h>
@@ -16,12 +20,35 @@
 #endif // RANDOMDEF
 
 /*
-    Inizializza il modulo dei numeri randomici.
+    Generatore xoshiro256++: 256 bit di stato, periodo 2^256 - 1.
+    Ogni thread deve usare il proprio stato; stream indipendenti si ottengono
+    copiando uno stato e chiamando xoshiro256_jump.
+*/
+typedef struct {
+    uint64_t s[4];
+} Xoshiro256;
+
+/*
+    Generatore PCG64 (XSL-RR 128/64): 128 bit di stato più l'incremento che seleziona lo stream
+*/
+typedef struct {
+    __uint128_t state;
+    __uint128_t inc;
+} Pcg64;
+
+/*
+    Inizializza il modulo dei numeri randomici con un seed letto da /dev/urandom.
     @return seed usato per il generatore di interi randomici.
     @note Viene già fatto il logging del seed dentro questa funzione.
+    @note ogni thread usa uno stream xoshiro256++ indipendente derivato dal seed
 */
 RANDOMDEF unsigned int init_random(void);
 
+/*
+    Come init_random ma con un seed scelto, per riprodurre un'esecuzione precedente
+*/
+RANDOMDEF void init_random_with_seed(uint64_t seed);
+
 /*
     distribuzione uniforme di interi partendo da min fino a max entrambi compresi
     @return min <= result <= max
@@ -29,18 +56,845 @@ RANDOMDEF unsigned int init_random(void);
 RANDOMDEF int uniform_int_distribution(int min, int max);
 
 /*
-    distribuzione uniforme di numeri reali partendo da min fino a max entrambi compresi
-    @return min <= result <= max
+    distribuzione uniforme di numeri reali partendo da min fino a max
+    @return min <= result < max
 */
 RANDOMDEF double uniform_real_distribution(double min, double max);
 
 /*
-    @return Numero casuale tra 0 e 1
+    @return Numero casuale in [0, 1)
 */
 RANDOMDEF double random_01(void);
 
+/*
+    Stato del generatore del thread chiamante, creato alla prima chiamata
+    saltando avanti lo stato del seed di 2^128 passi per ogni thread già partito
+*/
+RANDOMDEF Xoshiro256 *random_thread_rng(void);
+
+/*
+    Crea uno stato xoshiro256++ da un seed a 64 bit (espanso con splitmix64)
+*/
+RANDOMDEF Xoshiro256 xoshiro256_seed(uint64_t seed);
+RANDOMDEF uint64_t xoshiro256_next(Xoshiro256 *rng);
+/*
+    Avanza di 2^128 passi: genera fino a 2^128 stream non sovrapposti
+*/
+RANDOMDEF void xoshiro256_jump(Xoshiro256 *rng);
+/*
+    Avanza di 2^192 passi: genera fino a 2^64 gruppi di stream (es. uno per processo)
+*/
+RANDOMDEF void xoshiro256_long_jump(Xoshiro256 *rng);
+/*
+    Intero uniforme in [0, range) senza bias, con il metodo di Lemire
+    (una moltiplicazione, una divisione solo nel caso raro di rifiuto)
+    @note range = 0 restituisce 64 bit casuali
+*/
+RANDOMDEF uint64_t xoshiro256_bounded(Xoshiro256 *rng, uint64_t range);
+/*
+    @return double uniforme in [0, 1) con 52 bit casuali
+*/
+RANDOMDEF double xoshiro256_double(Xoshiro256 *rng);
+
+/*
+    Crea uno stato PCG64
+    @param seed stato iniziale
+    @param stream selettore dello stream: stream diversi generano sequenze indipendenti
+*/
+RANDOMDEF Pcg64 pcg64_seed(uint64_t seed, uint64_t stream);
+RANDOMDEF uint64_t pcg64_next(Pcg64 *rng);
+/*
+    Avanza lo stato di delta passi in O(log delta)
+*/
+RANDOMDEF void pcg64_advance(Pcg64 *rng, __uint128_t delta);
+/*
+    Avanza di 2^64 passi
+*/
+RANDOMDEF void pcg64_jump(Pcg64 *rng);
+/*
+    Avanza di 2^96 passi
+*/
+RANDOMDEF void pcg64_long_jump(Pcg64 *rng);
+RANDOMDEF uint64_t pcg64_bounded(Pcg64 *rng, uint64_t range);
+RANDOMDEF double pcg64_double(Pcg64 *rng);
+
+/*
+    Numero di stati xoshiro256++ indipendenti avanzati insieme dai generatori bulk:
+    ogni stato occupa una lane di un vettore SIMD, quindi il compilatore esegue
+    un passo di tutti gli stati con poche istruzioni vettoriali
+*/
+#ifndef RANDOM_BULK_LANES
+#define RANDOM_BULK_LANES 8
+#endif // RANDOM_BULK_LANES
+
+typedef uint64_t random_u64_lanes __attribute__((vector_size(RANDOM_BULK_LANES*sizeof(uint64_t))));
+
+/*
+    RANDOM_BULK_LANES stati xoshiro256++ interleaved (struttura di array)
+*/
+typedef struct {
+    random_u64_lanes s[4];
+} Xoshiro256_Bulk;
+
+/*
+    Crea uno stato bulk con RANDOM_BULK_LANES stati inizializzati da rng
+*/
+RANDOMDEF Xoshiro256_Bulk xoshiro256_bulk_seed(Xoshiro256 *rng);
+
+/*
+    Riempie out con n interi a 64 bit uniformi
+*/
+RANDOMDEF void xoshiro256_bulk_fill(Xoshiro256_Bulk *rng, uint64_t *out, size_t n);
+
+/*
+    Riempie un buffer (del chiamante o di un arena) di numeri casuali uniformi,
+    usando lo stato bulk del thread chiamante
+    @param out buffer di n elementi
+    @param min_val valore minimo (incluso)
+    @param max_val valore massimo (escluso per i reali, incluso per gli interi, >= min_val)
+*/
+RANDOMDEF void random_fill_u64(uint64_t *out, size_t n);
+RANDOMDEF void random_fill_f64(double *out, size_t n, double min_val, double max_val);
+RANDOMDEF void random_fill_f32(float *out, size_t n, float min_val, float max_val);
+RANDOMDEF void random_fill_i32(int32_t *out, size_t n, int32_t min_val, int32_t max_val);
+
+/*
+    Generatore counter-based Philox4x32-10: l'uscita è una funzione pura di (seed, stream, indice),
+    quindi l'elemento i di uno stream si può calcolare direttamente, in qualsiasi ordine,
+    da qualsiasi thread o processo, ottenendo sempre gli stessi bit.
+    Ogni blocco Philox produce 128 bit: gli elementi a 64 bit 2*c e 2*c+1 vengono dal contatore c.
+*/
+
+/*
+    Un blocco Philox4x32-10
+    @param ctr contatore a 128 bit
+    @param key chiave a 64 bit
+    @param out 128 bit di uscita
+*/
+RANDOMDEF void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]);
+
+/*
+    @return elemento index dello stream (seed, stream)
+*/
+RANDOMDEF uint64_t philox_u64(uint64_t seed, uint64_t stream, uint64_t index);
+
+/*
+    Scrive in out gli elementi first_index..first_index+n dello stream (seed, stream)
+*/
+RANDOMDEF void philox_fill_u64(uint64_t seed, uint64_t stream, uint64_t first_index, uint64_t *out, size_t n);
+
+/*
+    Come philox_fill_u64, convertiti in reali uniformi in [min_val, max_val)
+*/
+RANDOMDEF void philox_fill_f64(uint64_t seed, uint64_t stream, uint64_t first_index,
+                               double *out, size_t n, double min_val, double max_val);
+RANDOMDEF void philox_fill_f32(uint64_t seed, uint64_t stream, uint64_t first_index,
+                               float *out, size_t n, float min_val, float max_val);
+
+/*
+    Distribuzioni non uniformi con il metodo Ziggurat (256 strati): nel ~99% dei casi
+    un campione costa un intero casuale, un prodotto e un confronto, senza log o exp.
+    Le tabelle vengono calcolate alla prima chiamata.
+    @note richiede -lm
+*/
+RANDOMDEF double xoshiro256_normal(Xoshiro256 *rng);
+RANDOMDEF double xoshiro256_exponential(Xoshiro256 *rng);
+
+/*
+    distribuzione normale con il generatore del thread chiamante
+    @param mean media
+    @param stddev deviazione standard
+*/
+RANDOMDEF double normal_distribution(double mean, double stddev);
+
+/*
+    distribuzione esponenziale con il generatore del thread chiamante
+    @param lambda parametro di rate (media 1/lambda)
+*/
+RANDOMDEF double exponential_distribution(double lambda);
+
+/*
+    Riempie out con n campioni, usando lo stato bulk del thread chiamante
+*/
+RANDOMDEF void random_fill_normal(double *out, size_t n, double mean, double stddev);
+RANDOMDEF void random_fill_exponential(double *out, size_t n, double lambda);
+
+/*
+    Tabella alias (Walker/Vose) per estrarre un indice in [0, n) con probabilità
+    proporzionale ai pesi in O(1), dopo una preparazione in O(n)
+*/
+typedef struct {
+    size_t n;
+    uint64_t *threshold; // probabilità di restare nel secchio i, scalata a 2^64
+    uint32_t *alias;
+} Alias_Table;
+
+/*
+    Crea la tabella alias
+    @param weights n pesi non negativi, non tutti nulli (non serve che sommino a 1)
+    @note la tabella va liberata con alias_table_free
+*/
+RANDOMDEF Alias_Table alias_table_init(const double *weights, size_t n);
+RANDOMDEF void alias_table_free(Alias_Table *table);
+
+/*
+    @return indice estratto con un solo intero casuale
+*/
+RANDOMDEF size_t alias_table_next(const Alias_Table *table, Xoshiro256 *rng);
+
+/*
+    Come alias_table_next con il generatore del thread chiamante
+*/
+RANDOMDEF size_t alias_table_sample(const Alias_Table *table);
+
+/*
+    Riempie out con n indici estratti, usando lo stato bulk del thread chiamante
+*/
+RANDOMDEF void alias_table_fill(const Alias_Table *table, size_t *out, size_t n);
+
 /* ---------------------- IMPLEMENTATION ---------------------- */
 
+// seed globale, cambia generazione ad ogni init_random_with_seed
+SHARED_GLOBAL _Atomic uint64_t random_seed = 1;
+SHARED_GLOBAL _Atomic uint64_t random_seed_generation = 1;
+
+/*
+    Prossimo stream da dare a un thread: il seed avanzato di un xoshiro256_jump per ogni
+    thread già servito. Ogni nuovo thread lo copia e lo fa avanzare di un solo salto
+*/
+typedef struct {
+    pthread_mutex_t mutex;
+    uint64_t generation;         // generazione del seed da cui parte next
+    Xoshiro256 next;
+} Random_Streams;
+
+SHARED_GLOBAL Random_Streams random_streams = {
+    .mutex = PTHREAD_MUTEX_INITIALIZER,
+};
+
+SHARED_GLOBAL _Thread_local Xoshiro256 random_thread_state;
+SHARED_GLOBAL _Thread_local uint64_t random_thread_generation = 0;
+
+static inline uint64_t random_splitmix64(uint64_t *x) {
+    uint64_t z = (*x += 0x9e3779b97f4a7c15ull);
+    z = (z ^ (z >> 30))*0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27))*0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static inline uint64_t random_rotl(uint64_t x, int k) {
+    return (x << k) | (x >> (64 - k));
+}
+
+// 52 bit casuali nella mantissa di un double in [1, 2), poi spostato in [0, 1)
+static inline double random_bits_to_double(uint64_t x) {
+    union { uint64_t u; double d; } v = { .u = (x >> 12) | 0x3ff0000000000000ull };
+    return v.d - 1.0;
+}
+
+Xoshiro256 xoshiro256_seed(uint64_t seed) {
+    Xoshiro256 rng;
+    for (int i = 0; i < 4; i++) rng.s[i] = random_splitmix64(&seed);
+    return rng;
+}
+
+uint64_t xoshiro256_next(Xoshiro256 *rng) {
+    uint64_t *s = rng->s;
+    uint64_t result = random_rotl(s[0] + s[3], 23) + s[0];
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = random_rotl(s[3], 45);
+    return result;
+}
+
+static inline void xoshiro256_jump_by(Xoshiro256 *rng, const uint64_t poly[4]) {
+    uint64_t s[4] = {0};
+    for (int i = 0; i < 4; i++) {
+        for (int b = 0; b < 64; b++) {
+            if (poly[i] & (1ull << b)) {
+                for (int k = 0; k < 4; k++) s[k] ^= rng->s[k];
+            }
+            xoshiro256_next(rng);
+        }
+    }
+    memcpy(rng->s, s, sizeof(s));
+}
+
+void xoshiro256_jump(Xoshiro256 *rng) {
+    static const uint64_t JUMP[4] = {
+        0x180ec6d33cfd0aba, 0xd5a61266f0c9392c, 0xa9582618e03fc9aa, 0x39abdc4529b1661c
+    };
+    xoshiro256_jump_by(rng, JUMP);
+}
+
+void xoshiro256_long_jump(Xoshiro256 *rng) {
+    static const uint64_t LONG_JUMP[4] = {
+        0x76e15d3efefdcbbf, 0xc5004e441c522fb3, 0x77710069854ee241, 0x39109bb02acbe635
+    };
+    xoshiro256_jump_by(rng, LONG_JUMP);
+}
+
+/*
+    Metodo di Lemire: il prodotto a 128 bit x*range ha nella parte alta un valore in [0, range);
+    si rifiuta solo quando la parte bassa cade nei 2^64 mod range valori che creerebbero bias
+*/
+#define RANDOM_LEMIRE_BOUNDED(next_expr, range)                          \
+    do {                                                                 \
+        if ((range) == 0) return (next_expr);                            \
+        __uint128_t m = (__uint128_t)(next_expr)*(range);                \
+        uint64_t l = (uint64_t)m;                                        \
+        if (l < (range)) {                                               \
+            uint64_t threshold = -(range) % (range);                     \
+            while (l < threshold) {                                      \
+                m = (__uint128_t)(next_expr)*(range);                    \
+                l = (uint64_t)m;                                         \
+            }                                                            \
+        }                                                                \
+        return (uint64_t)(m >> 64);                                      \
+    } while (0)
+
+uint64_t xoshiro256_bounded(Xoshiro256 *rng, uint64_t range) {
+    RANDOM_LEMIRE_BOUNDED(xoshiro256_next(rng), range);
+}
+
+double xoshiro256_double(Xoshiro256 *rng) {
+    return random_bits_to_double(xoshiro256_next(rng));
+}
+
+#define PCG64_MULTIPLIER (((__uint128_t)2549297995355413924ull << 64) + 4865540595714422341ull)
+
+Pcg64 pcg64_seed(uint64_t seed, uint64_t stream) {
+    Pcg64 rng = {
+        .state = 0,
+        .inc = ((__uint128_t)stream << 1) | 1,
+    };
+    pcg64_next(&rng);
+    rng.state += seed;
+    pcg64_next(&rng);
+    return rng;
+}
+
+uint64_t pcg64_next(Pcg64 *rng) {
+    rng->state = rng->state*PCG64_MULTIPLIER + rng->inc;
+    uint64_t xored = (uint64_t)(rng->state >> 64) ^ (uint64_t)rng->state;
+    unsigned rot = (unsigned)(rng->state >> 122);
+    return (xored >> rot) | (xored << ((-rot) & 63));
+}
+
+void pcg64_advance(Pcg64 *rng, __uint128_t delta) {
+    // salto di un LCG in O(log delta), Brown "Random Number Generation with Arbitrary Stride"
+    __uint128_t cur_mult = PCG64_MULTIPLIER;
+    __uint128_t cur_plus = rng->inc;
+    __uint128_t acc_mult = 1;
+    __uint128_t acc_plus = 0;
+    while (delta > 0) {
+        if (delta & 1) {
+            acc_mult *= cur_mult;
+            acc_plus = acc_plus*cur_mult + cur_plus;
+        }
+        cur_plus = (cur_mult + 1)*cur_plus;
+        cur_mult *= cur_mult;
+        delta >>= 1;
+    }
+    rng->state = acc_mult*rng->state + acc_plus;
+}
+
+void pcg64_jump(Pcg64 *rng) {
+    pcg64_advance(rng, (__uint128_t)1 << 64);
+}
+
+void pcg64_long_jump(Pcg64 *rng) {
+    pcg64_advance(rng, (__uint128_t)1 << 96);
+}
+
+uint64_t pcg64_bounded(Pcg64 *rng, uint64_t range) {
+    RANDOM_LEMIRE_BOUNDED(pcg64_next(rng), range);
+}
+
+double pcg64_double(Pcg64 *rng) {
+    return random_bits_to_double(pcg64_next(rng));
+}
+
+Xoshiro256 *random_thread_rng(void) {
+    uint64_t generation = atomic_load_explicit(&random_seed_generation, memory_order_acquire);
+    if (random_thread_generation != generation) {
+        // nuovo thread o nuovo seed: il thread prende il prossimo stream libero, in O(1)
+        pthread_mutex_lock(&random_streams.mutex);
+        generation = atomic_load_explicit(&random_seed_generation, memory_order_acquire);
+        if (random_streams.generation != generation) {
+            random_streams.next = xoshiro256_seed(atomic_load_explicit(&random_seed, memory_order_relaxed));
+            random_streams.generation = generation;
+        }
+        random_thread_state = random_streams.next;
+        xoshiro256_jump(&random_streams.next);
+        pthread_mutex_unlock(&random_streams.mutex);
+        random_thread_generation = generation;
+    }
+    return &random_thread_state;
+}
+
+Xoshiro256_Bulk xoshiro256_bulk_seed(Xoshiro256 *rng) {
+    Xoshiro256_Bulk bulk;
+    for (int l = 0; l < RANDOM_BULK_LANES; l++) {
+        Xoshiro256 lane = xoshiro256_seed(xoshiro256_next(rng));
+        for (int k = 0; k < 4; k++) bulk.s[k][l] = lane.s[k];
+    }
+    return bulk;
+}
+
+// scrive il risultato tramite puntatore: restituire un vettore largo per valore
+// senza AVX-512 lo farebbe passare dalla memoria ad ogni chiamata
+__attribute__((always_inline))
+static inline void xoshiro256_bulk_next(Xoshiro256_Bulk *rng, random_u64_lanes *out) {
+    random_u64_lanes s0 = rng->s[0], s1 = rng->s[1], s2 = rng->s[2], s3 = rng->s[3];
+    random_u64_lanes sum = s0 + s3;
+    random_u64_lanes result = ((sum << 23) | (sum >> 41)) + s0;
+    random_u64_lanes t = s1 << 17;
+    s2 ^= s0;
+    s3 ^= s1;
+    s1 ^= s2;
+    s0 ^= s3;
+    s2 ^= t;
+    s3 = (s3 << 45) | (s3 >> 19);
+    rng->s[0] = s0;
+    rng->s[1] = s1;
+    rng->s[2] = s2;
+    rng->s[3] = s3;
+    *out = result;
+}
+
+void xoshiro256_bulk_fill(Xoshiro256_Bulk *rng, uint64_t *out, size_t n) {
+    size_t i = 0;
+    for (; i + RANDOM_BULK_LANES <= n; i += RANDOM_BULK_LANES) {
+        random_u64_lanes v;
+        xoshiro256_bulk_next(rng, &v);
+        memcpy(out + i, &v, sizeof(v));
+    }
+    if (i < n) {
+        random_u64_lanes v;
+        xoshiro256_bulk_next(rng, &v);
+        memcpy(out + i, &v, (n - i)*sizeof(uint64_t));
+    }
+}
+
+SHARED_GLOBAL _Thread_local Xoshiro256_Bulk random_thread_bulk;
+SHARED_GLOBAL _Thread_local uint64_t random_thread_bulk_generation = 0;
+
+static inline Xoshiro256_Bulk *random_thread_bulk_rng(void) {
+    uint64_t generation = atomic_load_explicit(&random_seed_generation, memory_order_acquire);
+    if (random_thread_bulk_generation != generation) {
+        random_thread_bulk = xoshiro256_bulk_seed(random_thread_rng());
+        random_thread_bulk_generation = generation;
+    }
+    return &random_thread_bulk;
+}
+
+// blocco di interi generati sullo stack prima della conversione, resta in L1
+#define RANDOM_FILL_BLOCK 256
+
+void random_fill_u64(uint64_t *out, size_t n) {
+    xoshiro256_bulk_fill(random_thread_bulk_rng(), out, n);
+}
+
+void random_fill_f64(double *out, size_t n, double min_val, double max_val) {
+    Xoshiro256_Bulk *rng = random_thread_bulk_rng();
+    double scale = max_val - min_val;
+    for (size_t i = 0; i < n; i += RANDOM_BULK_LANES) {
+        random_u64_lanes bits;
+        xoshiro256_bulk_next(rng, &bits);
+        // stesso trucco di random_bits_to_double, su tutte le lane insieme
+        bits = (bits >> 12) | 0x3ff0000000000000ull;
+        double values[RANDOM_BULK_LANES];
+        memcpy(values, &bits, sizeof(values));
+        size_t count = n - i < RANDOM_BULK_LANES ? n - i : RANDOM_BULK_LANES;
+        for (size_t l = 0; l < count; l++) out[i + l] = min_val + (values[l] - 1.0)*scale;
+    }
+}
+
+void random_fill_f32(float *out, size_t n, float min_val, float max_val) {
+    Xoshiro256_Bulk *rng = random_thread_bulk_rng();
+    float scale = max_val - min_val;
+    // ogni intero a 64 bit fornisce due float con 23 bit casuali ciascuno
+    for (size_t i = 0; i < n; i += 2*RANDOM_BULK_LANES) {
+        random_u64_lanes bits;
+        xoshiro256_bulk_next(rng, &bits);
+        random_u64_lanes pair = ((bits >> 41) | ((bits >> 9 & 0x7fffff) << 32)) | 0x3f8000003f800000ull;
+        float values[2*RANDOM_BULK_LANES];
+        memcpy(values, &pair, sizeof(values));
+        size_t count = n - i < 2*RANDOM_BULK_LANES ? n - i : 2*RANDOM_BULK_LANES;
+        for (size_t l = 0; l < count; l++) out[i + l] = min_val + (values[l] - 1.0f)*scale;
+    }
+}
+
+void random_fill_i32(int32_t *out, size_t n, int32_t min_val, int32_t max_val) {
+    fatal_if(max_val < min_val, "random_fill_i32: empty range [%d, %d]", min_val, max_val);
+    Xoshiro256_Bulk *rng = random_thread_bulk_rng();
+    uint64_t range = (uint64_t)((int64_t)max_val - (int64_t)min_val) + 1;
+    uint64_t threshold = -range % range;
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        xoshiro256_bulk_fill(rng, block, count);
+        for (size_t k = 0; k < count; k++) {
+            // Lemire come in xoshiro256_bounded, i rari rifiuti usano il generatore del thread
+            __uint128_t m = (__uint128_t)block[k]*range;
+            while ((uint64_t)m < threshold) m = (__uint128_t)xoshiro256_next(random_thread_rng())*range;
+            out[i + k] = (int32_t)((int64_t)min_val + (int64_t)(m >> 64));
+        }
+    }
+}
+
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+
+// contatori elaborati insieme in forma di struttura di array, il compilatore li vettorizza
+#define PHILOX_BLOCK 16
+
+void philox4x32_10(const uint32_t ctr[4], const uint32_t key[2], uint32_t out[4]) {
+    uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int round = 0; round < 10; round++) {
+        uint64_t p0 = (uint64_t)PHILOX_M0*c0;
+        uint64_t p1 = (uint64_t)PHILOX_M1*c2;
+        c0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (uint32_t)p1;
+        c2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (uint32_t)p0;
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+uint64_t philox_u64(uint64_t seed, uint64_t stream, uint64_t index) {
+    uint64_t ctr64 = index >> 1;
+    uint32_t ctr[4] = { (uint32_t)ctr64, (uint32_t)(ctr64 >> 32), (uint32_t)stream, (uint32_t)(stream >> 32) };
+    uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+    uint32_t out[4];
+    philox4x32_10(ctr, key, out);
+    return (index & 1) ? out[2] | (uint64_t)out[3] << 32 : out[0] | (uint64_t)out[1] << 32;
+}
+
+/*
+    PHILOX_BLOCK blocchi consecutivi a partire dal contatore first_ctr, 2*PHILOX_BLOCK elementi in out
+*/
+static inline void philox_block(uint64_t seed, uint64_t stream, uint64_t first_ctr, uint64_t *out) {
+    uint32_t c0[PHILOX_BLOCK], c1[PHILOX_BLOCK], c2[PHILOX_BLOCK], c3[PHILOX_BLOCK];
+    for (int l = 0; l < PHILOX_BLOCK; l++) {
+        uint64_t ctr = first_ctr + l;
+        c0[l] = (uint32_t)ctr;
+        c1[l] = (uint32_t)(ctr >> 32);
+        c2[l] = (uint32_t)stream;
+        c3[l] = (uint32_t)(stream >> 32);
+    }
+    uint32_t k0 = (uint32_t)seed, k1 = (uint32_t)(seed >> 32);
+    for (int round = 0; round < 10; round++) {
+        for (int l = 0; l < PHILOX_BLOCK; l++) {
+            uint64_t p0 = (uint64_t)PHILOX_M0*c0[l];
+            uint64_t p1 = (uint64_t)PHILOX_M1*c2[l];
+            c0[l] = (uint32_t)(p1 >> 32) ^ c1[l] ^ k0;
+            c1[l] = (uint32_t)p1;
+            c2[l] = (uint32_t)(p0 >> 32) ^ c3[l] ^ k1;
+            c3[l] = (uint32_t)p0;
+        }
+        k0 += PHILOX_W0;
+        k1 += PHILOX_W1;
+    }
+    for (int l = 0; l < PHILOX_BLOCK; l++) {
+        out[2*l] = c0[l] | (uint64_t)c1[l] << 32;
+        out[2*l + 1] = c2[l] | (uint64_t)c3[l] << 32;
+    }
+}
+
+void philox_fill_u64(uint64_t seed, uint64_t stream, uint64_t first_index, uint64_t *out, size_t n) {
+    size_t i = 0;
+    // primo elemento a metà di un blocco Philox
+    if (n > 0 && (first_index & 1)) {
+        out[i++] = philox_u64(seed, stream, first_index);
+    }
+    uint64_t block[2*PHILOX_BLOCK];
+    while (i < n) {
+        uint64_t index = first_index + i;
+        philox_block(seed, stream, index >> 1, block);
+        size_t count = n - i < 2*PHILOX_BLOCK ? n - i : 2*PHILOX_BLOCK;
+        memcpy(out + i, block, count*sizeof(*block));
+        i += count;
+    }
+}
+
+void philox_fill_f64(uint64_t seed, uint64_t stream, uint64_t first_index,
+                     double *out, size_t n, double min_val, double max_val) {
+    double scale = max_val - min_val;
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        philox_fill_u64(seed, stream, first_index + i, block, count);
+        for (size_t k = 0; k < count; k++) out[i + k] = min_val + random_bits_to_double(block[k])*scale;
+    }
+}
+
+void philox_fill_f32(uint64_t seed, uint64_t stream, uint64_t first_index,
+                     float *out, size_t n, float min_val, float max_val) {
+    float scale = max_val - min_val;
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        philox_fill_u64(seed, stream, first_index + i, block, count);
+        for (size_t k = 0; k < count; k++) {
+            union { uint32_t u; float f; } v = { .u = (uint32_t)(block[k] >> 41) | 0x3f800000u };
+            out[i + k] = min_val + (v.f - 1.0f)*scale;
+        }
+    }
+}
+
+/*
+    Strato i: rettangolo [0, x[i]) x [f[i], f[i+1]), con x[0] la base virtuale che include la coda.
+    Un punto con ascissa < x[i+1] sta sicuramente sotto la curva.
+*/
+typedef struct {
+    double x[257];
+    double f[257];
+} Random_Ziggurat;
+
+#define RANDOM_ZIG_NORMAL_R 3.6541528853610088
+#define RANDOM_ZIG_NORMAL_V 4.92867323399e-3
+#define RANDOM_ZIG_EXP_R 7.69711747013104972
+#define RANDOM_ZIG_EXP_V 3.9496598225815571993e-3
+
+SHARED_GLOBAL Random_Ziggurat random_ziggurat_normal;
+SHARED_GLOBAL Random_Ziggurat random_ziggurat_exp;
+SHARED_GLOBAL pthread_once_t random_ziggurat_once = PTHREAD_ONCE_INIT;
+
+static inline void random_ziggurat_build(void) {
+    Random_Ziggurat *z = &random_ziggurat_normal;
+    double r = RANDOM_ZIG_NORMAL_R;
+    z->x[0] = RANDOM_ZIG_NORMAL_V/exp(-0.5*r*r);
+    z->x[1] = r;
+    for (int i = 1; i < 255; i++) {
+        z->x[i + 1] = sqrt(-2.0*log(RANDOM_ZIG_NORMAL_V/z->x[i] + exp(-0.5*z->x[i]*z->x[i])));
+    }
+    z->x[256] = 0.0;
+    for (int i = 0; i < 257; i++) z->f[i] = exp(-0.5*z->x[i]*z->x[i]);
+
+    z = &random_ziggurat_exp;
+    r = RANDOM_ZIG_EXP_R;
+    z->x[0] = RANDOM_ZIG_EXP_V/exp(-r);
+    z->x[1] = r;
+    for (int i = 1; i < 255; i++) {
+        z->x[i + 1] = -log(RANDOM_ZIG_EXP_V/z->x[i] + exp(-z->x[i]));
+    }
+    z->x[256] = 0.0;
+    for (int i = 0; i < 257; i++) z->f[i] = exp(-z->x[i]);
+}
+
+static inline void random_ziggurat_init(void) {
+    pthread_once(&random_ziggurat_once, random_ziggurat_build);
+}
+
+// 8 bit bassi scelgono lo strato, il bit 8 il segno, i 53 bit alti l'ascissa
+#define RANDOM_ZIG_LAYER(u) ((int)((u) & 0xff))
+#define RANDOM_ZIG_NEGATIVE(u) ((u) & 0x100)
+#define RANDOM_ZIG_UNIFORM(u) ((double)((u) >> 11)*0x1p-53)
+
+// campione normale che parte dai bit u già estratti e rifiutati dal percorso veloce
+static inline double random_normal_slow(Xoshiro256 *rng, uint64_t u) {
+    const Random_Ziggurat *z = &random_ziggurat_normal;
+    for (;;) {
+        int i = RANDOM_ZIG_LAYER(u);
+        double x = RANDOM_ZIG_UNIFORM(u)*z->x[i];
+        double sign = RANDOM_ZIG_NEGATIVE(u) ? -1.0 : 1.0;
+        if (x < z->x[i + 1]) return sign*x;
+        if (i == 0) {
+            // coda oltre R (Marsaglia)
+            double a, b;
+            do {
+                a = -log(1.0 - xoshiro256_double(rng))/RANDOM_ZIG_NORMAL_R;
+                b = -log(1.0 - xoshiro256_double(rng));
+            } while (b + b < a*a);
+            return sign*(RANDOM_ZIG_NORMAL_R + a);
+        }
+        if (z->f[i] + xoshiro256_double(rng)*(z->f[i + 1] - z->f[i]) < exp(-0.5*x*x)) return sign*x;
+        u = xoshiro256_next(rng);
+    }
+}
+
+static inline double random_exponential_slow(Xoshiro256 *rng, uint64_t u) {
+    const Random_Ziggurat *z = &random_ziggurat_exp;
+    for (;;) {
+        int i = RANDOM_ZIG_LAYER(u);
+        double x = RANDOM_ZIG_UNIFORM(u)*z->x[i];
+        if (x < z->x[i + 1]) return x;
+        // la coda di un'esponenziale è un'esponenziale traslata
+        if (i == 0) return RANDOM_ZIG_EXP_R - log(1.0 - xoshiro256_double(rng));
+        if (z->f[i] + xoshiro256_double(rng)*(z->f[i + 1] - z->f[i]) < exp(-x)) return x;
+        u = xoshiro256_next(rng);
+    }
+}
+
+double xoshiro256_normal(Xoshiro256 *rng) {
+    random_ziggurat_init();
+    return random_normal_slow(rng, xoshiro256_next(rng));
+}
+
+double xoshiro256_exponential(Xoshiro256 *rng) {
+    random_ziggurat_init();
+    return random_exponential_slow(rng, xoshiro256_next(rng));
+}
+
+double normal_distribution(double mean, double stddev) {
+    return mean + stddev*xoshiro256_normal(random_thread_rng());
+}
+
+double exponential_distribution(double lambda) {
+    return xoshiro256_exponential(random_thread_rng())/lambda;
+}
+
+void random_fill_normal(double *out, size_t n, double mean, double stddev) {
+    random_ziggurat_init();
+    const Random_Ziggurat *z = &random_ziggurat_normal;
+    Xoshiro256_Bulk *bulk = random_thread_bulk_rng();
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        xoshiro256_bulk_fill(bulk, block, count);
+        for (size_t k = 0; k < count; k++) {
+            uint64_t u = block[k];
+            int layer = RANDOM_ZIG_LAYER(u);
+            double x = RANDOM_ZIG_UNIFORM(u)*z->x[layer];
+            if (x < z->x[layer + 1]) {
+                x = RANDOM_ZIG_NEGATIVE(u) ? -x : x;
+            } else {
+                x = random_normal_slow(random_thread_rng(), u);
+            }
+            out[i + k] = mean + stddev*x;
+        }
+    }
+}
+
+void random_fill_exponential(double *out, size_t n, double lambda) {
+    random_ziggurat_init();
+    const Random_Ziggurat *z = &random_ziggurat_exp;
+    Xoshiro256_Bulk *bulk = random_thread_bulk_rng();
+    double scale = 1.0/lambda;
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        xoshiro256_bulk_fill(bulk, block, count);
+        for (size_t k = 0; k < count; k++) {
+            uint64_t u = block[k];
+            int layer = RANDOM_ZIG_LAYER(u);
+            double x = RANDOM_ZIG_UNIFORM(u)*z->x[layer];
+            if (x >= z->x[layer + 1]) x = random_exponential_slow(random_thread_rng(), u);
+            out[i + k] = x*scale;
+        }
+    }
+}
+
+Alias_Table alias_table_init(const double *weights, size_t n) {
+    fatal_if(n == 0 || n > UINT32_MAX, "alias_table_init: invalid number of weights %zu", n);
+    double sum = 0.0;
+    for (size_t i = 0; i < n; i++) {
+        fatal_if(!(weights[i] >= 0.0), "alias_table_init: weight %zu is negative or NaN", i);
+        sum += weights[i];
+    }
+    fatal_if(!(sum > 0.0) || isinf(sum), "alias_table_init: the weights must have a finite positive sum");
+
+    Alias_Table table = {
+        .n = n,
+        .threshold = (uint64_t*)malloc(n*sizeof(uint64_t)),
+        .alias = (uint32_t*)malloc(n*sizeof(uint32_t)),
+    };
+    double *prob = (double*)malloc(n*sizeof(double));
+    // piccoli dall'inizio, grandi dalla fine dello stesso buffer
+    uint32_t *work = (uint32_t*)malloc(n*sizeof(uint32_t));
+    fatal_if(table.threshold == NULL || table.alias == NULL || prob == NULL || work == NULL, MSG_ERR_FULL_MEMORY);
+
+    size_t n_small = 0, large_begin = n;
+    for (size_t i = 0; i < n; i++) {
+        prob[i] = weights[i]*(double)n/sum;
+        if (prob[i] < 1.0) work[n_small++] = (uint32_t)i;
+        else work[--large_begin] = (uint32_t)i;
+    }
+
+    // Vose: ogni secchio piccolo viene completato da uno grande, che perde la parte ceduta
+    while (n_small > 0 && large_begin < n) {
+        uint32_t small = work[--n_small];
+        uint32_t large = work[large_begin];
+        table.threshold[small] = prob[small] >= 1.0 ? UINT64_MAX : (uint64_t)ldexp(prob[small], 64);
+        table.alias[small] = large;
+        prob[large] = (prob[large] + prob[small]) - 1.0;
+        if (prob[large] < 1.0) {
+            large_begin++;
+            work[n_small++] = large;
+        }
+    }
+    // per errori di arrotondamento i rimasti valgono 1 a meno di epsilon
+    while (n_small > 0) {
+        uint32_t i = work[--n_small];
+        table.threshold[i] = UINT64_MAX;
+        table.alias[i] = i;
+    }
+    for (size_t k = large_begin; k < n; k++) {
+        table.threshold[work[k]] = UINT64_MAX;
+        table.alias[work[k]] = work[k];
+    }
+
+    free(prob);
+    free(work);
+    return table;
+}
+
+void alias_table_free(Alias_Table *table) {
+    free(table->threshold);
+    free(table->alias);
+    table->threshold = NULL;
+    table->alias = NULL;
+    table->n = 0;
+}
+
+/*
+    Parte alta di u*n: il secchio; parte bassa: un uniforme in [0, 2^64) per scegliere
+    tra il secchio e il suo alias (bias al più n/2^64)
+*/
+static inline size_t alias_table_pick(const Alias_Table *table, uint64_t u) {
+    __uint128_t m = (__uint128_t)u*table->n;
+    size_t i = (size_t)(m >> 64);
+    return (uint64_t)m < table->threshold[i] ? i : table->alias[i];
+}
+
+size_t alias_table_next(const Alias_Table *table, Xoshiro256 *rng) {
+    return alias_table_pick(table, xoshiro256_next(rng));
+}
+
+size_t alias_table_sample(const Alias_Table *table) {
+    return alias_table_pick(table, xoshiro256_next(random_thread_rng()));
+}
+
+void alias_table_fill(const Alias_Table *table, size_t *out, size_t n) {
+    Xoshiro256_Bulk *bulk = random_thread_bulk_rng();
+    uint64_t block[RANDOM_FILL_BLOCK];
+    for (size_t i = 0; i < n; i += RANDOM_FILL_BLOCK) {
+        size_t count = n - i < RANDOM_FILL_BLOCK ? n - i : RANDOM_FILL_BLOCK;
+        xoshiro256_bulk_fill(bulk, block, count);
+        for (size_t k = 0; k < count; k++) out[i + k] = alias_table_pick(table, block[k]);
+    }
+}
+
+void init_random_with_seed(uint64_t seed) {
+    atomic_store_explicit(&random_seed, seed, memory_order_relaxed);
+    atomic_fetch_add_explicit(&random_seed_generation, 1, memory_order_release);
+    srand(seed);
+}
+
 unsigned int init_random(void) {
 
     int fd = open("/dev/urandom", O_RDONLY);
@@ -53,20 +907,21 @@ unsigned int init_random(void) {
         log_fatal("syscall error: %s", strerror(errno));
     }
     log_info("Seed = %u", seed);
-    srand(seed);
+    init_random_with_seed(seed);
     return seed;
 }
 
 int uniform_int_distribution(int min, int max) {
-    return min + rand() % (max - min + 1);
+    uint64_t range = (uint64_t)((int64_t)max - (int64_t)min) + 1;
+    return (int)((int64_t)min + (int64_t)xoshiro256_bounded(random_thread_rng(), range));
 }
 
 double uniform_real_distribution(double min, double max) {
-    return min + (double)rand() / RAND_MAX * (max - min);
+    return min + xoshiro256_double(random_thread_rng())*(max - min);
 }
 
 double random_01(void) {
-    return (double)rand() / RAND_MAX;
+    return xoshiro256_double(random_thread_rng());
 }
 
-#endif // RANDOM_H_
\ No newline at end of file
+#endif // RANDOM_H_
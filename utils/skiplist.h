@@ -0,0 +1,324 @@
+#ifndef SKIPLIST_H_
+#define SKIPLIST_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdatomic.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "random.h"
+#include "epoch.h"
+
+#ifndef SKIPLISTDEF
+#define SKIPLISTDEF static inline
+#endif // SKIPLISTDEF
+
+/*
+    Insieme ordinato concorrente: skip list lock-free (Herlihy-Shavit), alternativa
+    a list.h quando più thread leggono e scrivono insieme.
+
+    I puntatori di ogni livello sono collegati con CAS; il bit basso del puntatore next
+    di un nodo indica che il nodo è stato rimosso a quel livello. Una rimozione marca
+    prima i livelli alti e poi il livello 0, che la rende visibile (linearizzazione);
+    i nodi marcati vengono scollegati da chiunque li incontri durante una ricerca.
+
+    skiplist_is_member non scrive mai e non ricomincia mai da capo (wait-free);
+    insert e delete sono lock-free, O(log n) attesi.
+
+    La memoria dei nodi rimossi (e i loro dati) viene liberata con epoch.h: un nodo
+    viene liberato solo dopo che tutti i thread che potevano vederlo hanno finito
+    la loro operazione.
+*/
+
+// livelli massimi: con p = 1/2 bastano per 2^24 elementi senza degradare
+#ifndef SKIPLIST_MAX_LEVEL
+#define SKIPLIST_MAX_LEVEL 24
+#endif // SKIPLIST_MAX_LEVEL
+
+typedef struct Skiplist_Node Skiplist_Node;
+
+struct Skiplist_Node {
+    void *data_p;
+    _Atomic int pending;         // insert e delete ancora da concludere, vedi skiplist_release
+    int top_level;               // livelli 0..top_level-1
+    _Atomic uintptr_t next[];    // bit 0 = nodo rimosso a quel livello
+};
+
+typedef struct {
+    Skiplist_Node *head;         // sentinella con SKIPLIST_MAX_LEVEL livelli
+    _Atomic size_t length;
+    int(*compare)(void*,void*);
+} Skiplist;
+
+/*
+    Creazione dell'insieme partendo dalla funzione di comparazione tra elementi
+    @param compare stessa convenzione di list_init (es. LIST_CMP_INT)
+*/
+SKIPLISTDEF Skiplist skiplist_init(int(*compare)(void*,void*));
+/*
+    Dealloca i nodi e gli elementi ancora presenti
+    @note nessun altro thread deve usare l'insieme durante la chiamata
+*/
+SKIPLISTDEF void skiplist_deinit(Skiplist *_this);
+/*
+    Controlla se un elemento si trova nell'insieme
+    @note wait-free, O(log n) attesi
+*/
+SKIPLISTDEF bool skiplist_is_member(Skiplist *_this, void *value);
+/*
+    Inserisci un elemento nell'insieme
+    @param value puntatore allocato nella heap, l'insieme lo dealloca alla rimozione
+    @return false se l'elemento era già presente (value resta del chiamante)
+    @note lock-free, O(log n) attesi
+*/
+SKIPLISTDEF bool skiplist_insert(Skiplist *_this, void *value);
+/*
+    Elimina un elemento dall'insieme
+    @return false se l'elemento non era presente
+    @note lock-free, O(log n) attesi
+*/
+SKIPLISTDEF bool skiplist_delete(Skiplist *_this, void *value);
+/*
+    @return numero di elementi (approssimato se altri thread stanno modificando l'insieme)
+*/
+SKIPLISTDEF size_t skiplist_length(Skiplist *_this);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+#define SKIPLIST_MARK ((uintptr_t)1)
+
+#define skiplist_ptr(p) ((Skiplist_Node*)((p) & ~SKIPLIST_MARK))
+#define skiplist_marked(p) (((p) & SKIPLIST_MARK) != 0)
+
+static inline void skiplist_free_node(void *arg) {
+    Skiplist_Node *node = (Skiplist_Node*)arg;
+    free(node->data_p);
+    free(node);
+}
+
+static inline Skiplist_Node *skiplist_new_node(void *data_p, int top_level) {
+    Skiplist_Node *node = (Skiplist_Node*)malloc(sizeof(Skiplist_Node) + top_level*sizeof(_Atomic uintptr_t));
+    fatal_if(node == NULL, MSG_ERR_FULL_MEMORY);
+    node->data_p = data_p;
+    atomic_init(&node->pending, 2);
+    node->top_level = top_level;
+    for(int i = 0; i < top_level; i++) atomic_init(&node->next[i], 0);
+    return node;
+}
+
+// livello geometrico con p = 1/2
+static inline int skiplist_random_level(void) {
+    uint64_t bits = xoshiro256_next(random_thread_rng()) | (1ull << (SKIPLIST_MAX_LEVEL - 1));
+    return __builtin_ctzll(bits) + 1;
+}
+
+/*
+    Cerca la posizione di value in ogni livello, scollegando i nodi marcati che incontra
+    @param preds ultimo nodo minore di value per ogni livello
+    @param succs primo nodo maggiore o uguale a value per ogni livello (NULL = fine)
+    @return true se succs[0] contiene value
+*/
+static inline bool skiplist_find(Skiplist *_this, void *value, Skiplist_Node **preds, Skiplist_Node **succs) {
+retry:;
+    Skiplist_Node *pred = _this->head;
+    Skiplist_Node *curr = NULL;
+    for(int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        curr = skiplist_ptr(atomic_load_explicit(&pred->next[level], memory_order_acquire));
+        while(curr != NULL) {
+            uintptr_t succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+            while(skiplist_marked(succ)) {
+                uintptr_t expected = (uintptr_t)curr;
+                if(!atomic_compare_exchange_strong_explicit(&pred->next[level], &expected, succ & ~SKIPLIST_MARK,
+                                                            memory_order_acq_rel, memory_order_acquire)) {
+                    // pred è stato rimosso o modificato nel frattempo
+                    goto retry;
+                }
+                curr = skiplist_ptr(succ);
+                if(curr == NULL) break;
+                succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+            }
+            if(curr == NULL || _this->compare(curr->data_p, value) >= 0) break;
+            pred = curr;
+            curr = skiplist_ptr(succ);
+        }
+        preds[level] = pred;
+        succs[level] = curr;
+    }
+    return curr != NULL && _this->compare(curr->data_p, value) == 0;
+}
+
+/*
+    Scollega node (già marcato su tutti i livelli collegati) da ogni livello.
+    Cercarne la chiave non basta: un insert concorrente della stessa chiave può essersi
+    collegato davanti a node in un livello alto, e la ricerca si fermerebbe al nuovo nodo.
+    Per questo su ogni livello si va avanti anche oltre i nodi con chiave uguale,
+    fino alla prima chiave maggiore.
+*/
+static inline void skiplist_unlink(Skiplist *_this, Skiplist_Node *node) {
+retry:;
+    Skiplist_Node *pred = _this->head;   // ultimo nodo con chiave minore, da cui scendere
+    for(int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        Skiplist_Node *prev = pred;
+        Skiplist_Node *curr = skiplist_ptr(atomic_load_explicit(&pred->next[level], memory_order_acquire));
+        while(curr != NULL) {
+            uintptr_t succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+            if(skiplist_marked(succ)) {
+                uintptr_t expected = (uintptr_t)curr;
+                if(!atomic_compare_exchange_strong_explicit(&prev->next[level], &expected, succ & ~SKIPLIST_MARK,
+                                                            memory_order_acq_rel, memory_order_acquire)) {
+                    goto retry;
+                }
+                curr = skiplist_ptr(succ);
+                continue;
+            }
+            int cmp = _this->compare(curr->data_p, node->data_p);
+            if(cmp > 0) break;
+            if(cmp < 0) pred = curr;
+            prev = curr;
+            curr = skiplist_ptr(succ);
+        }
+    }
+}
+
+/*
+    Il nodo viene liberato quando sia l'insert (che potrebbe ancora collegare i livelli alti)
+    sia la delete hanno finito: chi arriva per ultimo lo scollega da tutti i livelli e lo
+    manda in limbo
+*/
+static inline void skiplist_release(Skiplist *_this, Skiplist_Node *node) {
+    if(atomic_fetch_sub_explicit(&node->pending, 1, memory_order_acq_rel) != 1) return;
+    skiplist_unlink(_this, node);
+    epoch_retire(node, skiplist_free_node);
+}
+
+Skiplist skiplist_init(int(*compare)(void*,void*)) {
+    Skiplist _this = {0};
+    _this.compare = compare;
+    _this.head = skiplist_new_node(NULL, SKIPLIST_MAX_LEVEL);
+    return _this;
+}
+
+void skiplist_deinit(Skiplist *_this) {
+    uintptr_t curr = atomic_load(&_this->head->next[0]);
+    while(skiplist_ptr(curr) != NULL) {
+        Skiplist_Node *node = skiplist_ptr(curr);
+        curr = atomic_load(&node->next[0]);
+        skiplist_free_node(node);
+    }
+    free(_this->head);
+    _this->head = NULL;
+    atomic_store(&_this->length, 0);
+}
+
+bool skiplist_is_member(Skiplist *_this, void *value) {
+    epoch_enter();
+    Skiplist_Node *pred = _this->head;
+    Skiplist_Node *curr = NULL;
+    for(int level = SKIPLIST_MAX_LEVEL - 1; level >= 0; level--) {
+        curr = skiplist_ptr(atomic_load_explicit(&pred->next[level], memory_order_acquire));
+        while(curr != NULL) {
+            uintptr_t succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+            // salta i nodi rimossi senza scollegarli
+            while(skiplist_marked(succ)) {
+                curr = skiplist_ptr(succ);
+                if(curr == NULL) break;
+                succ = atomic_load_explicit(&curr->next[level], memory_order_acquire);
+            }
+            if(curr == NULL || _this->compare(curr->data_p, value) >= 0) break;
+            pred = curr;
+            curr = skiplist_ptr(succ);
+        }
+    }
+    bool result = curr != NULL && _this->compare(curr->data_p, value) == 0;
+    epoch_exit();
+    return result;
+}
+
+bool skiplist_insert(Skiplist *_this, void *value) {
+    bool result;
+    epoch_enter();
+    Skiplist_Node *preds[SKIPLIST_MAX_LEVEL];
+    Skiplist_Node *succs[SKIPLIST_MAX_LEVEL];
+    Skiplist_Node *node = NULL;
+
+    for(;;) {
+        if(skiplist_find(_this, value, preds, succs)) {
+            free(node);
+            return_defer(false);
+        }
+        if(node == NULL) node = skiplist_new_node(value, skiplist_random_level());
+        for(int level = 0; level < node->top_level; level++) {
+            atomic_store_explicit(&node->next[level], (uintptr_t)succs[level], memory_order_relaxed);
+        }
+        // il collegamento al livello 0 rende il nodo parte dell'insieme
+        uintptr_t expected = (uintptr_t)succs[0];
+        if(atomic_compare_exchange_strong_explicit(&preds[0]->next[0], &expected, (uintptr_t)node,
+                                                   memory_order_release, memory_order_relaxed)) break;
+    }
+    atomic_fetch_add_explicit(&_this->length, 1, memory_order_relaxed);
+
+    for(int level = 1; level < node->top_level; level++) {
+        for(;;) {
+            uintptr_t old = atomic_load_explicit(&node->next[level], memory_order_acquire);
+            // una delete concorrente ha marcato il nodo: i livelli alti non servono più
+            if(skiplist_marked(old)) goto built;
+            if(old != (uintptr_t)succs[level] &&
+               !atomic_compare_exchange_strong_explicit(&node->next[level], &old, (uintptr_t)succs[level],
+                                                        memory_order_release, memory_order_relaxed)) {
+                goto built;
+            }
+            uintptr_t expected = (uintptr_t)succs[level];
+            if(atomic_compare_exchange_strong_explicit(&preds[level]->next[level], &expected, (uintptr_t)node,
+                                                       memory_order_release, memory_order_relaxed)) break;
+            // predecessore cambiato: ricalcola la posizione
+            if(!skiplist_find(_this, value, preds, succs) || succs[0] != node) goto built;
+        }
+    }
+built:
+    skiplist_release(_this, node);
+    result = true;
+defer:
+    epoch_exit();
+    return result;
+}
+
+bool skiplist_delete(Skiplist *_this, void *value) {
+    bool result;
+    epoch_enter();
+    Skiplist_Node *preds[SKIPLIST_MAX_LEVEL];
+    Skiplist_Node *succs[SKIPLIST_MAX_LEVEL];
+
+    if(!skiplist_find(_this, value, preds, succs)) return_defer(false);
+    Skiplist_Node *victim = succs[0];
+
+    for(int level = victim->top_level - 1; level >= 1; level--) {
+        uintptr_t succ = atomic_load_explicit(&victim->next[level], memory_order_acquire);
+        while(!skiplist_marked(succ)) {
+            atomic_compare_exchange_weak_explicit(&victim->next[level], &succ, succ | SKIPLIST_MARK,
+                                                  memory_order_acq_rel, memory_order_acquire);
+        }
+    }
+
+    // chi marca il livello 0 ha eliminato l'elemento
+    uintptr_t succ = atomic_load_explicit(&victim->next[0], memory_order_acquire);
+    for(;;) {
+        if(skiplist_marked(succ)) return_defer(false);
+        if(atomic_compare_exchange_weak_explicit(&victim->next[0], &succ, succ | SKIPLIST_MARK,
+                                                 memory_order_acq_rel, memory_order_acquire)) break;
+    }
+    atomic_fetch_sub_explicit(&_this->length, 1, memory_order_relaxed);
+    skiplist_release(_this, victim);
+    result = true;
+
+defer:
+    epoch_exit();
+    return result;
+}
+
+size_t skiplist_length(Skiplist *_this) {
+    return atomic_load_explicit(&_this->length, memory_order_relaxed);
+}
+
+#endif // SKIPLIST_H_
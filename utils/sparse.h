@@ -0,0 +1,484 @@
+#ifndef SPARSE_H_
+#define SPARSE_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+
+#include <string.h>
+
+#include "macros.h"
+#include "logging.h"
+#include "matrix.h"
+
+#ifndef SPARSEDEF
+#define SPARSEDEF static inline
+#endif // SPARSEDEF
+
+/*
+    Tipo degli indici di riga/colonna salvati per ogni elemento non nullo.
+    32 bit dimezzano la memoria letta rispetto a size_t; definire SPARSE_INDEX_T
+    prima dell'include se le dimensioni della matrice superano UINT32_MAX
+*/
+#ifndef SPARSE_INDEX_T
+#define SPARSE_INDEX_T uint32_t
+#endif // SPARSE_INDEX_T
+
+typedef SPARSE_INDEX_T sparse_index_t;
+
+/*
+    Matrice sparsa in formato coordinate (COO): lista di triple (riga, colonna, valore)
+    in ordine qualsiasi, eventualmente ripetute. Serve per costruire le matrici
+    prima di convertirle in CSR o CSC.
+*/
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t length;
+    size_t capacity;
+    sparse_index_t *row_idx;
+    sparse_index_t *col_idx;
+    double *values;
+} Coo_Matrix;
+
+/*
+    Matrice sparsa in formato Compressed Sparse Row:
+    gli elementi della riga i sono in col_idx/values da row_ptr[i] a row_ptr[i+1],
+    ordinati per colonna e senza duplicati
+*/
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t nnz;
+    size_t *row_ptr; // rows + 1 elementi
+    sparse_index_t *col_idx;
+    double *values;
+} Csr_Matrix;
+
+/*
+    Matrice sparsa in formato Compressed Sparse Column:
+    gli elementi della colonna j sono in row_idx/values da col_ptr[j] a col_ptr[j+1],
+    ordinati per riga e senza duplicati
+*/
+typedef struct {
+    size_t rows;
+    size_t cols;
+    size_t nnz;
+    size_t *col_ptr; // cols + 1 elementi
+    sparse_index_t *row_idx;
+    double *values;
+} Csc_Matrix;
+
+/*
+    Crea una matrice COO vuota di dimensione rows x cols
+*/
+SPARSEDEF Coo_Matrix coo_init(size_t rows, size_t cols);
+
+/*
+    Aggiunge l'elemento (row, col) = value. Gli elementi ripetuti vengono sommati
+    durante la conversione.
+*/
+SPARSEDEF void coo_push(Coo_Matrix *coo, size_t row, size_t col, double value);
+
+/*
+    Ordina gli elementi per (riga, colonna) e somma quelli con le stesse coordinate
+    @note O(nnz + rows + cols), usa due counting sort stabili
+*/
+SPARSEDEF void coo_compress(Coo_Matrix *coo);
+
+SPARSEDEF void coo_free(Coo_Matrix *coo);
+
+/*
+    Converte una matrice COO in CSR, sommando gli elementi ripetuti
+    @note coo non viene modificata
+*/
+SPARSEDEF Csr_Matrix csr_from_coo(Coo_Matrix *coo);
+
+/*
+    Crea una matrice CSR con gli elementi non nulli di una matrice densa row-major
+*/
+SPARSEDEF Csr_Matrix csr_from_dense(double *mtx, size_t rows, size_t cols);
+
+/*
+    Converte una matrice CSR in CSC
+    @note O(nnz + rows + cols)
+*/
+SPARSEDEF Csc_Matrix csc_from_csr(Csr_Matrix *csr);
+
+/*
+    Converte una matrice CSC in CSR
+*/
+SPARSEDEF Csr_Matrix csr_from_csc(Csc_Matrix *csc);
+
+/*
+    Calcola la trasposta di una matrice CSR
+    @note O(nnz + rows + cols)
+*/
+SPARSEDEF Csr_Matrix csr_transpose(Csr_Matrix *csr);
+
+/*
+    Prodotto matrice sparsa per vettore: y = A*x
+    @param a matrice sparsa rows x cols
+    @param x vettore di lunghezza a->cols
+    @param y vettore di lunghezza a->rows dove viene scritto il risultato
+    @param n_threads numero di thread tra cui vengono divise le righe (0 o 1 = sequenziale)
+*/
+SPARSEDEF void csr_spmv(Csr_Matrix *a, double *x, double *y, size_t n_threads);
+
+/*
+    Prodotto matrice sparsa per matrice densa: C = A*B
+    @param a matrice sparsa rows x cols
+    @param b matrice densa row-major a->cols x b_cols
+    @param b_cols numero di colonne di b
+    @param c matrice densa row-major a->rows x b_cols dove viene scritto il risultato
+    @param n_threads numero di thread tra cui vengono divise le righe di A,
+    bilanciate per numero di elementi non nulli (0 o 1 = sequenziale)
+*/
+SPARSEDEF void csr_spmm(Csr_Matrix *a, double *b, size_t b_cols, double *c, size_t n_threads);
+
+SPARSEDEF void csr_free(Csr_Matrix *csr);
+SPARSEDEF void csc_free(Csc_Matrix *csc);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+static inline void *sparse_alloc(size_t count, size_t size) {
+    void *result = malloc(count*size > 0 ? count*size : 1);
+    fatal_if(result == NULL, MSG_ERR_FULL_MEMORY);
+    return result;
+}
+
+Coo_Matrix coo_init(size_t rows, size_t cols) {
+    fatal_if(rows > (sparse_index_t)-1 || cols > (sparse_index_t)-1,
+        "sparse matrix %zux%zu does not fit the index type, define SPARSE_INDEX_T", rows, cols);
+    return (Coo_Matrix) {
+        .rows = rows,
+        .cols = cols
+    };
+}
+
+void coo_push(Coo_Matrix *coo, size_t row, size_t col, double value) {
+    fatal_if(row >= coo->rows || col >= coo->cols,
+        "element (%zu, %zu) out of a %zux%zu sparse matrix", row, col, coo->rows, coo->cols);
+    if (coo->length == coo->capacity) {
+        coo->capacity = coo->capacity == 0 ? INIT_CAP : coo->capacity*2;
+        coo->row_idx = (sparse_index_t*)realloc(coo->row_idx, coo->capacity*sizeof(*coo->row_idx));
+        coo->col_idx = (sparse_index_t*)realloc(coo->col_idx, coo->capacity*sizeof(*coo->col_idx));
+        coo->values = (double*)realloc(coo->values, coo->capacity*sizeof(*coo->values));
+        fatal_if(coo->row_idx == NULL || coo->col_idx == NULL || coo->values == NULL, MSG_ERR_FULL_MEMORY);
+    }
+    coo->row_idx[coo->length] = row;
+    coo->col_idx[coo->length] = col;
+    coo->values[coo->length] = value;
+    coo->length++;
+}
+
+/*
+    Counting sort stabile di (key, other, values) secondo key.
+    @param ptr se non NULL riceve gli offset di inizio di ogni chiave (n_keys + 1 elementi)
+*/
+static inline void sparse_counting_sort(size_t n, size_t n_keys,
+                                        sparse_index_t *key, sparse_index_t *other, double *values,
+                                        sparse_index_t *key_out, sparse_index_t *other_out, double *values_out,
+                                        size_t *ptr) {
+    size_t *count = (size_t*)calloc(n_keys + 1, sizeof(*count));
+    fatal_if(count == NULL, MSG_ERR_FULL_MEMORY);
+    for (size_t i = 0; i < n; i++) count[key[i] + 1]++;
+    for (size_t k = 0; k < n_keys; k++) count[k + 1] += count[k];
+    if (ptr != NULL) memcpy(ptr, count, (n_keys + 1)*sizeof(*ptr));
+    for (size_t i = 0; i < n; i++) {
+        size_t dst = count[key[i]]++;
+        if (key_out != NULL) key_out[dst] = key[i];
+        other_out[dst] = other[i];
+        values_out[dst] = values[i];
+    }
+    free(count);
+}
+
+/*
+    Ordina gli elementi di coo per (riga, colonna) nei buffer di output
+    @param row_out può essere NULL se servono solo gli offset delle righe
+    @param row_ptr riceve gli offset di inizio di ogni riga (rows + 1 elementi)
+*/
+static inline void sparse_sort_coo(Coo_Matrix *coo, sparse_index_t *row_out, sparse_index_t *col_out,
+                                   double *values_out, size_t *row_ptr) {
+    size_t n = coo->length;
+    sparse_index_t *tmp_row = (sparse_index_t*)sparse_alloc(n, sizeof(*tmp_row));
+    sparse_index_t *tmp_col = (sparse_index_t*)sparse_alloc(n, sizeof(*tmp_col));
+    double *tmp_values = (double*)sparse_alloc(n, sizeof(*tmp_values));
+
+    // prima per colonna, poi (stabile) per riga: il risultato è ordinato per (riga, colonna)
+    sparse_counting_sort(n, coo->cols, coo->col_idx, coo->row_idx, coo->values,
+                         tmp_col, tmp_row, tmp_values, NULL);
+    sparse_counting_sort(n, coo->rows, tmp_row, tmp_col, tmp_values,
+                         row_out, col_out, values_out, row_ptr);
+
+    free(tmp_values);
+    free(tmp_col);
+    free(tmp_row);
+}
+
+/*
+    Somma gli elementi consecutivi con le stesse coordinate, aggiornando row_ptr
+    @return numero di elementi rimasti
+*/
+static inline size_t sparse_merge_duplicates(size_t rows, size_t *row_ptr, sparse_index_t *row_idx,
+                                             sparse_index_t *col_idx, double *values) {
+    size_t out = 0;
+    size_t begin = 0;
+    for (size_t i = 0; i < rows; i++) {
+        size_t end = row_ptr[i + 1];
+        for (size_t k = begin; k < end; k++) {
+            if (out > row_ptr[i] && col_idx[out - 1] == col_idx[k]) {
+                values[out - 1] += values[k];
+            } else {
+                if (row_idx != NULL) row_idx[out] = i;
+                col_idx[out] = col_idx[k];
+                values[out] = values[k];
+                out++;
+            }
+        }
+        begin = end;
+        row_ptr[i + 1] = out;
+    }
+    return out;
+}
+
+void coo_compress(Coo_Matrix *coo) {
+    size_t n = coo->length;
+    if (n == 0) return;
+    sparse_index_t *row_idx = (sparse_index_t*)sparse_alloc(coo->capacity, sizeof(*row_idx));
+    sparse_index_t *col_idx = (sparse_index_t*)sparse_alloc(coo->capacity, sizeof(*col_idx));
+    double *values = (double*)sparse_alloc(coo->capacity, sizeof(*values));
+    size_t *row_ptr = (size_t*)sparse_alloc(coo->rows + 1, sizeof(*row_ptr));
+
+    sparse_sort_coo(coo, row_idx, col_idx, values, row_ptr);
+    coo->length = sparse_merge_duplicates(coo->rows, row_ptr, row_idx, col_idx, values);
+
+    free(row_ptr);
+    free(coo->row_idx);
+    free(coo->col_idx);
+    free(coo->values);
+    coo->row_idx = row_idx;
+    coo->col_idx = col_idx;
+    coo->values = values;
+}
+
+void coo_free(Coo_Matrix *coo) {
+    free(coo->row_idx);
+    free(coo->col_idx);
+    free(coo->values);
+    *coo = (Coo_Matrix){0};
+}
+
+Csr_Matrix csr_from_coo(Coo_Matrix *coo) {
+    Csr_Matrix csr = {
+        .rows = coo->rows,
+        .cols = coo->cols,
+        .row_ptr = (size_t*)sparse_alloc(coo->rows + 1, sizeof(size_t)),
+        .col_idx = (sparse_index_t*)sparse_alloc(coo->length, sizeof(sparse_index_t)),
+        .values = (double*)sparse_alloc(coo->length, sizeof(double)),
+    };
+
+    // gli indici di riga sono già codificati in row_ptr
+    sparse_sort_coo(coo, NULL, csr.col_idx, csr.values, csr.row_ptr);
+    csr.nnz = sparse_merge_duplicates(csr.rows, csr.row_ptr, NULL, csr.col_idx, csr.values);
+
+    return csr;
+}
+
+Csr_Matrix csr_from_dense(double *mtx, size_t rows, size_t cols) {
+    size_t nnz = 0;
+    for (size_t i = 0; i < rows*cols; i++) nnz += mtx[i] != 0.0;
+
+    fatal_if(rows > (sparse_index_t)-1 || cols > (sparse_index_t)-1,
+        "sparse matrix %zux%zu does not fit the index type, define SPARSE_INDEX_T", rows, cols);
+    Csr_Matrix csr = {
+        .rows = rows,
+        .cols = cols,
+        .nnz = nnz,
+        .row_ptr = (size_t*)sparse_alloc(rows + 1, sizeof(size_t)),
+        .col_idx = (sparse_index_t*)sparse_alloc(nnz, sizeof(sparse_index_t)),
+        .values = (double*)sparse_alloc(nnz, sizeof(double)),
+    };
+    size_t k = 0;
+    csr.row_ptr[0] = 0;
+    for (size_t i = 0; i < rows; i++) {
+        for (size_t j = 0; j < cols; j++) {
+            double v = mtx[i*cols + j];
+            if (v == 0.0) continue;
+            csr.col_idx[k] = j;
+            csr.values[k] = v;
+            k++;
+        }
+        csr.row_ptr[i + 1] = k;
+    }
+    return csr;
+}
+
+/*
+    Trasposizione di una matrice compressa (CSR <-> CSC hanno la stessa struttura):
+    dato (ptr, idx, values) con n_outer liste su n_inner indici produce
+    (ptr_out, idx_out, values_out) con n_inner liste ordinate su n_outer indici
+*/
+static inline void sparse_transpose_compressed(size_t n_outer, size_t n_inner, size_t nnz,
+                                               size_t *ptr, sparse_index_t *idx, double *values,
+                                               size_t *ptr_out, sparse_index_t *idx_out, double *values_out) {
+    memset(ptr_out, 0, (n_inner + 1)*sizeof(*ptr_out));
+    for (size_t k = 0; k < nnz; k++) ptr_out[idx[k] + 1]++;
+    for (size_t j = 0; j < n_inner; j++) ptr_out[j + 1] += ptr_out[j];
+
+    size_t *next = (size_t*)sparse_alloc(n_inner + 1, sizeof(*next));
+    memcpy(next, ptr_out, (n_inner + 1)*sizeof(*next));
+    // scorrendo le liste in ordine, gli indici in uscita restano ordinati
+    for (size_t i = 0; i < n_outer; i++) {
+        for (size_t k = ptr[i]; k < ptr[i + 1]; k++) {
+            size_t dst = next[idx[k]]++;
+            idx_out[dst] = i;
+            values_out[dst] = values[k];
+        }
+    }
+    free(next);
+}
+
+Csc_Matrix csc_from_csr(Csr_Matrix *csr) {
+    Csc_Matrix csc = {
+        .rows = csr->rows,
+        .cols = csr->cols,
+        .nnz = csr->nnz,
+        .col_ptr = (size_t*)sparse_alloc(csr->cols + 1, sizeof(size_t)),
+        .row_idx = (sparse_index_t*)sparse_alloc(csr->nnz, sizeof(sparse_index_t)),
+        .values = (double*)sparse_alloc(csr->nnz, sizeof(double)),
+    };
+    sparse_transpose_compressed(csr->rows, csr->cols, csr->nnz, csr->row_ptr, csr->col_idx, csr->values,
+                                csc.col_ptr, csc.row_idx, csc.values);
+    return csc;
+}
+
+Csr_Matrix csr_from_csc(Csc_Matrix *csc) {
+    Csr_Matrix csr = {
+        .rows = csc->rows,
+        .cols = csc->cols,
+        .nnz = csc->nnz,
+        .row_ptr = (size_t*)sparse_alloc(csc->rows + 1, sizeof(size_t)),
+        .col_idx = (sparse_index_t*)sparse_alloc(csc->nnz, sizeof(sparse_index_t)),
+        .values = (double*)sparse_alloc(csc->nnz, sizeof(double)),
+    };
+    sparse_transpose_compressed(csc->cols, csc->rows, csc->nnz, csc->col_ptr, csc->row_idx, csc->values,
+                                csr.row_ptr, csr.col_idx, csr.values);
+    return csr;
+}
+
+Csr_Matrix csr_transpose(Csr_Matrix *csr) {
+    // la CSC di A ha gli stessi array della CSR di A^T
+    Csc_Matrix csc = csc_from_csr(csr);
+    return (Csr_Matrix) {
+        .rows = csr->cols,
+        .cols = csr->rows,
+        .nnz = csc.nnz,
+        .row_ptr = csc.col_ptr,
+        .col_idx = csc.row_idx,
+        .values = csc.values,
+    };
+}
+
+typedef struct {
+    Csr_Matrix *a;
+    double *x;      // vettore per spmv, matrice densa per spmm
+    double *y;
+    size_t b_cols;
+    size_t n_chunks;
+} Sparse_Job;
+
+/*
+    Prima riga del chunk index, scelta in modo che ogni chunk abbia circa nnz/n_chunks elementi
+*/
+static inline size_t sparse_chunk_begin(Csr_Matrix *a, size_t index, size_t n_chunks) {
+    if (index == 0) return 0;
+    if (index >= n_chunks) return a->rows;
+    size_t target = a->nnz/n_chunks*index;
+    size_t lo = 0;
+    size_t hi = a->rows;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo)/2;
+        if (a->row_ptr[mid] < target) lo = mid + 1;
+        else hi = mid;
+    }
+    return lo;
+}
+
+static inline void sparse_spmv_chunk(void *ctx, size_t index) {
+    Sparse_Job *job = (Sparse_Job*)ctx;
+    Csr_Matrix *a = job->a;
+    size_t first = sparse_chunk_begin(a, index, job->n_chunks);
+    size_t last = sparse_chunk_begin(a, index + 1, job->n_chunks);
+    const size_t *restrict row_ptr = a->row_ptr;
+    const sparse_index_t *restrict col_idx = a->col_idx;
+    const double *restrict values = a->values;
+    const double *restrict x = job->x;
+
+    for (size_t i = first; i < last; i++) {
+        size_t k = row_ptr[i];
+        size_t end = row_ptr[i + 1];
+        // quattro accumulatori indipendenti per non serializzare le somme
+        double s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+        for (; k + 4 <= end; k += 4) {
+            s0 += values[k]*x[col_idx[k]];
+            s1 += values[k + 1]*x[col_idx[k + 1]];
+            s2 += values[k + 2]*x[col_idx[k + 2]];
+            s3 += values[k + 3]*x[col_idx[k + 3]];
+        }
+        for (; k < end; k++) s0 += values[k]*x[col_idx[k]];
+        job->y[i] = (s0 + s1) + (s2 + s3);
+    }
+}
+
+static inline void sparse_spmm_chunk(void *ctx, size_t index) {
+    Sparse_Job *job = (Sparse_Job*)ctx;
+    Csr_Matrix *a = job->a;
+    size_t first = sparse_chunk_begin(a, index, job->n_chunks);
+    size_t last = sparse_chunk_begin(a, index + 1, job->n_chunks);
+    size_t n = job->b_cols;
+
+    for (size_t i = first; i < last; i++) {
+        double *restrict c_row = job->y + i*n;
+        memset(c_row, 0, n*sizeof(*c_row));
+        for (size_t k = a->row_ptr[i]; k < a->row_ptr[i + 1]; k++) {
+            const double *restrict b_row = job->x + (size_t)a->col_idx[k]*n;
+            double v = a->values[k];
+            // axpy su righe contigue: viene vettorizzato dal compilatore
+            for (size_t j = 0; j < n; j++) c_row[j] += v*b_row[j];
+        }
+    }
+}
+
+static inline size_t sparse_n_chunks(Csr_Matrix *a, size_t n_threads, size_t work_per_nnz) {
+    // almeno ~64K operazioni per thread, altrimenti la creazione dei thread domina
+    size_t max_chunks = a->nnz*work_per_nnz/(64*1024) + 1;
+    if (n_threads == 0) n_threads = 1;
+    return n_threads < max_chunks ? n_threads : max_chunks;
+}
+
+void csr_spmv(Csr_Matrix *a, double *x, double *y, size_t n_threads) {
+    Sparse_Job job = { .a = a, .x = x, .y = y, .n_chunks = sparse_n_chunks(a, n_threads, 1) };
+    matrix_run_parallel(job.n_chunks, sparse_spmv_chunk, &job);
+}
+
+void csr_spmm(Csr_Matrix *a, double *b, size_t b_cols, double *c, size_t n_threads) {
+    Sparse_Job job = { .a = a, .x = b, .y = c, .b_cols = b_cols, .n_chunks = sparse_n_chunks(a, n_threads, b_cols) };
+    matrix_run_parallel(job.n_chunks, sparse_spmm_chunk, &job);
+}
+
+void csr_free(Csr_Matrix *csr) {
+    free(csr->row_ptr);
+    free(csr->col_idx);
+    free(csr->values);
+    *csr = (Csr_Matrix){0};
+}
+
+void csc_free(Csc_Matrix *csc) {
+    free(csc->col_ptr);
+    free(csc->row_idx);
+    free(csc->values);
+    *csc = (Csc_Matrix){0};
+}
+
+#endif // SPARSE_H_
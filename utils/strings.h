@@ -4,11 +4,14 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include <string.h>
 #include <ctype.h>
 #include <errno.h>
+#include <locale.h>
+#include <stdatomic.h>
 
 #include "macros.h"
 #include "logging.h"
@@ -28,6 +31,37 @@ typedef struct {
     size_t capacity;
 } String_Builder;
 
+/*
+    String_Builder con small-string optimization: fino a SSO_INLINE_CAPACITY byte
+    la stringa sta dentro la struct (24 byte) senza allocazioni, oltre passa nella heap
+    (o in un'arena, vedi arena_sso_append_sv). Il contenuto è sempre terminato da '\0'.
+
+    L'ultimo byte della struct distingue i due casi: in modalità inline contiene la
+    lunghezza, in modalità heap è un byte di capacity (il più alto su little-endian,
+    il più basso su big-endian) che ha il bit SSO_HEAP.
+    Usare sempre sso_data e sso_length invece dei campi.
+*/
+typedef union {
+    struct {
+        char *data;
+        size_t length;
+        size_t capacity; // con i bit SSO_HEAP e SSO_ARENA
+    } heap;
+    char small[sizeof(char*) + 2*sizeof(size_t)];
+} String_Sso;
+
+#define SSO_INLINE_CAPACITY (sizeof(String_Sso) - 2) // un byte per '\0' e uno per la lunghezza
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+// l'ultimo byte di capacity è quello basso: i flag stanno lì e la capacità è spostata di 8 bit
+#define SSO_CAPACITY_SHIFT 8
+#define SSO_HEAP ((size_t)0x80)
+#define SSO_ARENA ((size_t)0x40)
+#else
+#define SSO_CAPACITY_SHIFT 0
+#define SSO_HEAP ((size_t)1 << (8*sizeof(size_t) - 1))
+#define SSO_ARENA ((size_t)1 << (8*sizeof(size_t) - 2)) // memoria di un'arena, non va liberata
+#endif // __BYTE_ORDER__
+
 /*
     crea una String View partendo dai suoi componenti
 */
@@ -92,6 +126,32 @@ STRINGSDEF void sb_to_uppercase(String_Builder *sb);
 */
 STRINGSDEF void sb_to_cstr(String_Builder *sb);
 
+/*
+    crea una String_Sso che contiene una copia di sv, senza allocare se è corta
+*/
+STRINGSDEF String_Sso sso_from_sv(String_View *sv);
+STRINGSDEF String_Sso sso_from_cstr(Cstr *data);
+/*
+    crea una String_Sso vuota che può contenere capacity byte senza riallocare
+*/
+STRINGSDEF String_Sso sso_with_capacity(size_t capacity);
+/*
+    @return puntatore al contenuto, terminato da '\0' (valido fino alla prossima modifica)
+*/
+STRINGSDEF char *sso_data(String_Sso *sso);
+STRINGSDEF size_t sso_length(const String_Sso *sso);
+STRINGSDEF size_t sso_capacity(const String_Sso *sso);
+/*
+    crea una String View sul contenuto di sso
+*/
+STRINGSDEF String_View sv_from_sso(String_Sso *sso);
+STRINGSDEF void sso_append_sv(String_Sso *sso, String_View sv);
+STRINGSDEF void sso_append_cstr(String_Sso *sso, Cstr *data);
+/*
+    libera la memoria nella heap (se c'è) e svuota la stringa
+*/
+STRINGSDEF void sso_free(String_Sso *sso);
+
 /*
     Confronta due String_View
     @return valore negativo se _this < _that, zero se _this == _that, valore positivo se _this > _that 
@@ -112,8 +172,20 @@ STRINGSDEF String_View sv_chop_by_predicate(String_View *sv, bool (*predicate)(c
     @return Porzione iniziale del testo prima del delimitatore rappresentato come String_View
 */
 STRINGSDEF String_View sv_chop_by_delim(String_View *sv, char delim);
-//TODO: mettere sv_chop_by_delims(String_View *sv, Cstr *delims)
-// dove invece di confrontare solo un delimitatore, se ha molti per cui può separare
+/*
+    Come sv_chop_by_delim, ma il testo viene separato dal primo carattere
+    che compare in delims
+*/
+STRINGSDEF String_View sv_chop_by_delims(String_View *sv, Cstr *delims);
+
+/*
+    Legge un numero reale all'inizio di sv e fa avanzare sv dopo il numero.
+    Il separatore decimale è sempre '.', indipendentemente dal locale.
+    Accetta anche inf, nan e le forme esadecimali (0x1p3) come strtod nel locale "C".
+    @param out dove viene scritto il numero letto
+    @return true se all'inizio di sv c'è un numero valido, false altrimenti (sv non viene modificato)
+*/
+STRINGSDEF bool sv_chop_double(String_View *sv, double *out);
 
 STRINGSDEF void sv_trim(String_View *sv);
 
@@ -244,6 +316,102 @@ void sb_to_cstr(String_Builder *sb) {
     sb->length--;
 }
 
+_Static_assert(offsetof(String_Sso, heap.capacity) + sizeof(size_t) == sizeof(String_Sso),
+               "String_Sso: capacity must end the struct, its flag byte is the inline length byte");
+
+static inline bool sso_is_heap(const String_Sso *sso) {
+    return ((unsigned char)sso->small[sizeof(String_Sso) - 1] & 0x80) != 0;
+}
+
+char *sso_data(String_Sso *sso) {
+    return sso_is_heap(sso) ? sso->heap.data : sso->small;
+}
+
+size_t sso_length(const String_Sso *sso) {
+    return sso_is_heap(sso) ? sso->heap.length : (size_t)sso->small[sizeof(String_Sso) - 1];
+}
+
+size_t sso_capacity(const String_Sso *sso) {
+    return sso_is_heap(sso) ? (sso->heap.capacity & ~(SSO_HEAP | SSO_ARENA)) >> SSO_CAPACITY_SHIFT : SSO_INLINE_CAPACITY;
+}
+
+static inline void sso_set_length(String_Sso *sso, size_t length) {
+    if (sso_is_heap(sso)) sso->heap.length = length;
+    else sso->small[sizeof(String_Sso) - 1] = (char)length;
+    sso_data(sso)[length] = '\0';
+}
+
+// capacità per contenerne almeno needed, raddoppiando per avere append in O(1) ammortizzato
+static inline size_t sso_grown_capacity(const String_Sso *sso, size_t needed) {
+    size_t capacity = 2*sso_capacity(sso);
+    return capacity > needed ? capacity : needed;
+}
+
+/*
+    sposta il contenuto in block (capacity + 1 byte), liberando il blocco precedente
+    @param in_arena block appartiene a un'arena e non verrà liberato da sso_free
+*/
+static inline void sso_move_to(String_Sso *sso, char *block, size_t capacity, bool in_arena) {
+    size_t length = sso_length(sso);
+    memcpy(block, sso_data(sso), length + 1);
+    if (sso_is_heap(sso) && !(sso->heap.capacity & SSO_ARENA)) free(sso->heap.data);
+    sso->heap.data = block;
+    sso->heap.length = length;
+    sso->heap.capacity = capacity << SSO_CAPACITY_SHIFT | SSO_HEAP | (in_arena ? SSO_ARENA : 0);
+}
+
+static inline void sso_reserve(String_Sso *sso, size_t needed) {
+    if (needed <= sso_capacity(sso)) return;
+    size_t capacity = sso_grown_capacity(sso, needed);
+    if (sso_is_heap(sso) && !(sso->heap.capacity & SSO_ARENA)) {
+        char *data = (char*)realloc(sso->heap.data, capacity + 1);
+        fatal_if(data == NULL, MSG_ERR_FULL_MEMORY);
+        sso->heap.data = data;
+        sso->heap.capacity = capacity << SSO_CAPACITY_SHIFT | SSO_HEAP;
+        return;
+    }
+    char *block = (char*)malloc(capacity + 1);
+    fatal_if(block == NULL, MSG_ERR_FULL_MEMORY);
+    sso_move_to(sso, block, capacity, false);
+}
+
+String_Sso sso_with_capacity(size_t capacity) {
+    String_Sso sso = {0};
+    sso_reserve(&sso, capacity);
+    return sso;
+}
+
+String_Sso sso_from_sv(String_View *sv) {
+    String_Sso sso = sso_with_capacity(sv->length);
+    sso_append_sv(&sso, *sv);
+    return sso;
+}
+
+String_Sso sso_from_cstr(Cstr *data) {
+    String_View sv = sv_from_cstr(data);
+    return sso_from_sv(&sv);
+}
+
+String_View sv_from_sso(String_Sso *sso) {
+    return sv_from_parts(sso_data(sso), sso_length(sso));
+}
+
+void sso_append_sv(String_Sso *sso, String_View sv) {
+    size_t length = sso_length(sso);
+    sso_reserve(sso, length + sv.length);
+    memcpy(sso_data(sso) + length, sv.data, sv.length);
+    sso_set_length(sso, length + sv.length);
+}
+
+void sso_append_cstr(String_Sso *sso, Cstr *data) {
+    sso_append_sv(sso, sv_from_cstr(data));
+}
+
+void sso_free(String_Sso *sso) {
+    if (sso_is_heap(sso) && !(sso->heap.capacity & SSO_ARENA)) free(sso->heap.data);
+    *sso = (String_Sso){0};
+}
+
 int sv_compare(String_View _this, String_View _that) {
     if(_this.length != _that.length) return _this.length - _this.length;
     return memcmp(_this.data, _that.data, _this.length);
@@ -269,8 +437,28 @@ String_View sv_chop_by_predicate(String_View *sv, bool (*predicate)(char)) {
 }
 
 String_View sv_chop_by_delim(String_View *sv, char delim) {
+    char *end = (char*)memchr(sv->data, delim, sv->length);
+    size_t i = end != NULL ? (size_t)(end - sv->data) : sv->length;
+
+    String_View result = sv_from_parts(sv->data, i);
+
+    if (i < sv->length) {
+        sv->length -= i + 1;
+        sv->data  += i + 1;
+    } else {
+        sv->length -= i;
+        sv->data  += i;
+    }
+
+    return result;
+}
+
+String_View sv_chop_by_delims(String_View *sv, Cstr *delims) {
+    bool is_delim[256] = {0};
+    for(Cstr *it = delims; *it != '\0'; it++) is_delim[(unsigned char)*it] = true;
+
     size_t i = 0;
-    while (i < sv->length && sv->data[i] != delim) {
+    while (i < sv->length && !is_delim[(unsigned char)sv->data[i]]) {
         i += 1;
     }
 
@@ -287,6 +475,96 @@ String_View sv_chop_by_delim(String_View *sv, char delim) {
     return result;
 }
 
+// locale "C" condiviso, creato alla prima conversione che ha bisogno di strtod
+SHARED_GLOBAL _Atomic(locale_t) sv_c_locale;
+
+static inline locale_t sv_get_c_locale(void) {
+    locale_t locale = atomic_load_explicit(&sv_c_locale, memory_order_acquire);
+    if (locale != (locale_t)0) return locale;
+    locale_t created = newlocale(LC_NUMERIC_MASK, "C", (locale_t)0);
+    fatal_if(created == (locale_t)0, "could not create the C locale: %s", strerror(errno));
+    // se un altro thread l'ha già creato si usa il suo
+    if (atomic_compare_exchange_strong(&sv_c_locale, &locale, created)) return created;
+    freelocale(created);
+    return locale;
+}
+
+bool sv_chop_double(String_View *sv, double *out) {
+    // potenze di 10 rappresentabili esattamente con un double
+    static const double pow10[] = {
+        1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+    };
+    Cstr *p = sv->data;
+    Cstr *end = sv->data + sv->length;
+    bool negative = false;
+    uint64_t mantissa = 0;
+    int digits = 0;     // cifre significative accumulate in mantissa
+    int exp10 = 0;
+    bool any_digit = false;
+
+    if (p < end && (*p == '+' || *p == '-')) negative = *p++ == '-';
+    if (end - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) goto slow_path;
+    while (p < end && *p == '0') { p++; any_digit = true; }
+    for (; p < end && isdigit((unsigned char)*p); p++, any_digit = true) {
+        if (digits < 19) { mantissa = mantissa*10 + CHAR_TO_NUM(*p); digits++; }
+        else exp10++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        if (mantissa == 0) while (p < end && *p == '0') { p++; exp10--; any_digit = true; }
+        for (; p < end && isdigit((unsigned char)*p); p++, any_digit = true) {
+            if (digits < 19) { mantissa = mantissa*10 + CHAR_TO_NUM(*p); digits++; exp10--; }
+        }
+    }
+    if (!any_digit) {
+        // inf e nan vengono lasciati a strtod
+        if (p < end && (isalpha((unsigned char)*p))) goto slow_path;
+        return false;
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        Cstr *q = p + 1;
+        bool exp_negative = false;
+        int e = 0;
+        if (q < end && (*q == '+' || *q == '-')) exp_negative = *q++ == '-';
+        if (q < end && isdigit((unsigned char)*q)) {
+            for (; q < end && isdigit((unsigned char)*q); q++) {
+                if (e < 100000) e = e*10 + CHAR_TO_NUM(*q);
+            }
+            exp10 += exp_negative ? -e : e;
+            p = q;
+        }
+    }
+
+    // Fast path di Clinger: mantissa e potenza di 10 esatte, una sola operazione arrotondata
+    if (mantissa <= (1ull << 53) && exp10 >= -22 && exp10 <= 22 && digits < 19) {
+        double value = (double)mantissa;
+        value = exp10 < 0 ? value / pow10[-exp10] : value * pow10[exp10];
+        *out = negative ? -value : value;
+        sv->length -= p - sv->data;
+        sv->data += p - sv->data;
+        return true;
+    }
+
+slow_path:;
+    // caso raro: troppe cifre, esponente grande o esadecimale, serve strtod per avere
+    // l'arrotondamento corretto; viene passata una copia terminata da '\0' e il locale
+    // del thread diventa "C" solo per la durata della chiamata
+    char buf[512];
+    size_t n = sv->length < sizeof(buf) - 1 ? sv->length : sizeof(buf) - 1;
+    memcpy(buf, sv->data, n);
+    buf[n] = '\0';
+    char *parsed_end;
+    locale_t previous = uselocale(sv_get_c_locale());
+    double value = strtod(buf, &parsed_end);
+    uselocale(previous);
+    if (parsed_end == buf) return false;
+    *out = value;
+    sv->length -= parsed_end - buf;
+    sv->data += parsed_end - buf;
+    return true;
+}
+
 void sv_trim(String_View *sv) {
     sv_trim_left(sv);
     sv_trim_right(sv);
@@ -329,4 +607,12 @@ defer:
     return result;
 }
 
+/*
+    sv_from_sb e le append accettano anche String_Sso*, così il codice esistente
+    funziona con entrambi i tipi (le chiamate interne sopra usano le funzioni)
+*/
+#define sv_from_sb(sb) _Generic((sb), String_Sso*: sv_from_sso, default: sv_from_sb)(sb)
+#define sb_append_sv(sb, sv) _Generic((sb), String_Sso*: sso_append_sv, default: sb_append_sv)((sb), (sv))
+#define sb_append_cstr(sb, data) _Generic((sb), String_Sso*: sso_append_cstr, default: sb_append_cstr)((sb), (data))
+
 #endif // STRINGS_H_
\ No newline at end of file
@@ -0,0 +1,561 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
+#include "macros.h"
+#include "logging.h"
+#include "arena.h"
+
+#ifndef THREADPOOLDEF
+#define THREADPOOLDEF static inline
+#endif // THREADPOOLDEF
+
+/*
+    Pool di thread con work stealing, da condividere fra tutti i cicli paralleli
+    invece di creare thread a ogni chiamata.
+
+    Ogni worker ha una deque Chase-Lev: i task creati da un worker vanno in fondo alla sua
+    deque e vengono ripresi dal fondo (LIFO, dati ancora in cache), mentre i worker senza
+    lavoro rubano dalla cima delle deque degli altri. I thread esterni al pool mettono i
+    task in una coda condivisa. Chi aspetta un gruppo di task nel frattempo ne esegue altri,
+    quindi si possono annidare parallel_for e task group senza bloccare i worker.
+
+    Esempio:
+        static void square(void *ctx, size_t begin, size_t end) {
+            double *v = ctx;
+            for(size_t i = begin; i < end; i++) v[i] *= v[i];
+        }
+        parallel_for(0, n, 0, square, v);
+*/
+
+// task che un worker senza lavoro cerca di rubare (cedendo la cpu) prima di dormire
+#ifndef THREADPOOL_SPIN
+#define THREADPOOL_SPIN 64
+#endif // THREADPOOL_SPIN
+
+// capacità iniziale delle deque, raddoppia quando serve
+#ifndef THREADPOOL_DEQUE_CAPACITY
+#define THREADPOOL_DEQUE_CAPACITY 256
+#endif // THREADPOOL_DEQUE_CAPACITY
+
+typedef struct Threadpool Threadpool;
+
+/*
+    Gruppo fork/join: task_group_wait ritorna quando tutti i task creati nel gruppo
+    (anche da altri task del gruppo) sono finiti
+*/
+typedef struct {
+    Threadpool *pool;
+    _Atomic size_t pending;
+} Task_Group;
+
+/*
+    Crea un pool di thread
+    @param n_workers numero di worker, 0 = cpu disponibili meno una (il thread che
+    aspetta un gruppo lavora anche lui)
+    @param pin_cpus fissa il worker i sulla cpu i modulo il numero di cpu
+*/
+THREADPOOLDEF Threadpool *threadpool_create(size_t n_workers, bool pin_cpus);
+/*
+    Ferma i worker e libera il pool
+    @note non devono esserci task in esecuzione o in attesa
+*/
+THREADPOOLDEF void threadpool_destroy(Threadpool *pool);
+/*
+    Pool condiviso dal processo, creato alla prima chiamata con threadpool_create(0, false)
+*/
+THREADPOOLDEF Threadpool *threadpool_default(void);
+/*
+    @return numero di worker del pool
+*/
+THREADPOOLDEF size_t threadpool_size(Threadpool *pool);
+
+THREADPOOLDEF void task_group_init(Task_Group *group, Threadpool *pool);
+/*
+    Esegue fn(ctx) su un worker del pool del gruppo
+    @note ctx deve restare valido fino a task_group_wait
+*/
+THREADPOOLDEF void task_group_spawn(Task_Group *group, void (*fn)(void *ctx), void *ctx);
+/*
+    Aspetta la fine di tutti i task del gruppo eseguendo nel frattempo task del pool
+*/
+THREADPOOLDEF void task_group_wait(Task_Group *group);
+
+/*
+    Esegue fn(ctx, b, e) su sotto-intervalli disgiunti che coprono [begin, end),
+    dividendo a metà finché gli intervalli superano grain; ritorna quando tutti sono finiti
+    @param grain dimensione massima di un intervallo, 0 = scelta automatica
+*/
+THREADPOOLDEF void threadpool_parallel_for(Threadpool *pool, size_t begin, size_t end, size_t grain,
+                                           void (*fn)(void *ctx, size_t begin, size_t end), void *ctx);
+/*
+    threadpool_parallel_for sul pool condiviso threadpool_default()
+*/
+THREADPOOLDEF void parallel_for(size_t begin, size_t end, size_t grain,
+                                void (*fn)(void *ctx, size_t begin, size_t end), void *ctx);
+
+/*
+    Arena di lavoro del thread chiamante, senza lock. Sui worker del pool viene svuotata
+    quando finisce il task più esterno: la memoria vale fino alla fine del task.
+    Fuori dai worker (main o altri thread, anche mentre eseguono task dentro parallel_for
+    o task_group_wait) non viene mai svuotata dal pool: la memoria resta valida fino
+    ad un arena_reset esplicito del chiamante o alla fine del thread.
+*/
+THREADPOOLDEF Arena *threadpool_scratch(void);
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+typedef struct Threadpool_Task Threadpool_Task;
+
+struct Threadpool_Task {
+    void (*fn)(void *ctx);                                  // task di task_group_spawn
+    void (*range_fn)(void *ctx, size_t begin, size_t end);  // task di parallel_for
+    void *ctx;
+    size_t begin;
+    size_t end;
+    size_t grain;
+    Task_Group *group;
+};
+
+typedef struct Threadpool_Array Threadpool_Array;
+
+struct Threadpool_Array {
+    Threadpool_Array *previous;  // array sostituiti, un ladro può ancora leggerli
+    int64_t capacity;            // potenza di 2
+    _Atomic(Threadpool_Task*) tasks[];
+};
+
+typedef struct {
+    _Alignas(64) _Atomic int64_t top;    // i ladri prendono da qui
+    _Alignas(64) _Atomic int64_t bottom; // solo il proprietario aggiunge e toglie da qui
+    _Atomic(Threadpool_Array*) array;
+} Threadpool_Deque;
+
+typedef struct {
+    Threadpool_Deque deque;
+    Threadpool *pool;
+    size_t index;
+    pthread_t thread;
+} Threadpool_Worker;
+
+struct Threadpool {
+    Threadpool_Worker *workers;
+    size_t n_workers;
+    bool pin_cpus;
+    _Atomic bool stop;
+
+    // task dei thread esterni al pool
+    pthread_mutex_t injected_mutex;
+    _Atomic size_t injected_count;
+    struct {
+        Threadpool_Task **data;
+        size_t length;
+        size_t capacity;
+    } injected;
+
+    // worker addormentati
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    _Atomic int sleeping;
+};
+
+typedef struct {
+    pthread_once_t once;
+    pthread_key_t key;
+    Threadpool *pool;
+} Threadpool_State;
+
+SHARED_GLOBAL Threadpool_State threadpool_state = {
+    .once = PTHREAD_ONCE_INIT,
+};
+
+SHARED_GLOBAL pthread_once_t threadpool_default_once = PTHREAD_ONCE_INIT;
+SHARED_GLOBAL _Thread_local Threadpool_Worker *threadpool_self;
+SHARED_GLOBAL _Thread_local Arena threadpool_thread_arena;
+SHARED_GLOBAL _Thread_local bool threadpool_arena_registered;
+SHARED_GLOBAL _Thread_local size_t threadpool_depth;   // task annidati in esecuzione sul thread
+SHARED_GLOBAL _Thread_local size_t threadpool_victim;  // da dove iniziare a rubare
+
+/* ---------------------- Chase-Lev deque ---------------------- */
+
+static inline Threadpool_Array *threadpool_array_new(int64_t capacity, Threadpool_Array *previous) {
+    Threadpool_Array *array = (Threadpool_Array*)malloc(sizeof(*array) + capacity*sizeof(array->tasks[0]));
+    fatal_if(array == NULL, MSG_ERR_FULL_MEMORY);
+    array->previous = previous;
+    array->capacity = capacity;
+    return array;
+}
+
+static inline void threadpool_deque_init(Threadpool_Deque *deque) {
+    atomic_init(&deque->top, 0);
+    atomic_init(&deque->bottom, 0);
+    atomic_init(&deque->array, threadpool_array_new(THREADPOOL_DEQUE_CAPACITY, NULL));
+}
+
+static inline void threadpool_deque_free(Threadpool_Deque *deque) {
+    Threadpool_Array *array = atomic_load(&deque->array);
+    while(array != NULL) {
+        Threadpool_Array *previous = array->previous;
+        free(array);
+        array = previous;
+    }
+}
+
+// solo il proprietario
+static inline void threadpool_deque_push(Threadpool_Deque *deque, Threadpool_Task *task) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    Threadpool_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    if(bottom - top > array->capacity - 1) {
+        Threadpool_Array *bigger = threadpool_array_new(array->capacity*2, array);
+        for(int64_t i = top; i < bottom; i++) {
+            Threadpool_Task *t = atomic_load_explicit(&array->tasks[i & (array->capacity - 1)], memory_order_relaxed);
+            atomic_store_explicit(&bigger->tasks[i & (bigger->capacity - 1)], t, memory_order_relaxed);
+        }
+        atomic_store_explicit(&deque->array, bigger, memory_order_release);
+        array = bigger;
+    }
+    // release: chi ruba il task vede anche i campi scritti prima di pubblicarlo
+    atomic_store_explicit(&array->tasks[bottom & (array->capacity - 1)], task, memory_order_release);
+    atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_release);
+}
+
+// solo il proprietario, @return NULL se vuota
+static inline Threadpool_Task *threadpool_deque_take(Threadpool_Deque *deque) {
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_relaxed) - 1;
+    Threadpool_Array *array = atomic_load_explicit(&deque->array, memory_order_relaxed);
+    atomic_store_explicit(&deque->bottom, bottom, memory_order_relaxed);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_relaxed);
+
+    Threadpool_Task *task = NULL;
+    if(top <= bottom) {
+        task = atomic_load_explicit(&array->tasks[bottom & (array->capacity - 1)], memory_order_relaxed);
+        if(top == bottom) {
+            // ultimo elemento: si contende con i ladri
+            if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                        memory_order_seq_cst, memory_order_relaxed)) {
+                task = NULL;
+            }
+            atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+        }
+    } else {
+        atomic_store_explicit(&deque->bottom, bottom + 1, memory_order_relaxed);
+    }
+    return task;
+}
+
+// qualsiasi thread, @return NULL se vuota o se un altro thread ha preso il task per primo
+static inline Threadpool_Task *threadpool_deque_steal(Threadpool_Deque *deque) {
+    int64_t top = atomic_load_explicit(&deque->top, memory_order_acquire);
+    atomic_thread_fence(memory_order_seq_cst);
+    int64_t bottom = atomic_load_explicit(&deque->bottom, memory_order_acquire);
+    if(top >= bottom) return NULL;
+
+    Threadpool_Array *array = atomic_load_explicit(&deque->array, memory_order_acquire);
+    Threadpool_Task *task = atomic_load_explicit(&array->tasks[top & (array->capacity - 1)], memory_order_acquire);
+    if(!atomic_compare_exchange_strong_explicit(&deque->top, &top, top + 1,
+                                                memory_order_seq_cst, memory_order_relaxed)) {
+        return NULL;
+    }
+    return task;
+}
+
+/* ---------------------- Scheduler ---------------------- */
+
+static inline void threadpool_arena_exit(void *arg) {
+    arena_free((Arena*)arg);
+}
+
+static inline void threadpool_create_key(void) {
+    int err = pthread_key_create(&threadpool_state.key, threadpool_arena_exit);
+    fatal_if(err != 0, "threadpool: could not create the thread key: %s", strerror(err));
+}
+
+Arena *threadpool_scratch(void) {
+    if(!threadpool_arena_registered) {
+        // l'arena del thread viene liberata quando il thread termina
+        pthread_once(&threadpool_state.once, threadpool_create_key);
+        pthread_setspecific(threadpool_state.key, &threadpool_thread_arena);
+        threadpool_arena_registered = true;
+    }
+    return &threadpool_thread_arena;
+}
+
+static inline bool threadpool_has_work(Threadpool *pool) {
+    if(atomic_load(&pool->injected_count) > 0) return true;
+    for(size_t i = 0; i < pool->n_workers; i++) {
+        Threadpool_Deque *deque = &pool->workers[i].deque;
+        if(atomic_load(&deque->top) < atomic_load(&deque->bottom)) return true;
+    }
+    return false;
+}
+
+static inline void threadpool_wake(Threadpool *pool) {
+    // accoppiata con l'incremento di sleeping in threadpool_sleep: o il worker vede
+    // il task, o qui si vede il worker che sta per dormire
+    atomic_thread_fence(memory_order_seq_cst);
+    if(atomic_load_explicit(&pool->sleeping, memory_order_relaxed) == 0) return;
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_signal(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static inline void threadpool_sleep(Threadpool *pool) {
+    pthread_mutex_lock(&pool->mutex);
+    atomic_fetch_add(&pool->sleeping, 1);
+    while(!atomic_load(&pool->stop) && !threadpool_has_work(pool)) {
+        pthread_cond_wait(&pool->cond, &pool->mutex);
+    }
+    atomic_fetch_sub(&pool->sleeping, 1);
+    pthread_mutex_unlock(&pool->mutex);
+}
+
+static inline void threadpool_push(Threadpool *pool, Threadpool_Task *task) {
+    Threadpool_Worker *self = threadpool_self;
+    if(self != NULL && self->pool == pool) {
+        threadpool_deque_push(&self->deque, task);
+    } else {
+        pthread_mutex_lock(&pool->injected_mutex);
+        append(&pool->injected, task);
+        atomic_fetch_add(&pool->injected_count, 1);
+        pthread_mutex_unlock(&pool->injected_mutex);
+    }
+    threadpool_wake(pool);
+}
+
+static inline Threadpool_Task *threadpool_find_task(Threadpool *pool) {
+    Threadpool_Worker *self = threadpool_self;
+    bool own = self != NULL && self->pool == pool;
+    Threadpool_Task *task = NULL;
+
+    if(own && (task = threadpool_deque_take(&self->deque)) != NULL) return task;
+
+    if(atomic_load_explicit(&pool->injected_count, memory_order_relaxed) > 0) {
+        pthread_mutex_lock(&pool->injected_mutex);
+        if(pool->injected.length > 0) {
+            task = pool->injected.data[--pool->injected.length];
+            atomic_fetch_sub(&pool->injected_count, 1);
+        }
+        pthread_mutex_unlock(&pool->injected_mutex);
+        if(task != NULL) return task;
+    }
+
+    // ogni tentativo parte da una vittima diversa, così i ladri non si accodano sulla stessa
+    size_t start = threadpool_victim++;
+    for(size_t i = 0; i < pool->n_workers; i++) {
+        Threadpool_Worker *victim = &pool->workers[(start + i) % pool->n_workers];
+        if(victim == self) continue;
+        if((task = threadpool_deque_steal(&victim->deque)) != NULL) return task;
+    }
+    return NULL;
+}
+
+static inline Threadpool_Task *threadpool_new_task(Task_Group *group) {
+    Threadpool_Task *task = (Threadpool_Task*)calloc(1, sizeof(*task));
+    fatal_if(task == NULL, MSG_ERR_FULL_MEMORY);
+    task->group = group;
+    atomic_fetch_add_explicit(&group->pending, 1, memory_order_relaxed);
+    return task;
+}
+
+static inline void threadpool_run(Threadpool_Task *task) {
+    Task_Group *group = task->group;
+    threadpool_depth++;
+    if(task->range_fn != NULL) {
+        // tiene la metà sinistra e lascia rubare la destra, fino a intervalli di grain
+        while(task->end - task->begin > task->grain) {
+            size_t mid = task->begin + (task->end - task->begin)/2;
+            Threadpool_Task *right = threadpool_new_task(group);
+            right->range_fn = task->range_fn;
+            right->ctx = task->ctx;
+            right->begin = mid;
+            right->end = task->end;
+            right->grain = task->grain;
+            threadpool_push(group->pool, right);
+            task->end = mid;
+        }
+        task->range_fn(task->ctx, task->begin, task->end);
+    } else {
+        task->fn(task->ctx);
+    }
+    free(task);
+    threadpool_depth--;
+    // solo sui worker: il chiamante di parallel_for esegue task a profondità 0
+    // ma può avere in uso memoria presa dall'arena prima della chiamata
+    if(threadpool_depth == 0 && threadpool_self != NULL && threadpool_thread_arena.start != NULL) {
+        arena_reset(&threadpool_thread_arena);
+    }
+    atomic_fetch_sub_explicit(&group->pending, 1, memory_order_release);
+}
+
+static inline void threadpool_pin(size_t cpu) {
+#ifdef __linux__
+    unsigned long mask[1024/(8*sizeof(unsigned long))] = {0};
+    cpu %= 8*sizeof(mask);
+    mask[cpu/(8*sizeof(unsigned long))] = 1ul << (cpu % (8*sizeof(unsigned long)));
+    // syscall diretta: CPU_SET e pthread_setaffinity_np richiedono _GNU_SOURCE
+    if(syscall(SYS_sched_setaffinity, 0, sizeof(mask), mask) != 0) {
+        log_warning("threadpool: could not pin the worker to cpu %zu: %s", cpu, strerror(errno));
+    }
+#else
+    (void)cpu;
+#endif
+}
+
+static inline void *threadpool_worker_main(void *arg) {
+    Threadpool_Worker *self = (Threadpool_Worker*)arg;
+    Threadpool *pool = self->pool;
+    threadpool_self = self;
+    threadpool_victim = self->index + 1;
+    if(pool->pin_cpus) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadpool_pin(self->index % (size_t)(n_cpus > 0 ? n_cpus : 1));
+    }
+
+    size_t idle = 0;
+    for(;;) {
+        Threadpool_Task *task = threadpool_find_task(pool);
+        if(task != NULL) {
+            threadpool_run(task);
+            idle = 0;
+        } else if(atomic_load_explicit(&pool->stop, memory_order_acquire)) {
+            break;
+        } else if(++idle < THREADPOOL_SPIN) {
+            sched_yield();
+        } else {
+            threadpool_sleep(pool);
+            idle = 0;
+        }
+    }
+    return NULL;
+}
+
+Threadpool *threadpool_create(size_t n_workers, bool pin_cpus) {
+    if(n_workers == 0) {
+        long n_cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        n_workers = n_cpus > 1 ? (size_t)n_cpus - 1 : 1;
+    }
+    Threadpool *pool = (Threadpool*)calloc(1, sizeof(*pool));
+    Threadpool_Worker *workers = (Threadpool_Worker*)aligned_alloc(_Alignof(Threadpool_Worker), n_workers*sizeof(*workers));
+    fatal_if(pool == NULL || workers == NULL, MSG_ERR_FULL_MEMORY);
+    memset(workers, 0, n_workers*sizeof(*workers));
+
+    pool->workers = workers;
+    pool->n_workers = n_workers;
+    pool->pin_cpus = pin_cpus;
+    pthread_mutex_init(&pool->injected_mutex, NULL);
+    pthread_mutex_init(&pool->mutex, NULL);
+    pthread_cond_init(&pool->cond, NULL);
+
+    // le deque devono esistere tutte prima che un worker provi a rubare
+    for(size_t i = 0; i < n_workers; i++) {
+        workers[i].pool = pool;
+        workers[i].index = i;
+        threadpool_deque_init(&workers[i].deque);
+    }
+    for(size_t i = 0; i < n_workers; i++) {
+        int err = pthread_create(&workers[i].thread, NULL, threadpool_worker_main, &workers[i]);
+        fatal_if(err != 0, "threadpool: could not create thread: %s", strerror(err));
+    }
+    return pool;
+}
+
+void threadpool_destroy(Threadpool *pool) {
+    atomic_store(&pool->stop, true);
+    pthread_mutex_lock(&pool->mutex);
+    pthread_cond_broadcast(&pool->cond);
+    pthread_mutex_unlock(&pool->mutex);
+    for(size_t i = 0; i < pool->n_workers; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        threadpool_deque_free(&pool->workers[i].deque);
+    }
+    pthread_cond_destroy(&pool->cond);
+    pthread_mutex_destroy(&pool->mutex);
+    pthread_mutex_destroy(&pool->injected_mutex);
+    free(pool->injected.data);
+    free(pool->workers);
+    free(pool);
+}
+
+static inline void threadpool_create_default(void) {
+    threadpool_state.pool = threadpool_create(0, false);
+}
+
+Threadpool *threadpool_default(void) {
+    pthread_once(&threadpool_default_once, threadpool_create_default);
+    return threadpool_state.pool;
+}
+
+size_t threadpool_size(Threadpool *pool) {
+    return pool->n_workers;
+}
+
+void task_group_init(Task_Group *group, Threadpool *pool) {
+    group->pool = pool;
+    atomic_init(&group->pending, 0);
+}
+
+void task_group_spawn(Task_Group *group, void (*fn)(void *ctx), void *ctx) {
+    Threadpool_Task *task = threadpool_new_task(group);
+    task->fn = fn;
+    task->ctx = ctx;
+    threadpool_push(group->pool, task);
+}
+
+void task_group_wait(Task_Group *group) {
+    size_t idle = 0;
+    while(atomic_load_explicit(&group->pending, memory_order_acquire) > 0) {
+        Threadpool_Task *task = threadpool_find_task(group->pool);
+        if(task != NULL) {
+            threadpool_run(task);
+            idle = 0;
+        } else if(++idle < THREADPOOL_SPIN) {
+            sched_yield();
+        } else {
+            // i task rimasti sono in esecuzione altrove: si aspetta senza occupare la cpu
+            struct timespec ts = { 0, 50*1000 };
+            nanosleep(&ts, NULL);
+        }
+    }
+}
+
+void threadpool_parallel_for(Threadpool *pool, size_t begin, size_t end, size_t grain,
+                             void (*fn)(void *ctx, size_t begin, size_t end), void *ctx) {
+    if(begin >= end) return;
+    if(grain == 0) {
+        // circa 8 intervalli per worker: abbastanza per bilanciare, pochi per l'overhead
+        grain = (end - begin)/(8*(pool->n_workers + 1));
+        if(grain == 0) grain = 1;
+    }
+    Task_Group group;
+    task_group_init(&group, pool);
+    Threadpool_Task *task = threadpool_new_task(&group);
+    task->range_fn = fn;
+    task->ctx = ctx;
+    task->begin = begin;
+    task->end = end;
+    task->grain = grain;
+    // il primo intervallo lo esegue il chiamante, le metà destre vanno agli altri
+    threadpool_run(task);
+    task_group_wait(&group);
+}
+
+void parallel_for(size_t begin, size_t end, size_t grain,
+                  void (*fn)(void *ctx, size_t begin, size_t end), void *ctx) {
+    threadpool_parallel_for(threadpool_default(), begin, end, grain, fn, ctx);
+}
+
+#endif // THREADPOOL_H_
@@ -0,0 +1,419 @@
+#ifndef UNROLLED_LIST_H_
+#define UNROLLED_LIST_H_
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "macros.h"
+
+#ifndef UNROLLED_LISTDEF
+#define UNROLLED_LISTDEF static inline
+#endif // UNROLLED_LISTDEF
+
+/*
+    Lista ordinata "srotolata": stesse operazioni di list.h, ma ogni nodo contiene
+    un piccolo array ordinato di elementi salvati per valore, tutti della stessa grandezza.
+
+    Rispetto a list_head_t sparisce la malloc per ogni elemento, e la scansione tocca
+    una linea di cache per nodo invece di due puntatori sparsi per elemento: per decidere
+    se proseguire basta il primo elemento del nodo successivo, che sta accanto al suo
+    puntatore next. Dentro il nodo giusto la ricerca è binaria.
+
+    I nodi si dividono a metà quando sono pieni e si uniscono (o si ribilanciano) col
+    successivo quando scendono sotto metà capacità.
+*/
+
+// grandezza in byte di un nodo, header compreso (multiplo di una linea di cache)
+#ifndef UNROLLED_LIST_NODE_BYTES
+#define UNROLLED_LIST_NODE_BYTES 512
+#endif // UNROLLED_LIST_NODE_BYTES
+
+typedef struct Unrolled_Node Unrolled_Node;
+
+struct Unrolled_Node {
+    Unrolled_Node *next; // può essere null
+    size_t count;
+    _Alignas(16) unsigned char elems[]; // count elementi ordinati
+};
+
+typedef struct {
+    Unrolled_Node *head;
+    size_t length;
+    size_t elem_size;
+    size_t node_capacity; // elementi per nodo
+    pthread_rwlock_t rwlock;
+    int(*compare)(void*,void*);
+} Unrolled_List;
+
+/*
+    Creazione della lista
+    @param elem_size grandezza in byte di un elemento (es. sizeof(int))
+    @param compare stessa convenzione di list_init, riceve puntatori agli elementi (es. LIST_CMP_INT)
+*/
+UNROLLED_LISTDEF Unrolled_List unrolled_list_init(size_t elem_size, int(*compare)(void*,void*));
+/*
+    Dealloca tutti i nodi della lista
+*/
+UNROLLED_LISTDEF void unrolled_list_deinit(Unrolled_List *_this);
+/*
+    Controlla se un elemento si trova nella lista
+    @param value puntatore a un elemento
+    @note O(n/B + log B), con B elementi per nodo
+*/
+UNROLLED_LISTDEF bool unrolled_list_is_member(Unrolled_List *_this, void *value);
+/*
+    Inserisci una copia dell'elemento nella lista
+    @param value puntatore all'elemento da copiare, resta del chiamante
+    @return false se l'elemento era già presente
+*/
+UNROLLED_LISTDEF bool unrolled_list_insert(Unrolled_List *_this, void *value);
+/*
+    Elimina un elemento dalla lista
+    @return false se l'elemento non era presente
+*/
+UNROLLED_LISTDEF bool unrolled_list_delete(Unrolled_List *_this, void *value);
+/*
+    @return puntatore all'elemento in posizione index (ordine crescente), NULL se fuori dalla lista
+    @note il puntatore resta valido fino alla prossima modifica della lista
+*/
+UNROLLED_LISTDEF void *unrolled_list_at(Unrolled_List *_this, size_t index);
+
+/* ---------------------- TYPED UNROLLED LISTS ---------------------- */
+
+// elementi di tipo T in un nodo di UNROLLED_LIST_NODE_BYTES (almeno 4)
+#define UNROLLED_LIST_CAPACITY(T) \
+    ((UNROLLED_LIST_NODE_BYTES - 2*sizeof(void*))/sizeof(T) < 4 ? 4 : (UNROLLED_LIST_NODE_BYTES - 2*sizeof(void*))/sizeof(T))
+
+/*
+    Genera una lista srotolata specializzata per il tipo T, con il comparatore espanso
+    dentro la scansione e la ricerca binaria (vedi DEFINE_LIST per i parametri).
+    Genera name_init, name_deinit, name_is_member, name_insert, name_delete e name_at,
+    con la stessa semantica delle funzioni unrolled_list_* ma con T per valore.
+*/
+#define DEFINE_UNROLLED_LIST(name, T, cmp)                                                  \
+    typedef struct name##_node_s name##_node_t;                                             \
+                                                                                            \
+    struct name##_node_s {                                                                  \
+        name##_node_t *next;                                                                \
+        size_t count;                                                                       \
+        T elems[UNROLLED_LIST_CAPACITY(T)];                                                 \
+    };                                                                                      \
+                                                                                            \
+    typedef struct {                                                                        \
+        name##_node_t *head;                                                                \
+        size_t length;                                                                      \
+        pthread_rwlock_t rwlock;                                                            \
+    } name##_t;                                                                             \
+                                                                                            \
+    UNROLLED_LISTDEF name##_t name##_init(void) {                                           \
+        name##_t _this = {0};                                                               \
+        pthread_rwlock_init(&_this.rwlock, NULL);                                           \
+        return _this;                                                                       \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF void name##_deinit(name##_t *_this) {                                  \
+        pthread_rwlock_destroy(&_this->rwlock);                                             \
+        name##_node_t *curr = _this->head;                                                  \
+        while(curr != NULL) {                                                               \
+            name##_node_t *temp = curr->next;                                               \
+            free(curr);                                                                     \
+            curr = temp;                                                                    \
+        }                                                                                   \
+        _this->head = NULL;                                                                 \
+        _this->length = 0;                                                                  \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF name##_node_t *name##_new_node(void) {                                 \
+        name##_node_t *node = aligned_alloc(64, (sizeof(name##_node_t) + 63) & ~(size_t)63); \
+        fatal_if(node == NULL, MSG_ERR_FULL_MEMORY);                                        \
+        node->next = NULL;                                                                  \
+        node->count = 0;                                                                    \
+        return node;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF name##_node_t *name##_find_node(name##_t *_this, T value, name##_node_t **prev) { \
+        name##_node_t *pred = NULL;                                                         \
+        name##_node_t *curr = _this->head;                                                  \
+        while(curr->next != NULL && cmp(curr->next->elems[0], value) <= 0) {                \
+            pred = curr;                                                                    \
+            curr = curr->next;                                                              \
+        }                                                                                   \
+        if(prev != NULL) *prev = pred;                                                      \
+        return curr;                                                                        \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF size_t name##_search(name##_node_t *node, T value, bool *found) {      \
+        size_t low = 0;                                                                     \
+        size_t high = node->count;                                                          \
+        while(low < high) {                                                                 \
+            size_t mid = low + (high - low)/2;                                              \
+            if(cmp(node->elems[mid], value) < 0) low = mid + 1;                             \
+            else high = mid;                                                                \
+        }                                                                                   \
+        *found = low < node->count && cmp(node->elems[low], value) == 0;                    \
+        return low;                                                                         \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF bool name##_is_member(name##_t *_this, T value) {                      \
+        bool result = false;                                                                \
+        pthread_rwlock_rdlock(&_this->rwlock);                                              \
+        if(_this->head != NULL) name##_search(name##_find_node(_this, value, NULL), value, &result); \
+        pthread_rwlock_unlock(&_this->rwlock);                                              \
+        return result;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF bool name##_insert(name##_t *_this, T value) {                         \
+        bool found = false;                                                                 \
+        pthread_rwlock_wrlock(&_this->rwlock);                                              \
+        if(_this->head == NULL) _this->head = name##_new_node();                            \
+        name##_node_t *node = name##_find_node(_this, value, NULL);                         \
+        size_t pos = name##_search(node, value, &found);                                    \
+        if(!found) {                                                                        \
+            if(node->count == UNROLLED_LIST_CAPACITY(T)) {                                  \
+                name##_node_t *split = name##_new_node();                                   \
+                size_t half = node->count/2;                                                \
+                split->count = node->count - half;                                          \
+                memcpy(split->elems, node->elems + half, split->count*sizeof(T));           \
+                node->count = half;                                                         \
+                split->next = node->next;                                                   \
+                node->next = split;                                                         \
+                if(pos > half) {                                                            \
+                    pos -= half;                                                            \
+                    node = split;                                                           \
+                }                                                                           \
+            }                                                                               \
+            memmove(node->elems + pos + 1, node->elems + pos, (node->count - pos)*sizeof(T)); \
+            node->elems[pos] = value;                                                       \
+            node->count++;                                                                  \
+            _this->length++;                                                                \
+        }                                                                                   \
+        pthread_rwlock_unlock(&_this->rwlock);                                              \
+        return !found;                                                                      \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF bool name##_delete(name##_t *_this, T value) {                         \
+        bool found = false;                                                                 \
+        pthread_rwlock_wrlock(&_this->rwlock);                                              \
+        name##_node_t *prev = NULL;                                                         \
+        name##_node_t *node = _this->head != NULL ? name##_find_node(_this, value, &prev) : NULL; \
+        size_t pos = node != NULL ? name##_search(node, value, &found) : 0;                 \
+        if(found) {                                                                         \
+            node->count--;                                                                  \
+            memmove(node->elems + pos, node->elems + pos + 1, (node->count - pos)*sizeof(T)); \
+            _this->length--;                                                                \
+            name##_node_t *next = node->next;                                               \
+            if(node->count < UNROLLED_LIST_CAPACITY(T)/2 && next != NULL) {                 \
+                if(node->count + next->count <= UNROLLED_LIST_CAPACITY(T)) {                \
+                    memcpy(node->elems + node->count, next->elems, next->count*sizeof(T));  \
+                    node->count += next->count;                                             \
+                    node->next = next->next;                                                \
+                    free(next);                                                             \
+                } else {                                                                    \
+                    size_t moved = (next->count - node->count)/2;                           \
+                    memcpy(node->elems + node->count, next->elems, moved*sizeof(T));        \
+                    node->count += moved;                                                   \
+                    next->count -= moved;                                                   \
+                    memmove(next->elems, next->elems + moved, next->count*sizeof(T));       \
+                }                                                                           \
+            } else if(node->count == 0) {                                                   \
+                if(prev != NULL) prev->next = next;                                         \
+                else _this->head = next;                                                    \
+                free(node);                                                                 \
+            }                                                                               \
+        }                                                                                   \
+        pthread_rwlock_unlock(&_this->rwlock);                                              \
+        return found;                                                                       \
+    }                                                                                       \
+                                                                                            \
+    UNROLLED_LISTDEF T *name##_at(name##_t *_this, size_t index) {                          \
+        T *result = NULL;                                                                   \
+        pthread_rwlock_rdlock(&_this->rwlock);                                              \
+        for(name##_node_t *node = _this->head; node != NULL; node = node->next) {           \
+            if(index < node->count) {                                                       \
+                result = &node->elems[index];                                               \
+                break;                                                                      \
+            }                                                                               \
+            index -= node->count;                                                           \
+        }                                                                                   \
+        pthread_rwlock_unlock(&_this->rwlock);                                              \
+        return result;                                                                      \
+    }
+
+/* ---------------------- IMPLEMENTATION ---------------------- */
+
+#define unrolled_elem(_this, node, i) ((void*)((node)->elems + (i)*(_this)->elem_size))
+
+Unrolled_List unrolled_list_init(size_t elem_size, int(*compare)(void*,void*)) {
+    Unrolled_List _this = {0};
+    fatal_if(elem_size == 0, "unrolled_list: elements must have a size");
+    _this.elem_size = elem_size;
+    _this.compare = compare;
+    size_t room = UNROLLED_LIST_NODE_BYTES - sizeof(Unrolled_Node);
+    _this.node_capacity = room/elem_size < 4 ? 4 : room/elem_size;
+    pthread_rwlock_init(&_this.rwlock, NULL);
+    return _this;
+}
+
+void unrolled_list_deinit(Unrolled_List *_this) {
+    pthread_rwlock_destroy(&_this->rwlock);
+    Unrolled_Node *curr = _this->head;
+    while(curr != NULL) {
+        Unrolled_Node *temp = curr->next;
+        free(curr);
+        curr = temp;
+    }
+    _this->head = NULL;
+    _this->length = 0;
+}
+
+UNROLLED_LISTDEF Unrolled_Node *unrolled_new_node(Unrolled_List *_this) {
+    size_t bytes = sizeof(Unrolled_Node) + _this->node_capacity*_this->elem_size;
+    // aligned_alloc vuole un multiplo dell'allineamento
+    Unrolled_Node *node = aligned_alloc(64, (bytes + 63) & ~(size_t)63);
+    fatal_if(node == NULL, MSG_ERR_FULL_MEMORY);
+    node->next = NULL;
+    node->count = 0;
+    return node;
+}
+
+/*
+    Trova il nodo che può contenere value: l'ultimo il cui primo elemento è <= value
+    @param prev se non NULL riceve il nodo precedente (NULL se è la testa)
+*/
+UNROLLED_LISTDEF Unrolled_Node *unrolled_find_node(Unrolled_List *_this, void *value, Unrolled_Node **prev) {
+    Unrolled_Node *pred = NULL;
+    Unrolled_Node *curr = _this->head;
+    while(curr->next != NULL && _this->compare(unrolled_elem(_this, curr->next, 0), value) <= 0) {
+        pred = curr;
+        curr = curr->next;
+    }
+    if(prev != NULL) *prev = pred;
+    return curr;
+}
+
+/*
+    Ricerca binaria dentro il nodo
+    @param found true se l'elemento in posizione ritornata è uguale a value
+    @return primo indice con elemento >= value
+*/
+UNROLLED_LISTDEF size_t unrolled_search(Unrolled_List *_this, Unrolled_Node *node, void *value, bool *found) {
+    size_t low = 0;
+    size_t high = node->count;
+    while(low < high) {
+        size_t mid = low + (high - low)/2;
+        if(_this->compare(unrolled_elem(_this, node, mid), value) < 0) low = mid + 1;
+        else high = mid;
+    }
+    *found = low < node->count && _this->compare(unrolled_elem(_this, node, low), value) == 0;
+    return low;
+}
+
+bool unrolled_list_is_member(Unrolled_List *_this, void *value) {
+    bool result = false;
+    pthread_rwlock_rdlock(&_this->rwlock);
+    if(_this->head != NULL) {
+        Unrolled_Node *node = unrolled_find_node(_this, value, NULL);
+        unrolled_search(_this, node, value, &result);
+    }
+    pthread_rwlock_unlock(&_this->rwlock);
+    return result;
+}
+
+bool unrolled_list_insert(Unrolled_List *_this, void *value) {
+    bool result;
+    pthread_rwlock_wrlock(&_this->rwlock);
+
+    if(_this->head == NULL) _this->head = unrolled_new_node(_this);
+
+    Unrolled_Node *node = unrolled_find_node(_this, value, NULL);
+    bool found;
+    size_t pos = unrolled_search(_this, node, value, &found);
+    if(found) return_defer(false);
+
+    size_t size = _this->elem_size;
+    if(node->count == _this->node_capacity) {
+        // nodo pieno: la metà alta va in un nuovo nodo subito dopo
+        Unrolled_Node *split = unrolled_new_node(_this);
+        size_t half = node->count/2;
+        split->count = node->count - half;
+        memcpy(split->elems, unrolled_elem(_this, node, half), split->count*size);
+        node->count = half;
+        split->next = node->next;
+        node->next = split;
+        if(pos > half) {
+            pos -= half;
+            node = split;
+        }
+    }
+
+    memmove(unrolled_elem(_this, node, pos + 1), unrolled_elem(_this, node, pos), (node->count - pos)*size);
+    memcpy(unrolled_elem(_this, node, pos), value, size);
+    node->count++;
+    _this->length++;
+    result = true;
+defer:
+    pthread_rwlock_unlock(&_this->rwlock);
+    return result;
+}
+
+bool unrolled_list_delete(Unrolled_List *_this, void *value) {
+    bool result;
+    pthread_rwlock_wrlock(&_this->rwlock);
+
+    if(_this->head == NULL) return_defer(false);
+
+    Unrolled_Node *prev;
+    Unrolled_Node *node = unrolled_find_node(_this, value, &prev);
+    bool found;
+    size_t pos = unrolled_search(_this, node, value, &found);
+    if(!found) return_defer(false);
+
+    size_t size = _this->elem_size;
+    node->count--;
+    memmove(unrolled_elem(_this, node, pos), unrolled_elem(_this, node, pos + 1), (node->count - pos)*size);
+    _this->length--;
+
+    Unrolled_Node *next = node->next;
+    if(node->count < _this->node_capacity/2 && next != NULL) {
+        if(node->count + next->count <= _this->node_capacity) {
+            // unione: il successivo viene svuotato in questo nodo
+            memcpy(unrolled_elem(_this, node, node->count), next->elems, next->count*size);
+            node->count += next->count;
+            node->next = next->next;
+            free(next);
+        } else {
+            // ribilanciamento: si prendono elementi dalla testa del successivo
+            size_t moved = (next->count - node->count)/2;
+            memcpy(unrolled_elem(_this, node, node->count), next->elems, moved*size);
+            node->count += moved;
+            next->count -= moved;
+            memmove(next->elems, unrolled_elem(_this, next, moved), next->count*size);
+        }
+    } else if(node->count == 0) {
+        // ultimo nodo rimasto vuoto
+        if(prev != NULL) prev->next = next;
+        else _this->head = next;
+        free(node);
+    }
+    result = true;
+defer:
+    pthread_rwlock_unlock(&_this->rwlock);
+    return result;
+}
+
+void *unrolled_list_at(Unrolled_List *_this, size_t index) {
+    void *result = NULL;
+    pthread_rwlock_rdlock(&_this->rwlock);
+    for(Unrolled_Node *node = _this->head; node != NULL; node = node->next) {
+        if(index < node->count) {
+            result = unrolled_elem(_this, node, index);
+            break;
+        }
+        index -= node->count;
+    }
+    pthread_rwlock_unlock(&_this->rwlock);
+    return result;
+}
+
+#endif // UNROLLED_LIST_H_